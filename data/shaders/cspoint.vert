@@ -2,7 +2,7 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_GOOGLE_include_directive : enable
 
-#pragma import_defines (VSGCS_BILLBOARD_NORMAL, VSGCS_SIZE_TO_ERROR)
+#pragma import_defines (VSGCS_BILLBOARD_NORMAL, VSGCS_SIZE_TO_ERROR, VSGCS_FEATURE_PALETTE)
 
 #include "descriptor_defs.glsl"
 
@@ -16,6 +16,15 @@ layout(location = 0) in vec3 vsg_Vertex;
 layout(location = 1) in vec3 vsg_Normal;
 layout(location = 2) in vec4 vsg_Color;
 layout(location = 3) in vec2 vsg_TexCoord[4];
+#ifdef VSGCS_FEATURE_PALETTE
+// Styled feature colors, indexed by feature ID. The last entry is for vertices without a feature.
+// A negative alpha hides the feature.
+layout(location = 10) in uint vsgcs_FeatureId;
+layout(std430, set = TILE_DESCRIPTOR_SET, binding = 2) readonly buffer FeaturePalette
+{
+    vec4 colors[];
+} featurePalette;
+#endif
 
 layout(location = 0) out vec3 eyePos;
 layout(location = 1) out vec3 normalDir;
@@ -72,7 +81,16 @@ void main()
 #else
     normalDir = (pc.modelView * normal).xyz;
 #endif
-    vertexColor = vsg_Color;
+    vec4 color = vsg_Color;
+#ifdef VSGCS_FEATURE_PALETTE
+    color *= featurePalette.colors[min(vsgcs_FeatureId, uint(featurePalette.colors.length()) - 1u)];
+#endif
+    // Points hidden by a style have a negative alpha.
+    if (color.a < 0.0)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    }
+    vertexColor = color;
     for (int i = 0; i < 4; i++)
     {
         texCoord[i] = vsg_TexCoord[i];
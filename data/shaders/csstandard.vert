@@ -2,7 +2,7 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_GOOGLE_include_directive : enable 
 
-#pragma import_defines (VSGCS_INSTANCES, VSG_DISPLACEMENT_MAP, VSGCS_FLAT_SHADING, VSGCS_BILLBOARD_NORMAL)
+#pragma import_defines (VSGCS_INSTANCES, VSG_DISPLACEMENT_MAP, VSGCS_FLAT_SHADING, VSGCS_BILLBOARD_NORMAL, VSGCS_FEATURE_PALETTE)
 
 #include "descriptor_defs.glsl"
 
@@ -22,6 +22,15 @@ layout(location = 3) in vec2 vsg_TexCoord[4];
 #ifdef VSGCS_INSTANCES
 layout(location = 7) in mat3x4 vsgcs_InstanceMat;
 #endif
+#ifdef VSGCS_FEATURE_PALETTE
+// Styled feature colors, indexed by feature ID. The last entry is for vertices without a feature.
+// A negative alpha hides the feature.
+layout(location = 10) in uint vsgcs_FeatureId;
+layout(std430, set = TILE_DESCRIPTOR_SET, binding = 2) readonly buffer FeaturePalette
+{
+    vec4 colors[];
+} featurePalette;
+#endif
 
 layout(location = 0) out vec3 eyePos;
 #ifdef VSGCS_FLAT_SHADING
@@ -34,7 +43,9 @@ layout(location = 3) out vec3 viewDir;
 layout(location = 4) out vec2 texCoord[4];
 
 
-out gl_PerVertex{ vec4 gl_Position; };
+// The depth pre-pass and the shading pass use different pipelines but must produce exactly the
+// same depth values.
+out gl_PerVertex{ invariant vec4 gl_Position; };
 
 // Texture coordinates are assumed to have the OpenGL / glTF origin i.e., lower left.
 vec4 cstexture(sampler2D texmap, vec2 coords)
@@ -92,6 +103,16 @@ void main()
 #endif
 
     gl_Position = (pc.projection * pc.modelView) * vertex;
+    vec4 color = vsg_Color;
+#ifdef VSGCS_FEATURE_PALETTE
+    color *= featurePalette.colors[min(vsgcs_FeatureId, uint(featurePalette.colors.length()) - 1u)];
+#endif
+    // Features hidden by a style have a negative alpha. Move their vertices outside the clip
+    // volume so that their triangles are discarded.
+    if (color.a < 0.0)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    }
 
     eyePos = (pc.modelView * vertex).xyz;
 
@@ -102,7 +123,7 @@ void main()
     mat3 normalMat = inverse(transpose(mat3(pc.modelView)));
     normalDir = (normalMat * normal);
 #endif
-    vertexColor = vsg_Color;
+    vertexColor = color;
     for (int i = 0; i < 4; i++)
     {
         texCoord[i] = vsg_TexCoord[i];
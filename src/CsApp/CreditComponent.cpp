@@ -33,6 +33,7 @@ SOFTWARE.
 
 #include <tinyxml2.h>
 #include <algorithm>
+#include <cstring>
 
 
 using namespace CsApp;
@@ -114,6 +115,102 @@ vsg::ref_ptr<vsgImGui::Texture> CreditComponent::getTexture(const std::string& u
     return {};
 }
 
+// Parse the HTML of a credit, which is usually a link or an image.
+
+CreditComponent::CreditLayout CreditComponent::parseCredit(const std::string& html) const
+{
+    CreditLayout layout;
+    std::string cleaned = html;
+    cleanHtml(cleaned);
+    tinyxml2::XMLDocument doc;
+    tinyxml2::XMLError xerr = doc.Parse(cleaned.c_str());
+    if (xerr != 0)
+    {
+        vsg::error("tinyxml2 error ", std::to_string(static_cast<int32_t>(xerr)), " ", cleaned);
+        return layout;
+    }
+    auto* node = doc.FirstChildElement();
+    if (node && !std::strcmp(node->Name(), "span"))
+    {
+        node = node->FirstChildElement();
+    }
+    if (!node)
+    {
+        return layout;
+    }
+    auto addImg = [&layout](const tinyxml2::XMLElement* element)
+    {
+        const auto* src = element->Attribute("src");
+        const auto* alt = element->Attribute("alt");
+        layout.push_back(CreditItem{alt ? alt : "", src ? src : "", {}});
+    };
+    if (!std::strcmp(node->Name(), "a"))
+    {
+        auto* aContents = node->FirstChild();
+        if (!aContents)
+        {
+            return layout;
+        }
+        if (auto* asText = aContents->ToText())
+        {
+            layout.push_back(CreditItem{asText->Value(), "", {}});
+        }
+        else
+        {
+            auto* element = aContents->ToElement();
+            if (element && !std::strcmp(element->Name(), "img"))
+            {
+                addImg(element);
+            }
+        }
+    }
+    else if (!std::strcmp(node->Name(), "img"))
+    {
+        addImg(node);
+    }
+    return layout;
+}
+
+// Lay out the credits again only when the set of credits changes.
+
+void CreditComponent::updateLayouts() const
+{
+    auto creditSystem = environment->getTilesetExternals()->pCreditSystem;
+    const auto& snapshot = creditSystem->getSnapshot();
+    if (snapshot.currentCredits == currentCredits)
+    {
+        return;
+    }
+    currentCredits = snapshot.currentCredits;
+    currentLayouts.clear();
+    for (const auto& credit : currentCredits)
+    {
+        if (!creditSystem->shouldBeShownOnScreen(credit))
+        {
+            continue;
+        }
+        const auto& html = creditSystem->getHtml(credit);
+        if (html.empty())
+        {
+            continue;
+        }
+        auto layoutItr = layoutCache.find(html);
+        if (layoutItr == layoutCache.end())
+        {
+            layoutItr = layoutCache.emplace(html, parseCredit(html)).first;
+            // Start loading the logos now.
+            for (auto& item : layoutItr->second)
+            {
+                if (!item.src.empty())
+                {
+                    item.texture = getTexture(item.src);
+                }
+            }
+        }
+        currentLayouts.push_back(&layoutItr->second);
+    }
+}
+
 // This is the lamest renderer ever: render a small line of HTML using ImGui.
 
 void CreditComponent::record(vsg::CommandBuffer& cb) const
@@ -136,80 +233,45 @@ void CreditComponent::record(vsg::CommandBuffer& cb) const
     ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
     ImGui::Begin("vsgCS UI", nullptr, window_flags);
 
-    auto creditSystem = environment->getTilesetExternals()->pCreditSystem;
-    const auto& snapshot = creditSystem->getSnapshot();
-
-    for (const auto& credit : snapshot.currentCredits)
+    updateLayouts();
+    for (auto* layout : currentLayouts)
     {
-        if (!creditSystem->shouldBeShownOnScreen(credit))
+        for (auto& item : *layout)
         {
-            continue;
-        }
-        auto html = creditSystem->getHtml(credit);
-        if (html.empty())
-        {
-            continue;
-        }
-        cleanHtml(html);
-        tinyxml2::XMLDocument doc;
-        tinyxml2::XMLError xerr = doc.Parse(html.c_str());
-        if (xerr != 0)
-        {
-            vsg::error("tinyxml2 error ", std::to_string(static_cast<int32_t>(xerr)), " ", html);
-            break;
-        }
-        auto* node = doc.FirstChildElement();
-        if (!std::strcmp(node->Name(), "span"))
-        {
-            node = node->FirstChildElement();
-        }
-        if (!std::strcmp(node->Name(), "a"))
-        {
-            std::string href(node->Attribute("href"));
-            auto* aContents = node->FirstChild();
-            if (auto* asText = aContents->ToText())
+            if (item.src.empty())
             {
-                ImGui::Text("%s", asText->Value());
+                ImGui::Text("%s", item.text.c_str());
                 ImGui::SameLine();
-
             }
             else
             {
-                auto* element = aContents->ToElement();
-                if (element && !std::strcmp(element->Name(), "img"))
-                {
-                    renderImg(cb, element);
-                }
+                renderImg(cb, item);
             }
         }
-        else if (!std::strcmp(node->Name(), "img"))
-        {
-            renderImg(cb, node);
-        }
     }
 
     ImGui::End();
     ImGui::PopStyleVar();
 }
 
-void CreditComponent::renderImg(vsg::CommandBuffer& cb, const tinyxml2::XMLElement* element) const
+void CreditComponent::renderImg(vsg::CommandBuffer& cb, CreditItem& item) const
 {
-    const auto* src = element->Attribute("src");
-    const auto* alt = element->Attribute("alt");
-    auto component = getTexture(src);
-    if (component)
-    {
-        auto height = component->height;
-        ImGui::Image(component->id(cb.deviceID), ImVec2(component->width,
-                                                        component->height));
+    if (!item.texture)
+    {
+        item.texture = getTexture(item.src);
+    }
+    if (item.texture)
+    {
+        auto height = item.texture->height;
+        ImGui::Image(item.texture->id(cb.deviceID), ImVec2(item.texture->width,
+                                                           item.texture->height));
         ImGui::SameLine();
         auto pos = ImGui::GetCursorPos();
         ImGui::SetCursorPosY(pos.y + height / 2.0 - ImGui::GetFontSize() / 2);
     }
-    else if (alt)
+    else if (!item.text.empty())
     {
-        ImGui::Text("%s", alt);
+        ImGui::Text("%s", item.text.c_str());
         ImGui::SameLine();
-
     }
 }
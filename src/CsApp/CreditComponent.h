@@ -32,12 +32,14 @@ SOFTWARE.
 #include <vsgImGui/Texture.h>
 
 #include <CesiumAsync/Future.h>
+#include <CesiumUtility/CreditSystem.h>
 
 #include <tinyxml2.h>
 
 #include <map>
 #include <string>
 #include <optional>
+#include <vector>
 
 namespace CsApp
 {
@@ -58,8 +60,25 @@ namespace CsApp
             vsg::ref_ptr<vsgImGui::Texture> texture;
         };
         mutable std::map<std::string, RemoteImage> imageCache;
+        // A credit's HTML, parsed into the pieces that are drawn
+        struct CreditItem
+        {
+            // Text, or the alt text of an image
+            std::string text;
+            // Empty for text
+            std::string src;
+            vsg::ref_ptr<vsgImGui::Texture> texture;
+        };
+        using CreditLayout = std::vector<CreditItem>;
+        // Layouts are parsed once per credit HTML.
+        mutable std::map<std::string, CreditLayout> layoutCache;
+        // The credits drawn in the last frame, and their layouts
+        mutable std::vector<CesiumUtility::Credit> currentCredits;
+        mutable std::vector<CreditLayout*> currentLayouts;
         vsg::ref_ptr<vsgCs::RuntimeEnvironment> environment;
         vsg::ref_ptr<vsgImGui::Texture> getTexture(const std::string& url) const;
-        void renderImg(vsg::CommandBuffer& cb, const tinyxml2::XMLElement* element) const; 
+        CreditLayout parseCredit(const std::string& html) const;
+        void updateLayouts() const;
+        void renderImg(vsg::CommandBuffer& cb, CreditItem& item) const;
     };
 }
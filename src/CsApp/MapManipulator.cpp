@@ -9,6 +9,7 @@
 #include "vsgCs/WorldNode.h"
 
 
+#include <algorithm>
 #include <tuple>
 #include <utility>
 #include <vsg/app/ProjectionMatrix.h>
@@ -521,6 +522,7 @@ MapManipulator::MapManipulator(const vsg::ref_ptr<WorldNode>& mapNode,
                                const vsg::ref_ptr<vsg::Camera>& camera) :
     _mapNode(mapNode),
     _camera(camera),
+    _lookIntersectionPending(false),
     _lastAction(ACTION_NULL)
 {
     if (mapNode.valid())
@@ -1235,6 +1237,29 @@ MapManipulator::getMapNode() const
     return safe;
 }
 
+namespace
+{
+    // The closest intersection with a subgraph
+    std::optional<vsg::dvec3> intersectGraph(vsg::Node& node, const vsg::dvec3& start, const vsg::dvec3& end)
+    {
+        vsg::LineSegmentIntersector lsi(start, end);
+
+        node.accept(lsi);
+
+        if (lsi.intersections.empty())
+        {
+            return {};
+        }
+        auto closest = std::min_element(lsi.intersections.begin(), lsi.intersections.end(),
+            [](const vsg::ref_ptr<vsg::LineSegmentIntersector::Intersection>& lhs,
+                const vsg::ref_ptr<vsg::LineSegmentIntersector::Intersection>& rhs)
+            {
+                return lhs->ratio < rhs->ratio;
+            });
+        return (*closest)->worldIntersection;
+    }
+}
+
 std::optional<vsg::dvec3>
 MapManipulator::intersect(
     const vsg::dvec3& start,
@@ -1242,28 +1267,19 @@ MapManipulator::intersect(
 {
     VSGCS_ZONESCOPED;
     vsg::ref_ptr<WorldNode> mapNode = _mapNode;
-    if (mapNode)
+    if (_terrainService)
     {
-        vsg::LineSegmentIntersector lsi(start, end);
-
-        mapNode->accept(lsi);
-
-        if (!lsi.intersections.empty())
+        // Models such as GeoNodes are intersected along with the terrain in
+        // requestLookIntersection(), off the main thread.
+        if (auto hit = _terrainService->intersect(start, end))
         {
-            if (lsi.intersections.size() > 1)
-            {
-                // sort from closest to farthest
-                std::sort(lsi.intersections.begin(), lsi.intersections.end(),
-                    [](const vsg::ref_ptr<vsg::LineSegmentIntersector::Intersection>& lhs,
-                        const vsg::ref_ptr<vsg::LineSegmentIntersector::Intersection>& rhs)
-                    {
-                        return lhs->ratio < rhs->ratio;
-                    });
-            }
-
-            return lsi.intersections.front()->worldIntersection;
-            //std::cout << out_intersection.x << ", " << out_intersection.y << ", " << out_intersection.z << std::endl;
+            return hit->position;
         }
+        return {};
+    }
+    if (mapNode)
+    {
+        return intersectGraph(*mapNode, start, end);
     }
     return {};
 }
@@ -1271,6 +1287,10 @@ MapManipulator::intersect(
 std::optional<vsg::dvec3>
 MapManipulator::intersectAlongLookVector() const
 {
+    if (_terrainService)
+    {
+        return _lookIntersection;
+    }
     auto mapNode = getMapNode();
     if (mapNode)
     {
@@ -1284,6 +1304,122 @@ MapManipulator::intersectAlongLookVector() const
     return {};
 }
 
+void
+MapManipulator::setTerrainService(const vsg::ref_ptr<TerrainService>& terrainService)
+{
+    _terrainService = terrainService;
+    _lookIntersection.reset();
+    _lastLookRequest.reset();
+    _heightSampler = terrainService ? HeightSampler::create(terrainService) : vsg::ref_ptr<HeightSampler>();
+}
+
+void
+MapManipulator::requestLookIntersection(vsg::time_point now)
+{
+    if (!_terrainService || _lookIntersectionPending)
+    {
+        return;
+    }
+    vsg::LookAt lookat;
+    lookat.set(_viewMatrix);
+    auto look = vsg::normalize(lookat.center - lookat.eye);
+    // Skip the request if the camera hasn't moved more than a small fraction of the distance to
+    // the center and hasn't turned noticeably, unless the last result is getting old.
+    if (_lastLookRequest
+        && vsg::length(lookat.eye - _lastLookRequest->eye) < _state.distance * 0.01
+        && vsg::dot(look, _lastLookRequest->look) > 0.99999
+        && to_seconds(now - _lastLookRequest->time) < _heightSampler->refreshInterval)
+    {
+        return;
+    }
+    _lastLookRequest = LookRequest{lookat.eye, look, now};
+    _lookIntersectionPending = true;
+    vsg::observer_ptr<MapManipulator> observer(this);
+    vsg::dvec3 start = lookat.eye;
+    vsg::dvec3 end = lookat.eye + look * (_state.distance * 1.5);
+    // The terrain service only has the tiles of tilesets; models such as GeoNodes are
+    // intersected in the scene graph on the same worker thread, and the closer hit wins. The
+    // references keep the models alive if the world is reloaded in the meantime.
+    vsg::Group::Children models;
+    if (vsg::ref_ptr<WorldNode> mapNode = _mapNode)
+    {
+        for (const auto& child : mapNode->children)
+        {
+            if (child != mapNode->children.front())
+            {
+                models.push_back(child);
+            }
+        }
+    }
+    _terrainService->intersectAsync(start, end)
+        .thenInWorkerThread([start, end, models = std::move(models)](std::optional<TerrainService::Hit>&& hit)
+        {
+            std::optional<vsg::dvec3> result;
+            if (hit)
+            {
+                result = hit->position;
+            }
+            for (const auto& model : models)
+            {
+                auto modelHit = intersectGraph(*model, start, end);
+                if (modelHit && (!result || vsg::length(*modelHit - start) < vsg::length(*result - start)))
+                {
+                    result = modelHit;
+                }
+            }
+            return result;
+        })
+        .thenInMainThread([observer](std::optional<vsg::dvec3>&& hit)
+        {
+            vsg::ref_ptr<MapManipulator> manipulator = observer;
+            if (!manipulator)
+            {
+                return;
+            }
+            manipulator->_lookIntersectionPending = false;
+            if (hit)
+            {
+                manipulator->_lookIntersection = *hit;
+                manipulator->_state.debugIntersection = *hit;
+            }
+            else
+            {
+                manipulator->_lookIntersection.reset();
+            }
+        });
+}
+
+bool
+MapManipulator::avoidTerrain(vsg::time_point now)
+{
+    if (!_heightSampler || !_geoServices || !_geoServices->isGeocentric())
+    {
+        return false;
+    }
+    vsg::dvec3 eye = _viewMatrix * vsg::dvec3(0.0, 0.0, 0.0);
+    vsg::dvec3 cartographic = _geoServices->toCartographic(eye);
+    auto terrainHeight = _heightSampler->getHeight(cartographic.x, cartographic.y);
+    // Space the samples by a fraction of the height above the terrain, so that the grid covers
+    // more ground as the camera climbs.
+    double heightAboveTerrain = cartographic.z - terrainHeight.value_or(0.0);
+    double spacing = clamp(std::abs(heightAboveTerrain) * 0.1, 2.0, 5000.0);
+    _heightSampler->update(cartographic.x, cartographic.y, spacing, now);
+    if (!terrainHeight || !_settings->getTerrainAvoidanceEnabled())
+    {
+        return false;
+    }
+    double deficit = *terrainHeight + _settings->getTerrainAvoidanceMinimumDistance() - cartographic.z;
+    if (deficit <= 0.0)
+    {
+        return false;
+    }
+    // Raise the focal point, and with it the eye, along the up vector at the eye.
+    auto localToWorld = _geoServices->localToWorldMatrix(eye);
+    vsg::dvec3 up = vsg::normalize(vsg::dvec3(localToWorld[2][0], localToWorld[2][1], localToWorld[2][2]));
+    setCenter(_state.center + up * deficit);
+    return true;
+}
+
 std::pair<vsg::dvec3, double>
 MapManipulator::getHome()
 {
@@ -1515,7 +1651,17 @@ MapManipulator::apply(vsg::FrameEvent& frame)
         _camera->viewMatrix = lookat;
     }
 
+    if (avoidTerrain(frame.time))
+    {
+        _viewMatrix =
+            vsg::translate(_state.center) *
+            _state.centerRotation *
+            vsg::rotate(_state.localRotation) *
+            vsg::translate(0.0, 0.0, _state.distance);
+    }
+
     lookat->set(_viewMatrix);
+    requestLookIntersection(frame.time);
 
     _dirty = false;
 }
@@ -1591,7 +1737,9 @@ MapManipulator::recalculateCenterFromLookVector()
     lookat.set(_camera->viewMatrix->inverse());
     auto look = vsg::normalize(lookat.center - lookat.eye);
 
-    std::optional<vsg::dvec3> intersection = intersect(lookat.eye, look * _state.distance * 1.5);
+    std::optional<vsg::dvec3> intersection = _terrainService
+        ? _lookIntersection
+        : intersect(lookat.eye, look * _state.distance * 1.5);
 
     // backup plan, intersect the ellipsoid or the ground plane
     if (!intersection)
@@ -7,6 +7,8 @@
 
 #include "vsgCs/Export.h"
 #include "vsgCs/GeospatialServices.h"
+#include "vsgCs/HeightSampler.h"
+#include "vsgCs/TerrainService.h"
 #include "vsgCs/runtimeSupport.h"
 
 #include <vsg/core/Inherit.h>
@@ -91,6 +93,12 @@ namespace vsgCs
         //! Distance from the focal point in world coordinates.
         void setDistance(double distance);
 
+        //! Intersect the terrain using the triangles of loaded tiles instead of traversing the
+        //! scene graph. Intersections along the look vector are computed in a worker thread when
+        //! the camera has moved, and the latest result is used. Terrain avoidance uses a grid of
+        //! heights around the camera that is also sampled in worker threads.
+        void setTerrainService(const vsg::ref_ptr<TerrainService>& terrainService);
+
     public: // vsg::Visitor
         void apply(vsg::KeyPressEvent& keyPress) override;
         void apply(vsg::KeyReleaseEvent&) override;
@@ -608,6 +616,13 @@ namespace vsgCs
 
          std::optional<vsg::dvec3> intersectAlongLookVector() const;
 
+        // Start an asynchronous intersection along the look vector, unless one is in flight or
+        // the camera has barely moved since the last one.
+        void requestLookIntersection(vsg::time_point now);
+
+        // Keep the eye above the sampled terrain height. Returns true if the center was moved.
+        bool avoidTerrain(vsg::time_point now);
+
         // returns the absolute Euler angles composited from the composite rotation matrix.
         void getCompositeEulerAngles(double* out_azim, double* out_pitch = 0L) const;
 
@@ -724,6 +739,18 @@ namespace vsgCs
         vsg::observer_ptr<WorldNode> _mapNode;
         vsg::ref_ptr<vsg::Camera> _camera;
         vsg::ref_ptr<IGeospatialServices> _geoServices;
+        vsg::ref_ptr<TerrainService> _terrainService;
+        bool _lookIntersectionPending;
+        // The latest result of requestLookIntersection()
+        std::optional<vsg::dvec3> _lookIntersection;
+        struct LookRequest
+        {
+            vsg::dvec3 eye;
+            vsg::dvec3 look;
+            vsg::time_point time;
+        };
+        std::optional<LookRequest> _lastLookRequest;
+        vsg::ref_ptr<HeightSampler> _heightSampler;
 
         std::optional<vsg::MoveEvent> _currentMove, _previousMove;
         std::optional<vsg::ButtonPressEvent> _buttonPress;
@@ -1,11 +1,14 @@
 #include "vsgCs/GltfLoader.h"
+#include "vsgCs/OpThreadTaskProcessor.h"
 #include "vsgCs/pbr.h"
 #include "vsgCs/RuntimeEnvironment.h"
 #include "vsgCs/runtimeSupport.h"
 
 #include <vsg/all.h>
 
+#include <chrono>
 #include <iostream>
+#include <thread>
 
 int main(int argc, char** argv)
 {
@@ -19,6 +22,8 @@ int main(int argc, char** argv)
     bool add_point = true;
     bool add_spotlight = true;
     bool add_headlight = arguments.read("--headlight");
+    bool mapFile = !arguments.read("--no-mmap");
+    bool progressive = arguments.read("--progressive");
     if (add_headlight || arguments.read({"--no-lights", "-n"}))
     {
         add_amient = false;
@@ -36,21 +41,47 @@ int main(int argc, char** argv)
                                               vsgCs::pbr::VIEW_DESCRIPTOR_SET);
     scene->add(bindViewDescriptorSets);
     auto loader = vsgCs::GltfLoader::create();
-    
-    if (argc>1)
+    loader->mapLocalFiles = mapFile;
+    vsg::ref_ptr<vsgCs::ProgressiveModel> progressiveModel;
+
+    if (argc>1 && progressive)
     {
         vsg::Path filename = argv[1];
+        progressiveModel = loader->readProgressive(filename, vsgCs::RuntimeEnvironment::get()->options);
+        // The bounds are needed to place the camera; the model itself appears while the viewer runs.
+        while (!progressiveModel->getBounds().valid() && !progressiveModel->isDone())
+        {
+            vsgCs::getAsyncSystem().dispatchMainThreadTasks();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!progressiveModel->getBounds().valid())
+        {
+            std::cout<<"Faled to load "<<filename<<'\n';
+            return 1;
+        }
+        scene->addChild(progressiveModel);
+    }
+    else if (argc>1)
+    {
+        vsg::Path filename = argv[1];
+        auto start = std::chrono::steady_clock::now();
         auto model = vsgCs::ref_ptr_cast<vsg::Node>(loader->read(filename, vsgCs::RuntimeEnvironment::get()->options));
         if (!model)
         {
             std::cout<<"Faled to load "<<filename<<'\n';
             return 1;
         }
+        vsg::info("Read ", filename, " in ",
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), " ms");
         scene->addChild(model);
     }
     
     // compute the bounds of the scene graph to help position camera
     auto bounds = vsg::visit<vsg::ComputeBounds>(scene).bounds;
+    if (progressiveModel)
+    {
+        bounds.add(progressiveModel->getBounds());
+    }
 
     if (add_amient || add_directional || add_point || add_spotlight || add_headlight)
     {
@@ -192,6 +223,10 @@ int main(int argc, char** argv)
     {
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
+        if (progressiveModel)
+        {
+            progressiveModel->update(*viewer);
+        }
         viewer->update();
         viewer->recordAndSubmit();
         viewer->present();
@@ -0,0 +1,116 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include "vsgCs/TileGeometry.h"
+
+#include <vsg/io/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace vsgCs
+{
+    void benchmarkTileBVH(size_t numTriangles)
+    {
+        using clock = std::chrono::steady_clock;
+        auto ms = [](clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+        // A 10 km square of rolling hills
+        const auto gridSize = static_cast<uint32_t>(std::max(2.0, std::sqrt(numTriangles / 2.0)));
+        const double cellSize = 10000.0 / gridSize;
+        auto geometry = TileGeometry::create();
+        for (uint32_t y = 0; y <= gridSize; ++y)
+        {
+            for (uint32_t x = 0; x <= gridSize; ++x)
+            {
+                const double px = x * cellSize - 5000.0;
+                const double py = y * cellSize - 5000.0;
+                geometry->vertices.emplace_back(px, py, 100.0 * std::sin(px / 500.0) * std::cos(py / 700.0));
+            }
+        }
+        for (uint32_t y = 0; y < gridSize; ++y)
+        {
+            for (uint32_t x = 0; x < gridSize; ++x)
+            {
+                const uint32_t v = y * (gridSize + 1) + x;
+                geometry->indices.insert(geometry->indices.end(),
+                                         {v, v + 1, v + gridSize + 2, v, v + gridSize + 2, v + gridSize + 1});
+            }
+        }
+        geometry->bound = vsg::dsphere(vsg::dvec3(0.0, 0.0, 0.0), 7100.0);
+        const size_t triangles = geometry->indices.size() / 3;
+        const size_t bruteSize = geometry->memorySize();
+        std::vector<std::pair<vsg::dvec3, vsg::dvec3>> segments;
+        const size_t numQueries = 100000;
+        for (size_t i = 0; i < numQueries; ++i)
+        {
+            const double u = static_cast<double>((i * 7919) % 10007) / 10006.0 * 9990.0 - 4995.0;
+            const double v = static_cast<double>((i * 104729) % 10009) / 10008.0 * 9990.0 - 4995.0;
+            segments.emplace_back(vsg::dvec3(u, v, 1000.0), vsg::dvec3(u, v, -1000.0));
+        }
+        // Brute force is slow, so only time some of the queries.
+        const size_t numBrute = std::min<size_t>(numQueries, 200);
+        std::vector<std::optional<TileGeometry::Hit>> bruteHits(numBrute);
+        auto start = clock::now();
+        for (size_t i = 0; i < numBrute; ++i)
+        {
+            bruteHits[i] = geometry->intersect(segments[i].first, segments[i].second);
+        }
+        const double bruteTime = ms(start);
+        start = clock::now();
+        geometry->buildBVH();
+        const double buildTime = ms(start);
+        size_t numHits = 0;
+        double maxDifference = 0.0;
+        start = clock::now();
+        for (size_t i = 0; i < numQueries; ++i)
+        {
+            auto hit = geometry->intersect(segments[i].first, segments[i].second);
+            numHits += hit ? 1 : 0;
+            if (i < numBrute && hit && bruteHits[i])
+            {
+                maxDifference = std::max(maxDifference, vsg::length(hit->position - bruteHits[i]->position));
+            }
+            else if (i < numBrute && hit.has_value() != bruteHits[i].has_value())
+            {
+                maxDifference = std::numeric_limits<double>::infinity();
+            }
+        }
+        const double bvhTime = ms(start);
+        vsg::info("tile BVH, ", triangles, " triangles: build ", buildTime, " ms, ", geometry->bvh.size(), " nodes, ",
+                  geometry->memorySize() - bruteSize, " extra bytes");
+        vsg::info("segment queries: brute force ", bruteTime / numBrute * 1000.0, " us, BVH ",
+                  bvhTime / numQueries * 1000.0, " us per query, ", numHits, " / ", numQueries,
+                  " hits, max difference ", maxDifference, " m");
+    }
+}
@@ -0,0 +1,90 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/StyleExpression.h"
+
+#include <string>
+
+// Benchmarks of vsgCs internals on synthetic data, run by vsgcsbenchmark. Results are reported
+// with vsg::info().
+
+namespace vsgCs
+{
+    /**
+     * @brief Make a synthetic table of features. The table has the properties "id" and "height"
+     * (numbers), "type" (a string with 8 distinct values) and "occupied" (a boolean).
+     */
+    StyleColumns makeBenchmarkColumns(size_t numFeatures);
+
+    /**
+     * @brief Style a synthetic table of features (see makeBenchmarkColumns()) with a color
+     * expression and report the time taken.
+     * @return the evaluation time in seconds
+     */
+    double benchmarkStyleExpression(const std::string& colorExpression, size_t numFeatures = 1000000);
+
+    /**
+     * @brief Time index construction and selections on a synthetic table of features (see
+     * makeBenchmarkColumns()), compared with evaluating the equivalent style expressions.
+     */
+    void benchmarkFeatureQueries(size_t numFeatures = 1000000);
+
+    /**
+     * @brief Time the first conversion in new threads and the conversion of numPoints
+     * coordinates, in an area around a longitude and latitude, from a CRS to ECEF and back, one at
+     * a time and in a batch.
+     */
+    void benchmarkCRS(const std::string& name, size_t numPoints = 1000000,
+                      double longitude = -71.06, double latitude = 42.36);
+
+    /**
+     * @brief Check the WGS84 geodetic <-> ECEF kernels, and the EPSG:4979 ENU frames built
+     * with them, against cesium-native and by round trips, from the surface up to geostationary
+     * altitude. Errors are reported with their tolerances.
+     * @return true if every error is within its tolerance
+     */
+    bool checkGeodeticKernels(size_t numPoints = 1000000);
+
+    /**
+     * @brief Time the WGS84 geodetic <-> ECEF kernels against cesium-native's conversions.
+     * @return the largest difference, in meters, from cesium-native
+     */
+    double benchmarkGeodeticKernels(size_t numPoints = 1000000);
+
+    /**
+     * @brief Time building the BVH of a synthetic terrain tile with about numTriangles triangles,
+     * and vertical segment queries with and without it.
+     */
+    void benchmarkTileBVH(size_t numTriangles = 500000);
+
+    /**
+     * @brief Time the record traversal of numInstances model instances under transforms and as
+     * an InstancedModel, with and without a grid of cells. Only the traversal and culling are
+     * timed; no Vulkan commands are recorded, though the transforms would also record a draw per
+     * visible instance.
+     */
+    void benchmarkInstancedModel(size_t numInstances = 100000);
+}
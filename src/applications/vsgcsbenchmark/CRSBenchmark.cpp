@@ -0,0 +1,91 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include "vsgCs/CRS.h"
+
+#include <vsg/io/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace vsgCs
+{
+    void benchmarkCRS(const std::string& name, size_t numPoints, double longitude, double latitude)
+    {
+        using clock = std::chrono::steady_clock;
+        auto ms = [](clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+        // Points within about 10 km of the center, from 0 to 500 m high
+        CRS wgs84("epsg:4979");
+        std::vector<vsg::dvec3> ecef(numPoints);
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            const double u = static_cast<double>((i * 7919) % 1000) / 1000.0 - 0.5;
+            const double v = static_cast<double>((i * 104729) % 1000) / 1000.0 - 0.5;
+            ecef[i] = wgs84.getECEF(vsg::dvec3(longitude + u * 0.2, latitude + v * 0.2,
+                                               static_cast<double>(i % 500)));
+        }
+        CRS crs(name);
+        // The first conversion in a thread pays for setting up the thread's PROJ objects.
+        const vsg::dvec3 firstPoint = wgs84.getECEF(vsg::dvec3(longitude, latitude, 0.0));
+        for (int i = 0; i < 4; ++i)
+        {
+            std::thread thread([&]()
+            {
+                auto threadStart = clock::now();
+                crs.getCRSCoord(firstPoint);
+                vsg::info(name, ": first conversion in a new thread: ", ms(threadStart), " ms");
+            });
+            thread.join();
+        }
+        std::vector<vsg::dvec3> coords(numPoints);
+        auto start = clock::now();
+        crs.getCRSCoord(ecef, coords);
+        vsg::info(name, ": batch ECEF to CRS: ", ms(start), " ms");
+        std::vector<vsg::dvec3> result(numPoints);
+        start = clock::now();
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            result[i] = crs.getECEF(coords[i]);
+        }
+        const double singleTime = ms(start);
+        start = clock::now();
+        crs.getECEF(coords, result);
+        const double batchTime = ms(start);
+        double maxError = 0.0;
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            maxError = std::max(maxError, vsg::length(result[i] - ecef[i]));
+        }
+        vsg::info(name, ": CRS to ECEF, ", numPoints, " points: one at a time ", singleTime, " ms (",
+                  numPoints / singleTime / 1000.0, " million/s), batch ", batchTime, " ms (",
+                  numPoints / batchTime / 1000.0, " million/s), round trip error ", maxError, " m");
+    }
+}
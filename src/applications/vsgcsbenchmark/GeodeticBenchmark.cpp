@@ -0,0 +1,228 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include "vsgCs/CRS.h"
+#include "vsgCs/Geodetic.h"
+#include "vsgCs/runtimeSupport.h"
+
+#include <CesiumGeospatial/Ellipsoid.h>
+#include <CesiumGeospatial/LocalHorizontalCoordinateSystem.h>
+
+#include <vsg/io/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    using namespace vsgCs;
+
+    // Points all over the globe, including the poles, from 1 km below the surface to
+    // geostationary altitude, in radians.
+    std::vector<vsg::dvec3> makeGeodeticPoints(size_t numPoints)
+    {
+        std::vector<vsg::dvec3> geodetic(numPoints);
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            const double u = static_cast<double>((i * 7919) % 10007) / 10006.0;
+            const double v = static_cast<double>((i * 104729) % 10009) / 10008.0;
+            const double height = i % 4 == 0 ? 36.0e6 * u * v : 10000.0 * v - 1000.0;
+            geodetic[i].set((u * 2.0 - 1.0) * vsg::PI, (v - 0.5) * vsg::PI, height);
+        }
+        return geodetic;
+    }
+
+    // Tolerances of the checks. Round trips through the kernels were measured with errors of
+    // about 2e-8 m and 5e-16 rad over these points, so the tolerances leave room for other
+    // compilers and math libraries while still catching any real error in the formulas.
+    // Distance between ECEF positions, in meters
+    constexpr double positionTolerance = 1.0e-6;
+    // Latitude, and longitude scaled by the cosine of the latitude, in radians (6 um on the
+    // surface)
+    constexpr double angleTolerance = 1.0e-12;
+    // Height, in meters
+    constexpr double heightTolerance = 1.0e-6;
+    // Difference between the unit axis vectors of ENU frames
+    constexpr double axisTolerance = 1.0e-12;
+
+    struct MaxError
+    {
+        const char* name;
+        double tolerance;
+        double error = 0.0;
+        size_t point = 0;
+
+        void update(double value, size_t i)
+        {
+            // NaN counts as a failure.
+            if (!(value <= error))
+            {
+                error = value;
+                point = i;
+            }
+        }
+
+        bool report(const std::vector<vsg::dvec3>& geodetic) const
+        {
+            if (error <= tolerance)
+            {
+                vsg::info("  ", name, ": max error ", error, " (tolerance ", tolerance, ")");
+                return true;
+            }
+            const auto& g = geodetic[point];
+            vsg::error("  ", name, ": error ", error, " exceeds tolerance ", tolerance, " at longitude ",
+                       vsg::degrees(g.x), ", latitude ", vsg::degrees(g.y), ", height ", g.z);
+            return false;
+        }
+    };
+}
+
+namespace vsgCs
+{
+    bool checkGeodeticKernels(size_t numPoints)
+    {
+        using namespace CesiumGeospatial;
+        const auto geodetic = makeGeodeticPoints(numPoints);
+        MaxError forward{"geodetic to ECEF against cesium-native (m)", positionTolerance};
+        MaxError inverse{"ECEF to geodetic, converted back by cesium-native (m)", positionTolerance};
+        MaxError angleRoundTrip{"geodetic round trip angle (rad)", angleTolerance};
+        MaxError heightRoundTrip{"geodetic round trip height (m)", heightTolerance};
+        MaxError enuOrigin{"EPSG:4979 ENU frame origin (m)", positionTolerance};
+        MaxError enuAxes{"EPSG:4979 ENU frame axes", axisTolerance};
+
+        std::vector<vsg::dvec3> reference(numPoints);
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            reference[i] = glm2vsg(Ellipsoid::WGS84.cartographicToCartesian(
+                                       Cartographic(geodetic[i].x, geodetic[i].y, geodetic[i].z)));
+        }
+        std::vector<vsg::dvec3> ecef(numPoints);
+        geodeticToECEF(geodetic, ecef);
+        std::vector<vsg::dvec3> fromReference(numPoints);
+        ecefToGeodetic(reference, fromReference);
+        std::vector<vsg::dvec3> roundTrip(numPoints);
+        ecefToGeodetic(ecef, roundTrip);
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            const auto& g = geodetic[i];
+            forward.update(vsg::length(ecef[i] - reference[i]), i);
+            const auto& r = fromReference[i];
+            inverse.update(vsg::length(glm2vsg(Ellipsoid::WGS84.cartographicToCartesian(Cartographic(r.x, r.y, r.z)))
+                                       - reference[i]),
+                           i);
+            // Longitude is meaningless at the poles, and so is weighted by the cosine of the
+            // latitude.
+            const double lonError = std::abs(std::remainder(roundTrip[i].x - g.x, 2.0 * vsg::PI)) * std::cos(g.y);
+            angleRoundTrip.update(std::max(std::abs(roundTrip[i].y - g.y), lonError), i);
+            heightRoundTrip.update(std::abs(roundTrip[i].z - g.z), i);
+        }
+        // The frame that a GeoNode gets for an ECEF position goes through the inverse kernel;
+        // compare it with the frame at the exact position.
+        CRS wgs84("epsg:4979");
+        for (size_t i = 0; i < numPoints; i += 16)
+        {
+            const auto& g = geodetic[i];
+            const vsg::dvec3 crsCoord = wgs84.getCRSCoord(reference[i]);
+            const vsg::dmat4 frame = wgs84.getENU(crsCoord);
+            const vsg::dmat4 expected = glm2vsg(LocalHorizontalCoordinateSystem(Cartographic(g.x, g.y, g.z))
+                                                .getLocalToEcefTransformation());
+            enuOrigin.update(vsg::length(vsg::dvec3(frame[3].x, frame[3].y, frame[3].z) - reference[i]), i);
+            if (std::cos(g.y) < 1.0e-9)
+            {
+                // East is arbitrary at the poles.
+                continue;
+            }
+            double axisError = 0.0;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const vsg::dvec4 d = frame[axis] - expected[axis];
+                axisError = std::max(axisError, vsg::length(vsg::dvec3(d.x, d.y, d.z)));
+            }
+            enuAxes.update(axisError, i);
+        }
+        vsg::info("checked the geodetic kernels with ", numPoints, " points");
+        bool passed = true;
+        for (const auto* check : {&forward, &inverse, &angleRoundTrip, &heightRoundTrip, &enuOrigin, &enuAxes})
+        {
+            passed = check->report(geodetic) && passed;
+        }
+        return passed;
+    }
+
+    double benchmarkGeodeticKernels(size_t numPoints)
+    {
+        using namespace CesiumGeospatial;
+        using clock = std::chrono::steady_clock;
+        auto ms = [](clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+        const auto geodetic = makeGeodeticPoints(numPoints);
+        std::vector<vsg::dvec3> reference(numPoints);
+        auto start = clock::now();
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            reference[i] = glm2vsg(Ellipsoid::WGS84.cartographicToCartesian(
+                                       Cartographic(geodetic[i].x, geodetic[i].y, geodetic[i].z)));
+        }
+        const double cesiumForward = ms(start);
+        std::vector<vsg::dvec3> ecef(numPoints);
+        start = clock::now();
+        geodeticToECEF(geodetic, ecef);
+        const double kernelForward = ms(start);
+        std::vector<vsg::dvec3> inverse(numPoints);
+        start = clock::now();
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            if (auto result = Ellipsoid::WGS84.cartesianToCartographic(vsg2glm(reference[i])))
+            {
+                inverse[i].set(result->longitude, result->latitude, result->height);
+            }
+        }
+        const double cesiumInverse = ms(start);
+        start = clock::now();
+        ecefToGeodetic(reference, inverse);
+        const double kernelInverse = ms(start);
+        // Measure the inverse's error as a distance by converting its result back with
+        // cesium-native.
+        double forwardError = 0.0;
+        double inverseError = 0.0;
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            forwardError = std::max(forwardError, vsg::length(ecef[i] - reference[i]));
+            auto roundTrip = glm2vsg(Ellipsoid::WGS84.cartographicToCartesian(
+                                         Cartographic(inverse[i].x, inverse[i].y, inverse[i].z)));
+            inverseError = std::max(inverseError, vsg::length(roundTrip - reference[i]));
+        }
+        vsg::info("geodetic to ECEF, ", numPoints, " points: cesium-native ", cesiumForward, " ms, kernel ",
+                  kernelForward, " ms, max difference ", forwardError, " m");
+        vsg::info("ECEF to geodetic, ", numPoints, " points: cesium-native ", cesiumInverse, " ms, kernel ",
+                  kernelInverse, " ms, max error ", inverseError, " m");
+        return std::max(forwardError, inverseError);
+    }
+}
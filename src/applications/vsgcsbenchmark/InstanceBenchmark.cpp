@@ -0,0 +1,133 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include "vsgCs/InstancedModel.h"
+
+#include <vsg/app/RecordTraversal.h>
+#include <vsg/app/ViewMatrix.h>
+#include <vsg/app/ProjectionMatrix.h>
+#include <vsg/io/Logger.h>
+#include <vsg/maths/transform.h>
+#include <vsg/nodes/CullNode.h>
+#include <vsg/nodes/MatrixTransform.h>
+#include <vsg/ui/FrameStamp.h>
+#include <vsg/vk/State.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace vsgCs
+{
+    void benchmarkInstancedModel(size_t numInstances)
+    {
+        using clock = std::chrono::steady_clock;
+        auto ms = [](clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+        // Trees scattered over a 10 km square
+        auto instances = vsg::dmat4Array::create(numInstances);
+        for (size_t i = 0; i < numInstances; ++i)
+        {
+            const double u = static_cast<double>((i * 7919) % 10007) / 10006.0 * 10000.0 - 5000.0;
+            const double v = static_cast<double>((i * 104729) % 10009) / 10008.0 * 10000.0 - 5000.0;
+            const double heading = static_cast<double>(i % 360);
+            instances->at(i) = vsg::translate(u, v, 0.0) * vsg::rotate(vsg::radians(heading), 0.0, 0.0, 1.0);
+        }
+        const vsg::dsphere modelBound(vsg::dvec3(0.0, 0.0, 5.0), 6.0);
+        // No Vulkan commands are recorded, so the model itself can be empty.
+        auto sharedModel = vsg::Group::create();
+        auto transforms = vsg::Group::create();
+        for (size_t i = 0; i < numInstances; ++i)
+        {
+            auto transform = vsg::MatrixTransform::create(instances->at(i));
+            transform->addChild(vsg::CullNode::create(modelBound, sharedModel));
+            transforms->addChild(transform);
+        }
+        // What ModelBuilder would build for a model with one node
+        auto makeInstanced = [&](const vsg::ref_ptr<vsg::dmat4Array>& matrices)
+        {
+            auto instancedRoot = vsg::Group::create();
+            auto bindings = InstanceBindings::create();
+            InstanceBinding binding;
+            binding.levels.resize(1);
+            for (size_t j = 0; j < 3; ++j)
+            {
+                binding.source[j] = vsg::vec4Array::create(numInstances);
+                binding.levels[0].live[j] = vsg::vec4Array::create(numInstances);
+                for (size_t i = 0; i < numInstances; ++i)
+                {
+                    const vsg::dmat4& m = matrices->at(i);
+                    binding.source[j]->at(i) = binding.levels[0].live[j]->at(i)
+                        = vsg::vec4(vsg::dvec4(m(0, j), m(1, j), m(2, j), m(3, j)));
+                }
+            }
+            bindings->bindings.push_back(binding);
+            bindings->modelBound = modelBound;
+            instancedRoot->setObject("vsgCs_instanceBindings", bindings);
+            return InstancedModel::create(matrices, instancedRoot);
+        };
+        auto instanced = makeInstanced(instances);
+        std::vector<vsg::dmat4> gridMatrices(instances->begin(), instances->end());
+        const auto cells = sortInstancesIntoGrid(gridMatrices, 500.0);
+        auto gridInstances = vsg::dmat4Array::create(numInstances);
+        std::copy(gridMatrices.begin(), gridMatrices.end(), gridInstances->begin());
+        auto gridInstanced = makeInstanced(gridInstances);
+        gridInstanced->setCells(cells);
+        auto thinnedInstanced = makeInstanced(gridInstances);
+        thinnedInstanced->setCells(cells);
+        thinnedInstanced->thinningDistance = 3000.0;
+
+        auto recordTraversal = vsg::RecordTraversal::create();
+        auto perspective = vsg::Perspective::create(60.0, 16.0 / 9.0, 1.0, 20000.0);
+        const int numFrames = 100;
+        auto record = [&](vsg::Node& node)
+        {
+            auto start = clock::now();
+            for (int frame = 0; frame < numFrames; ++frame)
+            {
+                // Circle above the square, looking at its center
+                const double angle = vsg::radians(frame * 3.6);
+                auto lookAt = vsg::LookAt::create(vsg::dvec3(6000.0 * std::cos(angle), 6000.0 * std::sin(angle), 1500.0),
+                                                  vsg::dvec3(0.0, 0.0, 0.0), vsg::dvec3(0.0, 0.0, 1.0));
+                recordTraversal->setFrameStamp(vsg::FrameStamp::create(clock::now(), frame));
+                recordTraversal->getState()->setProjectionAndViewMatrix(perspective->transform(), lookAt->transform());
+                node.accept(*recordTraversal);
+            }
+            return ms(start) / numFrames;
+        };
+        const double transformTime = record(*transforms);
+        const double instancedTime = record(*instanced);
+        const double gridTime = record(*gridInstanced);
+        const double thinnedTime = record(*thinnedInstanced);
+        vsg::info("model instances, ", numInstances, ": transforms ", transformTime, " ms, instanced ",
+                  instancedTime, " ms per record traversal, ", instanced->getNumVisible(), " visible in the last frame");
+        vsg::info(cells.size(), " grid cells: ", gridTime, " ms, thinned beyond 3 km: ", thinnedTime, " ms, ",
+                  thinnedInstanced->getNumVisible(), " visible");
+    }
+}
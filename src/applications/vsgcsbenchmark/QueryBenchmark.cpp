@@ -0,0 +1,79 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include "vsgCs/FeatureIndex.h"
+
+#include <vsg/io/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace vsgCs
+{
+    void benchmarkFeatureQueries(size_t numFeatures)
+    {
+        using clock = std::chrono::steady_clock;
+        auto ms = [](clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+        const auto columns = makeBenchmarkColumns(numFeatures);
+        auto start = clock::now();
+        auto heightIndex = FeatureIndex::create(*columns.find("height"), numFeatures);
+        auto typeIndex = FeatureIndex::create(*columns.find("type"), numFeatures);
+        vsg::info("indexed ", numFeatures, " features: ", ms(start), " ms");
+
+        std::vector<uint32_t> rows;
+        std::vector<uint8_t> selected;
+        auto scan = [&](const std::string& source)
+        {
+            auto expression = StyleExpression::create(source);
+            auto scanStart = clock::now();
+            expression->evaluate(columns, selected);
+            size_t count = std::count(selected.begin(), selected.end(), 1);
+            vsg::info("  scan \"", source, "\": ", count, " features, ", ms(scanStart), " ms");
+        };
+        start = clock::now();
+        heightIndex->select(FeatureCompare::GREATER, 190.0, rows);
+        vsg::info("  index height > 190: ", rows.size(), " features, ", ms(start), " ms");
+        scan("${height} > 190");
+        start = clock::now();
+        typeIndex->select("school", true, rows);
+        vsg::info("  index type === 'school': ", rows.size(), " features, ", ms(start), " ms");
+        scan("${type} === 'school'");
+
+        // Feature info lookups go directly from a feature ID to its row.
+        const auto& height = columns.find("height")->numbers;
+        start = clock::now();
+        double sum = 0.0;
+        for (size_t i = 0; i < numFeatures; ++i)
+        {
+            sum += height[(i * 7919) % numFeatures];
+        }
+        vsg::info("  ", numFeatures, " feature ID lookups: ", ms(start), " ms (checksum ", sum, ")");
+    }
+}
@@ -0,0 +1,73 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include <vsg/io/Logger.h>
+
+#include <chrono>
+#include <vector>
+
+namespace vsgCs
+{
+    StyleColumns makeBenchmarkColumns(size_t numFeatures)
+    {
+        StyleColumns columns;
+        columns.size = numFeatures;
+        auto& id = columns.columns["id"];
+        auto& height = columns.columns["height"];
+        auto& type = columns.columns["type"];
+        auto& occupied = columns.columns["occupied"];
+        type.type = StyleColumn::STRING;
+        type.dictionary = {"residential", "commercial", "industrial", "school",
+                           "hospital", "church", "office", "warehouse"};
+        occupied.type = StyleColumn::BOOLEAN;
+        id.numbers.resize(numFeatures);
+        height.numbers.resize(numFeatures);
+        type.stringIDs.resize(numFeatures);
+        occupied.booleans.resize(numFeatures);
+        for (size_t i = 0; i < numFeatures; ++i)
+        {
+            id.numbers[i] = static_cast<double>(i);
+            height.numbers[i] = static_cast<double>((i * 7919) % 2000) * 0.1;
+            type.stringIDs[i] = static_cast<int32_t>((i * 31) % type.dictionary.size());
+            occupied.booleans[i] = static_cast<uint8_t>(i % 3 != 0);
+        }
+        return columns;
+    }
+
+    double benchmarkStyleExpression(const std::string& colorExpression, size_t numFeatures)
+    {
+        auto expression = StyleExpression::create(colorExpression);
+        const auto columns = makeBenchmarkColumns(numFeatures);
+        std::vector<vsg::vec4> colors;
+        auto start = std::chrono::steady_clock::now();
+        expression->evaluate(columns, colors);
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        vsg::info("styled ", numFeatures, " features with \"", colorExpression, "\" in ",
+                  seconds * 1000.0, " ms (", numFeatures / seconds / 1.0e6, " million features/s)");
+        return seconds;
+    }
+}
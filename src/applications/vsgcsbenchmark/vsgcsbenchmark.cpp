@@ -0,0 +1,117 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Benchmarks.h"
+
+#include <vsg/io/Logger.h>
+#include <vsg/utils/CommandLine.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+void usage(const char* name)
+{
+    std::cout
+        << "\nUsage: " << name << " <options>\n\n"
+        << "Run benchmarks of vsgCs on synthetic data. Options, which may be combined:\n"
+        << "--style expr\t\t time a color style expression over synthetic features with\n"
+        << "\t\t\t properties id, height, type and occupied\n"
+        << "--query\t\t\t time feature index construction and queries over synthetic features\n"
+        << "--crs crs\t\t time converting points from a CRS (e.g. epsg:32619) to ECEF and back,\n"
+        << "\t\t\t one at a time and in a batch\n"
+        << "--geodetic\t\t check the accuracy of the WGS84 geodetic <-> ECEF kernels and time them;\n"
+        << "\t\t\t exits with 1 if a check fails\n"
+        << "--bvh\t\t\t time building a tile BVH and segment queries with and without it\n"
+        << "--instance\t\t time recording model instances with transforms and with instancing\n"
+        << "--count n\t\t the number of features, points, triangles or instances to use\n"
+        << "--log-level level\t vsg logging level\n"
+        << "--help\t\t\t print this message\n";
+}
+}
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+
+    if (argc < 2 || arguments.read({"--help", "-h", "-?"}))
+    {
+        usage(argv[0]);
+        return 0;
+    }
+    if (int log_level = 0; arguments.read("--log-level", log_level))
+    {
+        vsg::Logger::instance()->level = static_cast<vsg::Logger::Level>(log_level);
+    }
+    // Each benchmark has its own default size.
+    auto count = arguments.value<size_t>(0, "--count");
+    auto size = [count](size_t defaultSize)
+    {
+        return count > 0 ? count : defaultSize;
+    };
+    int result = 0;
+    try
+    {
+        if (std::string styleExpr; arguments.read("--style", styleExpr))
+        {
+            vsgCs::benchmarkStyleExpression(styleExpr, size(1000000));
+        }
+        if (arguments.read("--query"))
+        {
+            vsgCs::benchmarkFeatureQueries(size(1000000));
+        }
+        if (std::string crsName; arguments.read("--crs", crsName))
+        {
+            vsgCs::benchmarkCRS(crsName, size(1000000));
+        }
+        if (arguments.read("--geodetic"))
+        {
+            if (!vsgCs::checkGeodeticKernels(size(1000000)))
+            {
+                result = 1;
+            }
+            vsgCs::benchmarkGeodeticKernels(size(1000000));
+        }
+        if (arguments.read("--bvh"))
+        {
+            vsgCs::benchmarkTileBVH(size(500000));
+        }
+        if (arguments.read("--instance"))
+        {
+            vsgCs::benchmarkInstancedModel(size(100000));
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (arguments.errors())
+    {
+        return arguments.writeErrorMessages(std::cerr);
+    }
+    return result;
+}
@@ -125,6 +125,15 @@ namespace vsgCs
         return _renderImGui;
     }
 
+    void UI::setTerrainService(const vsg::ref_ptr<TerrainService>& terrainService)
+    {
+        if (_mapManipulator)
+        {
+            _mapManipulator->setTerrainService(terrainService);
+            _mapManipulator->getSettings()->setTerrainAvoidanceEnabled(terrainService.valid());
+        }
+    }
+
     void UI::setViewpoint(const vsg::ref_ptr<vsg::LookAt>& lookAt, float duration)
     {
         if (_mapManipulator)
@@ -51,6 +51,7 @@ namespace vsgCs
             return _renderImGui;
         }
         void setViewpoint(const vsg::ref_ptr<vsg::LookAt>& lookAt, float duration);
+        void setTerrainService(const vsg::ref_ptr<TerrainService>& terrainService);
         protected:
         vsg::ref_ptr<vsgImGui::RenderImGui> createImGui(const vsg::ref_ptr<vsg::Window>& window);
 
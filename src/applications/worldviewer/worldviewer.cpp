@@ -47,18 +47,26 @@ SOFTWARE.
 #include "vsgCs/CppAllocator.h"
 #endif
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #include <vector>
 
+#include "vsgCs/Geodetic.h"
 #include "vsgCs/GeoNode.h"
 #include "vsgCs/GltfLoader.h"
 #include "vsgCs/jsonUtils.h"
+#include "vsgCs/OpThreadTaskProcessor.h"
+#include "vsgCs/TerrainService.h"
 #include "vsgCs/TilesetNode.h"
 #include "vsgCs/Tracing.h"
 #include "vsgCs/TracingCommandGraph.h"
 #include "vsgCs/RuntimeEnvironment.h"
+#include "vsgCs/SessionState.h"
+#include "vsgCs/StyleExpression.h"
 #include "vsgCs/WorldNode.h"
 #include "UI.h"
 #include "CsApp/CsViewer.h"
@@ -79,6 +87,17 @@ void usage(const char* name)
         << "--poi lat lon\t\t coordinates of initial point of interest\n"
         << "--distance dist\t\t distance from point of interest\n"
         << "--time HH::MM\t\t time in UTC (default 12:00)\n"
+        << "-2\t\t\t two side-by-side views\n"
+        << "--second-view-role role\t shadow, reflection or minimap: coarser tiles in the right view with -2\n"
+        << "--fragment-stats\t print fragment shader invocations per frame (e.g. with --depth-prepass)\n"
+        << "--restyle expr\t\t press 'r' to toggle tileset feature colors between their style and expr\n"
+        << "--terrain\t\t keep the tilesets' triangles and intersect them in worker threads when\n"
+        << "\t\t\t moving the camera\n"
+        << "--terrain-height\t press 'h' to print the camera's height above the loaded terrain;\n"
+        << "\t\t\t implies --terrain\n"
+        << "--watch-world\t\t reload the world file when it changes, rebuilding only what changed\n"
+        << "--session file\t\t start from the camera and tiles saved in file, and save them on exit;\n"
+        << "\t\t\t reports the time to full detail\n"
         << "--help\t\t\t print this message\n"
         << "--local-model\t\t treat tilesets as model with trackball navigation\n";
 }
@@ -93,11 +112,14 @@ public:
         createScenegraph();
     }
     vsg::ref_ptr<vsgCs::WorldNode> worldNode;
+    // The file that worldNode was read from, if any
+    std::string worldFile;
     vsg::ref_ptr<vsg::StateGroup> xchangeModels;
     std::vector<vsg::ref_ptr<vsgCs::TilesetNode>> tilesetNodes;
 
     void createScenegraph()
     {
+        std::vector<vsgCs::GltfLoader::ModelRequest> gltfRequests;
         for (int i = 1; i < arguments.argc(); ++i)
         {
             std::string argString(arguments[i]);
@@ -116,6 +138,10 @@ public:
             {
                 addVsgCsObject(arguments[i]);
             }
+            else if (argString.ends_with(".gltf") || argString.ends_with(".glb"))
+            {
+                gltfRequests.push_back({argString, env->options});
+            }
             else
             {
                 vsg::Path filename = arguments[i];
@@ -125,6 +151,7 @@ public:
                 }
             }
         }
+        readGltfModels(gltfRequests);
         if (!worldNode && !tilesetNodes.empty())
         {
             worldNode = vsgCs::WorldNode::create();
@@ -134,6 +161,31 @@ public:
     }
 
 private:
+    // Read all the glTF models at once.
+    void readGltfModels(const std::vector<vsgCs::GltfLoader::ModelRequest>& requests)
+    {
+        if (requests.empty())
+        {
+            return;
+        }
+        auto loader = vsgCs::GltfLoader::create(env);
+        auto future = loader->readBatchAsync(requests, [](size_t numRead, size_t numModels)
+        {
+            vsg::info("Read ", numRead, " of ", numModels, " glTF models");
+        });
+        while (!future.isReady())
+        {
+            vsgCs::getAsyncSystem().dispatchMainThreadTasks();
+        }
+        for (const auto& node : future.wait())
+        {
+            if (node)
+            {
+                addToXchangeModels(node);
+            }
+        }
+    }
+
     void addToXchangeModels(const vsg::ref_ptr<vsg::Node>& node)
     {
         if (!xchangeModels)
@@ -154,6 +206,7 @@ private:
         if (auto maybeWorldNode = vsgCs::ref_ptr_cast<vsgCs::WorldNode>(object))
         {
             worldNode = maybeWorldNode;
+            worldFile = fileName;
         }
         else if (auto maybeTilesetNode = vsgCs::ref_ptr_cast<vsgCs::TilesetNode>(object))
         {
@@ -203,6 +256,197 @@ private:
     vsg::ref_ptr<vsgCs::RuntimeEnvironment> env;
 };
 
+// Reload the world file when it is saved. Only the tilesets, overlays and models whose
+// definitions changed are built again.
+class WorldFileWatcher
+{
+public:
+    WorldFileWatcher(const std::string& fileName, const vsg::ref_ptr<vsgCs::WorldNode>& worldNode,
+                     const vsg::ref_ptr<vsg::Viewer>& viewer, const vsg::ref_ptr<const vsg::Options>& options,
+                     const vsg::ref_ptr<vsgCs::TerrainService>& terrain)
+        : _path(vsg::findFile(fileName, options).string()), _worldNode(worldNode), _viewer(viewer),
+          _terrain(terrain)
+    {
+        std::error_code ec;
+        _writeTime = std::filesystem::last_write_time(_path, ec);
+    }
+
+    void check()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - _lastCheck < std::chrono::seconds(1))
+        {
+            return;
+        }
+        _lastCheck = now;
+        std::error_code ec;
+        auto writeTime = std::filesystem::last_write_time(_path, ec);
+        if (ec || writeTime == _writeTime)
+        {
+            return;
+        }
+        _writeTime = writeTime;
+        auto source = vsgCs::readFile(_path);
+        rapidjson::Document document;
+        document.Parse(source.data(), source.size());
+        if (document.HasParseError())
+        {
+            vsg::warn("Error parsing ", _path, ": error code ", document.GetParseError(),
+                      " at byte ", document.GetErrorOffset());
+            return;
+        }
+        try
+        {
+            auto stats = _worldNode->reload(document, _viewer);
+            if (_terrain)
+            {
+                for (const auto& tilesetNode : stats.removedTilesets)
+                {
+                    _terrain->removeTileset(tilesetNode);
+                }
+                for (const auto& tilesetNode : stats.builtTilesets)
+                {
+                    _terrain->addTileset(tilesetNode);
+                }
+            }
+            vsg::info("Reloaded ", _path, " in ",
+                      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - now).count(),
+                      " ms. Tilesets kept: ", stats.tilesetsKept, " built: ", stats.tilesetsBuilt,
+                      " removed: ", stats.tilesetsRemoved, ". Models kept: ", stats.modelsKept,
+                      " built: ", stats.modelsBuilt, " removed: ", stats.modelsRemoved);
+        }
+        catch (const std::exception& e)
+        {
+            vsg::warn("Can't reload ", _path, ": ", e.what());
+        }
+    }
+private:
+    std::string _path;
+    vsg::ref_ptr<vsgCs::WorldNode> _worldNode;
+    vsg::ref_ptr<vsg::Viewer> _viewer;
+    // Tilesets built by a reload are added to the terrain service, if there is one.
+    vsg::ref_ptr<vsgCs::TerrainService> _terrain;
+    std::filesystem::file_time_type _writeTime;
+    std::chrono::steady_clock::time_point _lastCheck;
+};
+
+// Count the fragment shader invocations of the views with a pipeline statistics query. This is
+// a good measure of overdraw on a software rasterizer such as lavapipe.
+class FragmentStats
+{
+public:
+    void attach(const vsg::ref_ptr<vsg::CommandGraph>& commandGraph,
+                const vsg::ref_ptr<vsg::RenderGraph>& renderGraph)
+    {
+        queryPool = vsg::QueryPool::create();
+        queryPool->queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        queryPool->queryCount = 1;
+        queryPool->pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        // The query must be reset outside of the render pass.
+        auto rgItr = std::find(commandGraph->children.begin(), commandGraph->children.end(), renderGraph);
+        commandGraph->children.insert(rgItr, vsg::ResetQueryPool::create(queryPool));
+        renderGraph->children.insert(renderGraph->children.begin(), vsg::BeginQuery::create(queryPool, 0, 0));
+        renderGraph->addChild(vsg::EndQuery::create(queryPool, 0));
+    }
+
+    void report(const vsg::ref_ptr<vsg::Viewer>& viewer)
+    {
+        if (!queryPool || ++frames % reportInterval != 0)
+        {
+            return;
+        }
+        // Only done occasionally, so waiting for the device is OK.
+        viewer->deviceWaitIdle();
+        std::vector<uint64_t> results(1);
+        if (queryPool->getResults(results) == VK_SUCCESS)
+        {
+            std::cout << "frame " << frames << ": " << results[0] << " fragment shader invocations\n";
+        }
+    }
+    vsg::ref_ptr<vsg::QueryPool> queryPool;
+    uint64_t frames = 0;
+    const uint64_t reportInterval = 100;
+};
+
+// Switch the feature colors of the tilesets between their original style and another style at
+// runtime, without reloading any tiles.
+class RestyleHandler : public vsg::Inherit<vsg::Visitor, RestyleHandler>
+{
+public:
+    RestyleHandler(const vsg::ref_ptr<vsgCs::WorldNode>& in_worldNode, const std::string& colorExpr)
+    {
+        for (const auto& node : in_worldNode->tilesetNodes())
+        {
+            auto tilesetNode = vsgCs::ref_ptr_cast<vsgCs::TilesetNode>(node);
+            if (!tilesetNode)
+            {
+                continue;
+            }
+            auto original = tilesetNode->styling ? tilesetNode->styling : vsgCs::Styling::create();
+            auto restyled = vsgCs::Styling::create();
+            restyled->show = original->show;
+            restyled->showExpression = original->showExpression;
+            restyled->colorExpression = vsgCs::StyleExpression::create(colorExpr);
+            tilesets.push_back({tilesetNode, original, restyled});
+        }
+    }
+
+    void apply(vsg::KeyPressEvent& keyPress) override
+    {
+        if (keyPress.keyBase != 'r')
+        {
+            return;
+        }
+        restyled = !restyled;
+        for (const auto& tileset : tilesets)
+        {
+            tileset.node->setStyling(restyled ? tileset.restyled : tileset.original);
+        }
+        keyPress.handled = true;
+    }
+    struct Tileset
+    {
+        vsg::ref_ptr<vsgCs::TilesetNode> node;
+        vsg::ref_ptr<vsgCs::Styling> original;
+        vsg::ref_ptr<vsgCs::Styling> restyled;
+    };
+    std::vector<Tileset> tilesets;
+    bool restyled = false;
+};
+
+// Print the height of the camera above the terrain of the loaded tiles.
+class TerrainHeightHandler : public vsg::Inherit<vsg::Visitor, TerrainHeightHandler>
+{
+public:
+    TerrainHeightHandler(const vsg::ref_ptr<vsgCs::TerrainService>& in_terrain,
+                         const vsg::ref_ptr<vsg::Camera>& in_camera)
+        : terrain(in_terrain), camera(in_camera)
+    {
+    }
+
+    void apply(vsg::KeyPressEvent& keyPress) override
+    {
+        if (keyPress.keyBase != 'h')
+        {
+            return;
+        }
+        vsg::dvec3 eye = vsg::inverse(camera->viewMatrix->transform()) * vsg::dvec3(0.0, 0.0, 0.0);
+        vsg::dvec3 cartographic = vsgCs::ecefToGeodetic(eye);
+        if (auto height = terrain->getHeight(cartographic.x, cartographic.y))
+        {
+            std::cout << "terrain height " << *height << " m, camera " << cartographic.z - *height
+                      << " m above terrain (" << terrain->getNumTiles() << " tiles)\n";
+        }
+        else
+        {
+            std::cout << "no loaded terrain below the camera (" << terrain->getNumTiles() << " tiles)\n";
+        }
+        keyPress.handled = true;
+    }
+    vsg::ref_ptr<vsgCs::TerrainService> terrain;
+    vsg::ref_ptr<vsg::Camera> camera;
+};
+
 class ViewState
 {
 public:
@@ -219,6 +463,7 @@ public:
         horizonMountainHeight = arguments.value(0.0, "--hmh");
         maxShadowDistance = arguments.value<double>(10000.0, "--sd");
         twoCameras = arguments.read({"-2"});
+        secondViewRole = arguments.value(std::string(), "--second-view-role");
         localModel = arguments.read({"--local-model"});
         if (localModel)
         {
@@ -241,7 +486,11 @@ public:
 
         // set up the camera
         vsg::ref_ptr<vsg::ProjectionMatrix> perspective;
-        if (!localModel && poi_latitude != invalid_value && poi_longitude != invalid_value)
+        if (savedCamera)
+        {
+            lookAt = vsg::LookAt::create(savedCamera->eye, savedCamera->center, savedCamera->up);
+        }
+        else if (!localModel && poi_latitude != invalid_value && poi_longitude != invalid_value)
         {
             double height = (poi_distance != invalid_value) ? poi_distance : radius * 3.5;
             auto ecef = ellipsoidModel->convertLatLongAltitudeToECEF({poi_latitude, poi_longitude, 0.0});
@@ -279,6 +528,13 @@ public:
                                                            zNear, zFar);
             views.emplace_back(vsg::View::create(vsg::Camera::create(lproj, lookAt, lvp)));
             views.emplace_back(vsg::View::create(vsg::Camera::create(rproj, lookAt, rvp)));
+            for (auto role : {vsgCs::SHADOW_VIEW, vsgCs::REFLECTION_VIEW, vsgCs::MINIMAP_VIEW})
+            {
+                if (secondViewRole == vsgCs::getViewRoleName(role))
+                {
+                    vsgCs::setViewRole(views.back(), role);
+                }
+            }
         }
         else
         {
@@ -302,6 +558,8 @@ public:
         return views;
     }
     bool setViewpointAfterLoad = false;
+    // The camera of the last session, for a warm start
+    std::optional<vsgCs::SessionState::Camera> savedCamera;
     std::vector<vsg::ref_ptr<vsg::View>> views;
     bool useEllipsoidPerspective = true;
     double horizonMountainHeight = 0.0;
@@ -311,6 +569,7 @@ public:
     double poi_longitude = invalid_value;
     double poi_distance = invalid_value;
     bool twoCameras = false;
+    std::string secondViewRole;
     bool localModel = false;
 
     vsg::ref_ptr<vsg::LookAt> lookAt;
@@ -398,6 +657,12 @@ int main(int argc, char** argv)
         auto shadowMaps = arguments.value<uint32_t>(0, "--shadow-maps");
 #endif
         bool debugManipulator = arguments.read({"--debug-manipulator"});
+        bool fragmentStats = arguments.read({"--fragment-stats"});
+        auto restyleExpr = arguments.value(std::string(), "--restyle");
+        bool terrainHeight = arguments.read("--terrain-height");
+        bool useTerrain = arguments.read("--terrain") || terrainHeight;
+        bool watchWorld = arguments.read("--watch-world");
+        auto sessionFile = arguments.value(std::string(), "--session");
 
         if (arguments.errors())
         {
@@ -459,6 +724,12 @@ int main(int argc, char** argv)
             vsg_scene->addChild(modelRoot);
         }
         viewer->addWindow(window);
+        vsgCs::SessionState session;
+        const bool warmStart = !sessionFile.empty() && session.read(sessionFile);
+        if (warmStart && !viewState.localModel)
+        {
+            viewState.savedCamera = session.camera;
+        }
         auto views = viewState.createViews();
         // Basic VSG objects for rendering
         auto commandGraph = vsgCs::TracingCommandGraph::create(environment, window);
@@ -475,6 +746,18 @@ int main(int argc, char** argv)
             view->addChild(vsg_scene);
             renderGraph->addChild(view);
         }
+        FragmentStats stats;
+        if (fragmentStats)
+        {
+            if (environment->features.pipelineStatisticsQuery)
+            {
+                stats.attach(commandGraph, renderGraph);
+            }
+            else
+            {
+                std::cout << "Pipeline statistics queries are not supported.\n";
+            }
+        }
         // Create this application's user interface, including the trackball manipulator and the
         // graphical overlay.
         auto ui = vsgCs::UI::create();
@@ -482,6 +765,18 @@ int main(int argc, char** argv)
         ui->createUI(window, viewer, uiCamera, ellipsoidModel, environment->options, worldNode, vsg_scene,
                      environment, debugManipulator);
         ui->setViewpoint(viewState.lookAt, 0.0);
+        if (!restyleExpr.empty())
+        {
+            try
+            {
+                viewer->addEventHandler(RestyleHandler::create(worldNode, restyleExpr));
+            }
+            catch (const std::runtime_error& e)
+            {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
         // Attach the ImGui graphical interface
         renderGraph->addChild(ui->getImGui());
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
@@ -489,6 +784,30 @@ int main(int argc, char** argv)
         // Perform any late initialization of TilesetNode objects. Most importantly, this tracks VSG
         // cameras so that they can be used by cesium-native to determine visible tiles.
         worldNode->initialize(viewer);
+        if (warmStart)
+        {
+            session.prefetch(*worldNode);
+        }
+        vsg::ref_ptr<vsgCs::TerrainService> terrain;
+        if (useTerrain)
+        {
+            // The manipulator intersects the terrain in worker threads using the tiles' triangles,
+            // which the tilesets keep once they are added to the terrain service.
+            terrain = vsgCs::TerrainService::create();
+            for (const auto& node : worldNode->tilesetNodes())
+            {
+                if (auto tilesetNode = vsgCs::ref_ptr_cast<vsgCs::TilesetNode>(node))
+                {
+                    terrain->addTileset(tilesetNode);
+                }
+            }
+            terrain->attach(viewer);
+            ui->setTerrainService(terrain);
+            if (terrainHeight)
+            {
+                viewer->addEventHandler(TerrainHeightHandler::create(terrain, uiCamera));
+            }
+        }
 
         // Compile everything we can at this point.
         //
@@ -500,13 +819,36 @@ int main(int argc, char** argv)
         // viewer->compile(resourceHints);
         viewer->compile();
 
+        std::optional<WorldFileWatcher> worldWatcher;
+        if (watchWorld && !graphBuilder.worldFile.empty())
+        {
+            worldWatcher.emplace(graphBuilder.worldFile, worldNode, viewer, environment->options, terrain);
+        }
+
         auto lastAct = gsl::finally([worldNode]() {
             vsgCs::shutdown();
             worldNode->shutdown();});
 
+        auto loopStart = std::chrono::steady_clock::now();
+        bool fullDetailReported = sessionFile.empty();
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
+            if (!fullDetailReported && !worldNode->tilesetNodes().empty()
+                && std::all_of(worldNode->tilesetNodes().begin(), worldNode->tilesetNodes().end(),
+                               [](const vsg::ref_ptr<vsg::Node>& node)
+                               {
+                                   auto tilesetNode = vsgCs::ref_ptr_cast<vsgCs::TilesetNode>(node);
+                                   return !tilesetNode || tilesetNode->isFullyLoaded();
+                               }))
+            {
+                vsg::info("Full detail after ",
+                          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                    - loopStart).count(),
+                          " ms (", warmStart ? "warm" : "cold", " start)");
+                fullDetailReported = true;
+            }
             if (viewState.setViewpointAfterLoad
                 && worldNode->getRootTile())
             {
@@ -516,6 +858,10 @@ int main(int argc, char** argv)
                 ui->setViewpoint(lookAt, 1.0);
                 viewState.setViewpointAfterLoad = false;
             }
+            if (worldWatcher)
+            {
+                worldWatcher->check();
+            }
             // pass any events into EventHandlers assigned to the Viewer
             viewer->handleEvents();
             // XXX This should be moved to vsg::Viewer update operation.
@@ -530,8 +876,15 @@ int main(int argc, char** argv)
             }
 
             viewer->present();
+            stats.report(viewer);
             VSGCS_FRAMEMARK;
         }
+        if (!sessionFile.empty())
+        {
+            auto lookAt = uiCamera->viewMatrix.cast<vsg::LookAt>();
+            session.capture(*worldNode, lookAt ? *lookAt : *viewState.lookAt);
+            session.write(sessionFile);
+        }
     }
     catch (const vsg::Exception& ve)
     {
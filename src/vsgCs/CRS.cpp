@@ -30,6 +30,7 @@ SOFTWARE.
  */
 
 #include "CRS.h"
+#include "Geodetic.h"
 
 #include "vsgCs/Config.h"
 #include "runtimeSupport.h"
@@ -44,7 +45,15 @@ SOFTWARE.
 #include <proj.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace vsgCs
 {
@@ -62,10 +71,24 @@ namespace vsgCs
     }
 
 
-    //! Per thread proj threading context.
-    thread_local PJ_CONTEXT* g_pj_thread_local_context = nullptr;
+    //! Create a PROJ context. A context, and the objects created with it, may only be used by one
+    //! thread at a time.
+    PJ_CONTEXT* create_proj_context()
+    {
+        PJ_CONTEXT* ctx = proj_context_create();
+        proj_log_func(ctx, nullptr, redirect_proj_log);
+        proj_context_set_enable_network(ctx, 1);
+#ifdef VSGCS_FULL_PROJ_DATA_DIR
+        if (!getenv("PROJ_DATA"))
+        {
+            const char *paths[] = { VSGCS_FULL_PROJ_DATA_DIR };
+            proj_context_set_search_paths(ctx, 1, paths);
+        }
+#endif
+        return ctx;
+    }
 
-    //! Entry in the per-thread SRS data cache
+    //! Entry in the SRS data cache
     struct SRSEntry
     {
         PJ* pj = nullptr;
@@ -77,10 +100,12 @@ namespace vsgCs
     };
 
 
-    //! SRS data factory and PROJ main interface
+    //! SRS data factory and PROJ main interface. There is one factory for the process, in
+    //! ProjRegistry, and it must only be used with the registry's mutex held.
     struct SRSFactory
     {
         std::unordered_map<std::string, SRSEntry> umap;
+        PJ_CONTEXT* context = create_proj_context();
         static const std::string empty_string;
 
         //! destroy cache entries and threading context upon descope
@@ -97,30 +122,12 @@ namespace vsgCs
                 }
             }
 
-            if (g_pj_thread_local_context)
-            {
-                    proj_context_destroy(g_pj_thread_local_context);
-            }
+            proj_context_destroy(context);
         }
 
-        static PJ_CONTEXT* threading_context()
+        PJ_CONTEXT* threading_context() const
         {
-            if (g_pj_thread_local_context == nullptr)
-            {
-                g_pj_thread_local_context = proj_context_create();
-                proj_log_func(g_pj_thread_local_context, nullptr, redirect_proj_log);
-                proj_context_set_enable_network(g_pj_thread_local_context, 1);
-#ifdef VSGCS_FULL_PROJ_DATA_DIR
-                if (!getenv("PROJ_DATA"))
-                {
-                    const char *paths[] = { VSGCS_FULL_PROJ_DATA_DIR };
-                    proj_context_set_search_paths(g_pj_thread_local_context,
-                                                  1,
-                                                  paths);
-                }
-#endif
-            }
-            return g_pj_thread_local_context;
+            return context;
         }
 
         const std::string& get_error_message(const std::string& def)
@@ -466,10 +473,123 @@ namespace vsgCs
 
     const std::string SRSFactory::empty_string;
 
-    // create an SRS repo per thread since proj is not thread safe.
-    thread_local SRSFactory g_srs_factory;
+    //! The process-wide registry of CRS definitions and normalized operations. Creating an
+    //! operation searches the PROJ database and can take tens of milliseconds, so it is done once
+    //! per process; each thread then uses a cheap clone.
+    struct ProjRegistry
+    {
+        std::mutex mutex;
+        SRSFactory factory;
+
+        static ProjRegistry& get()
+        {
+            static ProjRegistry registry;
+            return registry;
+        }
+
+        //! The operation from a CRS to ECEF, owned by the registry; only use it while holding the
+        //! mutex.
+        PJ* get_operation_locked(const std::string& def)
+        {
+            return factory.get_or_create_operation(def, "ecef");
+        }
+
+        CesiumGeospatial::Ellipsoid get_ellipsoid(const std::string& def)
+        {
+            std::lock_guard lock(mutex);
+            return factory.get_ellipsoid(def);
+        }
+    };
+
+    //! Per-thread clones of the registry's operations, with the thread's PROJ context
+    struct ThreadOperations
+    {
+        PJ_CONTEXT* context = nullptr;
+        std::unordered_map<std::string, PJ*> operations;
+        std::unordered_map<std::string, CesiumGeospatial::Ellipsoid> ellipsoids;
+
+        ~ThreadOperations()
+        {
+            for (auto& [def, pj] : operations)
+            {
+                if (pj)
+                {
+                    proj_destroy(pj);
+                }
+            }
+            if (context)
+            {
+                proj_context_destroy(context);
+            }
+        }
+
+        PJ* get_operation(const std::string& def)
+        {
+            auto iter = operations.find(def);
+            if (iter != operations.end())
+            {
+                return iter->second;
+            }
+            const auto startTime = std::chrono::steady_clock::now();
+            if (!context)
+            {
+                context = create_proj_context();
+            }
+            PJ* clone = nullptr;
+            {
+                auto& registry = ProjRegistry::get();
+                std::lock_guard lock(registry.mutex);
+                if (PJ* pj = registry.get_operation_locked(def))
+                {
+                    clone = proj_clone(context, pj);
+                }
+            }
+            operations[def] = clone;
+            vsg::debug("PROJ operation ", def, " -> ECEF ready in thread ", std::this_thread::get_id(), " after ",
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count(),
+                       " ms");
+            return clone;
+        }
+
+        const CesiumGeospatial::Ellipsoid& get_ellipsoid(const std::string& def)
+        {
+            auto iter = ellipsoids.find(def);
+            if (iter == ellipsoids.end())
+            {
+                iter = ellipsoids.emplace(def, ProjRegistry::get().get_ellipsoid(def)).first;
+            }
+            return iter->second;
+        }
+    };
+
+    thread_local ThreadOperations g_thread_operations;
 #endif // VSGCS_USE_PROJ
 
+    void prewarmCRS(const std::vector<std::string>& names)
+    {
+#ifdef VSGCS_USE_PROJ
+        auto& registry = ProjRegistry::get();
+        for (const auto& name : names)
+        {
+            if (name == "epsg:4978" || name == "epsg:4979" || name == "wgs84" || name == "null")
+            {
+                continue;
+            }
+            const auto startTime = std::chrono::steady_clock::now();
+            std::lock_guard lock(registry.mutex);
+            if (!registry.get_operation_locked(name))
+            {
+                vsg::warn("can't create conversion from ", name, " to ECEF.");
+            }
+            vsg::debug("PROJ operation ", name, " -> ECEF created in ",
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count(),
+                       " ms");
+        }
+#else
+        (void)names;
+#endif
+    }
+
     class CRS::ConversionOperation
     {
     public:
@@ -478,6 +598,16 @@ namespace vsgCs
         virtual vsg::dmat4 getENU(const vsg::dvec3& coord) = 0;
         // The inverse operation
         virtual vsg::dvec3 getCRSCoord(const vsg::dvec3& ecef) = 0;
+        virtual void getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef)
+        {
+            std::transform(coords.begin(), coords.end(), ecef.begin(),
+                           [this](const vsg::dvec3& coord) { return getECEF(coord); });
+        }
+        virtual void getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords)
+        {
+            std::transform(ecef.begin(), ecef.end(), coords.begin(),
+                           [this](const vsg::dvec3& coord) { return getCRSCoord(coord); });
+        }
     };
 
     // A no-op CRS. Either the coordinates are ECEF (x, y, z), or there isn't actually a globe.
@@ -498,6 +628,19 @@ namespace vsgCs
         {
             return ecef;
         }
+
+        void getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef) override
+        {
+            if (coords.data() != ecef.data())
+            {
+                std::copy(coords.begin(), coords.end(), ecef.begin());
+            }
+        }
+
+        void getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords) override
+        {
+            getECEF(ecef, coords);
+        }
     };
     
     // Bog-standard WGS84 longitude, latitude, height to ECEF
@@ -507,14 +650,14 @@ namespace vsgCs
         vsg::dvec3 getECEF(const vsg::dvec3& coord) override;
         vsg::dmat4 getENU(const vsg::dvec3& coord) override;
         vsg::dvec3 getCRSCoord(const vsg::dvec3& ecef) override;
+        void getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef) override;
+        void getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords) override;
     };
 
 
     vsg::dvec3 EPSG4979::getECEF(const vsg::dvec3& coord)
     {
-        using namespace CesiumGeospatial;
-        auto glmvec = Ellipsoid::WGS84.cartographicToCartesian(Cartographic(vsg::radians(coord.x), vsg::radians(coord.y), coord.z));
-        return glm2vsg(glmvec);
+        return geodeticToECEF(coord, AngleUnit::DEGREES);
     }
 
     vsg::dmat4 EPSG4979::getENU(const vsg::dvec3& coord)
@@ -527,13 +670,17 @@ namespace vsgCs
 
     vsg::dvec3 EPSG4979::getCRSCoord(const vsg::dvec3& ecef)
     {
-        using namespace CesiumGeospatial;
-        auto result = Ellipsoid::WGS84.cartesianToCartographic(vsg2glm(ecef));
-        if (!result)
-        {
-            return {0.0, 0.0, 0.0};
-        }
-        return {result->longitude, result->latitude, result->height};
+        return ecefToGeodetic(ecef, AngleUnit::DEGREES);
+    }
+
+    void EPSG4979::getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef)
+    {
+        geodeticToECEF(coords, ecef, AngleUnit::DEGREES);
+    }
+
+    void EPSG4979::getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords)
+    {
+        ecefToGeodetic(ecef, coords, AngleUnit::DEGREES);
     }
     
     // The meat of vsgCs::CRS: conversion operations implemented by PROJ. The actual PROJ operation
@@ -569,7 +716,7 @@ namespace vsgCs
         {
             using namespace CesiumGeospatial;
             vsg::dvec3 origin = getECEF(coord);
-            const auto& ellipsoid = g_srs_factory.get_ellipsoid(sourceCRS);
+            const auto& ellipsoid = g_thread_operations.get_ellipsoid(sourceCRS);
             LocalHorizontalCoordinateSystem lhcs(vsg2glm(origin),
                                                  LocalDirection::East, LocalDirection::North,
                                                  LocalDirection::Up,
@@ -593,10 +740,62 @@ namespace vsgCs
             return result;
         }
 
+        void getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef) override
+        {
+            transform(PJ_FWD, coords, ecef);
+        }
+
+        void getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords) override
+        {
+            transform(PJ_INV, ecef, coords);
+        }
+
     protected:
+        // Transform all the coordinates, in place in the output, with one PROJ call.
+        void transform(PJ_DIRECTION direction, std::span<const vsg::dvec3> in, std::span<vsg::dvec3> out) const
+        {
+            if (in.empty())
+            {
+                return;
+            }
+            if (in.data() != out.data())
+            {
+                std::copy(in.begin(), in.end(), out.begin());
+            }
+            auto* handle = getHandle();
+            const size_t stride = sizeof(vsg::dvec3);
+            const size_t count = out.size();
+            proj_trans_generic(handle, direction,
+                               &out[0].x, stride, count,
+                               &out[0].y, stride, count,
+                               &out[0].z, stride, count,
+                               nullptr, 0, 0);
+            int err = proj_errno(handle);
+            // PROJ sets the coordinates of each point that it couldn't convert to HUGE_VAL and
+            // carries on with the rest.
+            size_t numFailed = 0;
+            for (auto& coord : out)
+            {
+                if (coord.x == HUGE_VAL || coord.y == HUGE_VAL || coord.z == HUGE_VAL)
+                {
+                    coord = vsg::dvec3(std::numeric_limits<double>::quiet_NaN());
+                    ++numFailed;
+                }
+            }
+            if (err != 0 && numFailed == count)
+            {
+                throw std::runtime_error(std::string("PROJ error: ") + proj_errno_string(err));
+            }
+            if (numFailed > 0)
+            {
+                vsg::warn("PROJ couldn't convert ", numFailed, " of ", count, " coordinates from ", sourceCRS,
+                          err != 0 ? std::string(": ") + proj_errno_string(err) : std::string());
+            }
+        }
+
         PJ* getHandle() const
         {
-            auto* handle = g_srs_factory.get_or_create_operation(sourceCRS, "ecef");
+            auto* handle = g_thread_operations.get_operation(sourceCRS);
             if (!handle)
             {
                 throw std::runtime_error("can't create conversion from " + sourceCRS + " to ECEF.");
@@ -639,6 +838,47 @@ namespace vsgCs
         return {0.0, 0.0, 0.0};
     }
 
+    vsg::dvec3 CRS::getCRSCoord(const vsg::dvec3& ecef)
+    {
+        if (_converter)
+        {
+            return _converter->getCRSCoord(ecef);
+        }
+        return {0.0, 0.0, 0.0};
+    }
+
+    void CRS::getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef)
+    {
+        if (coords.size() != ecef.size())
+        {
+            throw std::invalid_argument("CRS::getECEF: spans have different sizes");
+        }
+        if (_converter)
+        {
+            _converter->getECEF(coords, ecef);
+        }
+        else
+        {
+            std::fill(ecef.begin(), ecef.end(), vsg::dvec3(0.0, 0.0, 0.0));
+        }
+    }
+
+    void CRS::getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords)
+    {
+        if (coords.size() != ecef.size())
+        {
+            throw std::invalid_argument("CRS::getCRSCoord: spans have different sizes");
+        }
+        if (_converter)
+        {
+            _converter->getCRSCoord(ecef, coords);
+        }
+        else
+        {
+            std::fill(coords.begin(), coords.end(), vsg::dvec3(0.0, 0.0, 0.0));
+        }
+    }
+
     vsg::dmat4 CRS::getENU(const vsg::dvec3& coord)
     {
         if (_converter)
@@ -648,4 +888,3 @@ namespace vsgCs
         return vsg::dmat4(1.0);
     }
 }
-
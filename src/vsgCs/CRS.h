@@ -43,7 +43,9 @@ SOFTWARE.
 #include <vsg/maths/mat4.h>
 
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace vsgCs
 {
@@ -55,13 +57,29 @@ namespace vsgCs
     // Also known as "localToWorld"; is that a better name for any reason?
     vsg::dmat4 getENU(const vsg::dvec3& coord);
     vsg::dvec3 getCRSCoord(const vsg::dvec3& ecef);
+    // Batch conversions, much faster than converting one coordinate at a time. The input and
+    // output spans must have the same size, and may be the same span. Coordinates that can't be
+    // converted are set to NaN and the rest are still converted.
+    void getECEF(std::span<const vsg::dvec3> coords, std::span<vsg::dvec3> ecef);
+    void getCRSCoord(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> coords);
     const std::string& getName() const
     {
         return _name;
     }
+    // False for the "null" CRS, whose coordinates aren't on a globe, and for unknown CRSs
+    bool hasGlobe() const
+    {
+        return _converter && _name != "null";
+    }
     class ConversionOperation;
     protected:
     std::shared_ptr<ConversionOperation> _converter;
     std::string _name;
     };
+
+    /**
+     * @brief Create the PROJ operations for CRSs ahead of their first use. Operations are created
+     * once per process and cloned cheaply for each thread that uses them.
+     */
+    VSGCS_EXPORT void prewarmCRS(const std::vector<std::string>& names);
 }
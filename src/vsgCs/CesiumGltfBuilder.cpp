@@ -24,10 +24,13 @@ SOFTWARE.
 
 #include "accessor_traits.h"
 #include "CesiumGltfBuilder.h"
+#include "GraphOptimizer.h"
 #include "pbr.h"
 
 #include "LoadGltfResult.h"
 #include "runtimeSupport.h"
+#include "Styling.h"
+#include "TileGeometry.h"
 #include "Tracing.h"
 
 #include <CesiumGltf/AccessorView.h>
@@ -137,8 +140,21 @@ namespace
     }
 }
 
+// The feature palette made by the tile's Stylist, if any, belongs to the feature table stored on
+// the model node.
+vsg::ref_ptr<vsg::Data> getFeaturePalette(const vsg::ref_ptr<vsg::StateGroup>& tileStateGroup)
+{
+    if (!tileStateGroup || tileStateGroup->children.empty())
+    {
+        return {};
+    }
+    const auto* featureTable = tileStateGroup->children[0]->getObject<FeatureTable>("vsgCs_featureTable");
+    return featureTable ? vsg::ref_ptr<vsg::Data>(featureTable->palette) : vsg::ref_ptr<vsg::Data>();
+}
+
 vsg::ref_ptr<vsg::StateCommand> makeTileStateCommand(const vsg::ref_ptr<GraphicsEnvironment>& genv,
                                                      const Rasters& rasters,
+                                                     vsg::ref_ptr<vsg::Data> featurePalette,
                                                      const Cesium3DTilesSelection::Tile& tile)
 {
     vsg::ImageInfoList rasterImages(rasters.overlayRasters.size());
@@ -159,6 +175,14 @@ vsg::ref_ptr<vsg::StateCommand> makeTileStateCommand(const vsg::ref_ptr<Graphics
                                  overlayParams);
     ubo->properties.dataVariance = vsg::DYNAMIC_DATA;
     descriptorBuilder->assignDescriptor("tileParams", ubo);
+    if (!featurePalette)
+    {
+        // Unstyled tiles don't use the palette, but the descriptor must be bound.
+        auto defaultPalette = vsg::vec4Array::create(1);
+        (*defaultPalette)[0] = colorWhite;
+        featurePalette = defaultPalette;
+    }
+    descriptorBuilder->assignDescriptor("featurePalette", featurePalette);
     if (descriptorBuilder->descriptorSets.size() < pbr::TILE_DESCRIPTOR_SET + 1
         || !descriptorBuilder->descriptorSets[pbr::TILE_DESCRIPTOR_SET])
     {
@@ -214,6 +238,27 @@ vsg::ref_ptr<vsg::StateGroup> CesiumGltfBuilder::getTileStateGroup(const vsg::re
     return ref_ptr_cast<vsg::StateGroup>(transformNode->children[0]);
 }
 
+vsg::ref_ptr<FeatureTable> CesiumGltfBuilder::getFeatureTable(const vsg::ref_ptr<vsg::Node>& node)
+{
+    auto tileSG = CesiumGltfBuilder::getTileStateGroup(node);
+    if (!tileSG || tileSG->children.empty())
+    {
+        return {};
+    }
+    return vsg::ref_ptr<FeatureTable>(tileSG->children[0]->getObject<FeatureTable>("vsgCs_featureTable"));
+}
+
+vsg::ref_ptr<TileGeometry> CesiumGltfBuilder::getTileGeometry(const vsg::ref_ptr<vsg::Node>& node)
+{
+    auto cullNode = ref_ptr_cast<vsg::CullNode>(node);
+    vsg::ref_ptr<vsg::Node> transformNode = cullNode.valid() ? cullNode->child : node;
+    if (!transformNode)
+    {
+        return {};
+    }
+    return vsg::ref_ptr<TileGeometry>(transformNode->getObject<TileGeometry>("vsgCs_tileGeometry"));
+}
+
 vsg::ref_ptr<vsg::Data> CesiumGltfBuilder::getTileData(const vsg::ref_ptr<vsg::Node>& node)
 {
     auto tileSG = CesiumGltfBuilder::getTileStateGroup(node);
@@ -226,7 +271,10 @@ vsg::ref_ptr<vsg::Data> CesiumGltfBuilder::getTileData(const vsg::ref_ptr<vsg::N
         auto ds = bindDesc->descriptorSet;
         auto descBuffItr = std::find_if(ds->descriptors.begin(), ds->descriptors.end(),
                                         [](auto && descriptor)
-                                        { return !!ref_ptr_cast<vsg::DescriptorBuffer>(descriptor); });
+                                        {
+                                            return descriptor->dstBinding == 0
+                                                && !!ref_ptr_cast<vsg::DescriptorBuffer>(descriptor);
+                                        });
         if (descBuffItr == ds->descriptors.end())
         {
             vsg::warn("could not find tile DescriptorBuffer");
@@ -267,6 +315,26 @@ vsg::ref_ptr<vsg::Node> CesiumGltfBuilder::loadTile(Cesium3DTilesSelection::Tile
         ? it->second.getStringOrDefault("Unknown Tile URL")
         : "Unknown Tile URL";
     transformNode->setValue("tileUrl", url);
+    if (modelOptions.keepGeometry)
+    {
+        if (auto tileGeometry = createTileGeometry(model, rootTransform))
+        {
+            if (modelOptions.buildBVH)
+            {
+                tileGeometry->buildBVH();
+            }
+            transformNode->setObject("vsgCs_tileGeometry", tileGeometry);
+        }
+    }
+    if (modelOptions.optimizeGraph)
+    {
+        GraphOptimizer optimizer;
+        auto stats = optimizer.optimize(modelNode);
+        vsg::debug(url, ": nodes ", stats.nodesBefore, " -> ", stats.nodesAfter,
+                   ", transforms baked ", stats.transformsBaked,
+                   ", traversal ", stats.traversalBefore, "us -> ", stats.traversalAfter,
+                   "us, optimize ", stats.optimizeTime, "us");
+    }
     tileStateGroup->addChild(modelNode);
     transformNode->addChild(tileStateGroup);
     if (tileLoadResult.updatedBoundingVolume)
@@ -292,7 +360,7 @@ CesiumGltfBuilder::attachTileData(Cesium3DTilesSelection::Tile& tile,
 {
     auto rasters = getOrCreateRasters(node);
     auto tileStateGroup = getTileStateGroup(node);
-    auto tileStateCommand = makeTileStateCommand(_genv, *rasters, tile);
+    auto tileStateCommand = makeTileStateCommand(_genv, *rasters, getFeaturePalette(tileStateGroup), tile);
     if (!tileStateGroup->stateCommands.empty())
     {
         vsg::warn("tile state group already has command.");
@@ -362,7 +430,7 @@ ModifyRastersResult CesiumGltfBuilder::attachRaster(const Cesium3DTilesSelection
     rasterData.overlayParams.coordIndex = overlayTextureCoordinateID;
     rasterData.overlayParams.enabled = 1;
     rasterData.overlayParams.alpha = resource->overlayOptions.alpha;
-    auto command = makeTileStateCommand(_genv, *rasters, tile);
+    auto command = makeTileStateCommand(_genv, *rasters, getFeaturePalette(stateGroup), tile);
     // XXX Should check data or something in the state command instead of relying on the number of
     // commands in the group.
     auto& stateCommands = stateGroup->stateCommands;
@@ -395,7 +463,7 @@ CesiumGltfBuilder::detachRaster(const Cesium3DTilesSelection::Tile& tile,
     {
         rasterData.rasterImage = {}; // ref to rasterImage is still held by the old StateCommand
         rasterData.overlayParams.enabled = 0;
-        auto newCommand = makeTileStateCommand(_genv, *rasters, tile);
+        auto newCommand = makeTileStateCommand(_genv, *rasters, getFeaturePalette(stateGroup), tile);
         // XXX Should check data or something in the state command instead of relying on the number of
         // commands in the group.
         auto& stateCommands = stateGroup->stateCommands;
@@ -46,6 +46,9 @@ SOFTWARE.
 
 namespace vsgCs
 {
+    class FeatureTable;
+    class TileGeometry;
+
     // The functions for attaching and detaching rasters return objects that need to be compiled and
     // may replace objects that should then eventually be freed. I don't think the tile-building
     // commands need this generality.
@@ -98,6 +101,9 @@ namespace vsgCs
                                          const CesiumRasterOverlays::RasterOverlayTile& rasterTile);
         static vsg::ref_ptr<vsg::StateGroup> getTileStateGroup(const vsg::ref_ptr<vsg::Node>& node);
         static vsg::ref_ptr<vsg::Data> getTileData(const vsg::ref_ptr<vsg::Node>& node);
+        /// The feature table of a tile whose features can be restyled, if any.
+        static vsg::ref_ptr<FeatureTable> getFeatureTable(const vsg::ref_ptr<vsg::Node>& node);
+        static vsg::ref_ptr<TileGeometry> getTileGeometry(const vsg::ref_ptr<vsg::Node>& node);
     protected:
         vsg::ref_ptr<GraphicsEnvironment> _genv;
     };
@@ -62,6 +62,11 @@ namespace vsgCs
         {
             return _rasterOverlay;
         }
+        // True while cesium-native is still destroying an overlay removed from a tileset
+        bool isBeingDestroyed() const
+        {
+            return _overlaysBeingDestroyed > 0;
+        }
     protected:
         CesiumRasterOverlays::RasterOverlay* _rasterOverlay;
         int32_t _overlaysBeingDestroyed = 0;
@@ -0,0 +1,242 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "FeatureIndex.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+using namespace vsgCs;
+
+namespace
+{
+    bool compareValues(double a, FeatureCompare compare, double b)
+    {
+        switch (compare)
+        {
+        case FeatureCompare::LESS:
+            return a < b;
+        case FeatureCompare::LESS_EQUAL:
+            return a <= b;
+        case FeatureCompare::EQUAL:
+            return a == b;
+        case FeatureCompare::NOT_EQUAL:
+            return a != b;
+        case FeatureCompare::GREATER_EQUAL:
+            return a >= b;
+        case FeatureCompare::GREATER:
+            return a > b;
+        }
+        return false;
+    }
+
+    size_t numWords(size_t size)
+    {
+        return (size + 63) / 64;
+    }
+
+    void setBit(std::vector<uint64_t>& bitmap, size_t row)
+    {
+        bitmap[row / 64] |= uint64_t(1) << (row % 64);
+    }
+
+    void appendRows(const std::vector<uint64_t>& bitmap, std::vector<uint32_t>& rows)
+    {
+        for (size_t word = 0; word < bitmap.size(); ++word)
+        {
+            for (uint64_t w = bitmap[word]; w != 0; w &= w - 1)
+            {
+                rows.push_back(static_cast<uint32_t>(word * 64 + std::countr_zero(w)));
+            }
+        }
+    }
+}
+
+FeatureIndex::FeatureIndex(const StyleColumn& column, size_t size)
+    : _type(column.type), _size(size)
+{
+    if (_type == StyleColumn::NUMBER)
+    {
+        const size_t numRows = std::min(size, column.numbers.size());
+        _sortedRows.reserve(numRows);
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (!std::isnan(column.numbers[i]))
+            {
+                _sortedRows.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        std::stable_sort(_sortedRows.begin(), _sortedRows.end(),
+                         [&column](uint32_t lhs, uint32_t rhs)
+                         {
+                             return column.numbers[lhs] < column.numbers[rhs];
+                         });
+        _sortedValues.reserve(_sortedRows.size());
+        for (auto row : _sortedRows)
+        {
+            _sortedValues.push_back(column.numbers[row]);
+        }
+        return;
+    }
+    // The last bitmap holds all the rows that have a value.
+    if (_type == StyleColumn::BOOLEAN)
+    {
+        _bitmaps.assign(3, std::vector<uint64_t>(numWords(size)));
+        const size_t numRows = std::min(size, column.booleans.size());
+        const bool allPresent = column.booleanPresent.empty();
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (!allPresent && (i >= column.booleanPresent.size() || !column.booleanPresent[i]))
+            {
+                continue;
+            }
+            setBit(_bitmaps[column.booleans[i] ? 1 : 0], i);
+            setBit(_bitmaps[2], i);
+        }
+    }
+    else
+    {
+        _bitmaps.assign(column.dictionary.size() + 1, std::vector<uint64_t>(numWords(size)));
+        for (size_t i = 0; i < column.dictionary.size(); ++i)
+        {
+            _dictionary.emplace(column.dictionary[i], i);
+        }
+        const size_t numRows = std::min(size, column.stringIDs.size());
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (column.stringIDs[i] >= 0)
+            {
+                setBit(_bitmaps[column.stringIDs[i]], i);
+                setBit(_bitmaps.back(), i);
+            }
+        }
+    }
+}
+
+void FeatureIndex::select(FeatureCompare compare, double value, std::vector<uint32_t>& rows) const
+{
+    rows.clear();
+    if (_type == StyleColumn::STRING)
+    {
+        return;
+    }
+    if (_type == StyleColumn::BOOLEAN)
+    {
+        const bool matchFalse = compareValues(0.0, compare, value);
+        const bool matchTrue = compareValues(1.0, compare, value);
+        if (matchFalse && matchTrue)
+        {
+            selectBitmap(2, true, rows);
+        }
+        else if (matchFalse || matchTrue)
+        {
+            selectBitmap(matchTrue ? 1 : 0, true, rows);
+        }
+        return;
+    }
+    if (std::isnan(value))
+    {
+        if (compare == FeatureCompare::NOT_EQUAL)
+        {
+            rows = _sortedRows;
+            std::sort(rows.begin(), rows.end());
+        }
+        return;
+    }
+    const auto lower = std::lower_bound(_sortedValues.begin(), _sortedValues.end(), value)
+        - _sortedValues.begin();
+    const auto upper = std::upper_bound(_sortedValues.begin() + lower, _sortedValues.end(), value)
+        - _sortedValues.begin();
+    // Put the rows back in ascending order through a bitmap, which is cheaper than sorting.
+    std::vector<uint64_t> bits(numWords(_size));
+    auto append = [this, &bits](ptrdiff_t begin, ptrdiff_t end)
+    {
+        std::for_each(_sortedRows.begin() + begin, _sortedRows.begin() + end,
+                      [&bits](uint32_t row)
+                      {
+                          setBit(bits, row);
+                      });
+    };
+    const auto end = static_cast<ptrdiff_t>(_sortedRows.size());
+    switch (compare)
+    {
+    case FeatureCompare::LESS:
+        append(0, lower);
+        break;
+    case FeatureCompare::LESS_EQUAL:
+        append(0, upper);
+        break;
+    case FeatureCompare::EQUAL:
+        append(lower, upper);
+        break;
+    case FeatureCompare::NOT_EQUAL:
+        append(0, lower);
+        append(upper, end);
+        break;
+    case FeatureCompare::GREATER_EQUAL:
+        append(lower, end);
+        break;
+    case FeatureCompare::GREATER:
+        append(upper, end);
+        break;
+    }
+    appendRows(bits, rows);
+}
+
+void FeatureIndex::select(const std::string_view& value, bool equal, std::vector<uint32_t>& rows) const
+{
+    rows.clear();
+    if (_type != StyleColumn::STRING)
+    {
+        return;
+    }
+    auto itr = _dictionary.find(value);
+    if (itr != _dictionary.end())
+    {
+        selectBitmap(itr->second, equal, rows);
+    }
+    else if (!equal)
+    {
+        selectBitmap(_bitmaps.size() - 1, true, rows);
+    }
+}
+
+void FeatureIndex::selectBitmap(size_t bitmap, bool equal, std::vector<uint32_t>& rows) const
+{
+    if (equal)
+    {
+        appendRows(_bitmaps[bitmap], rows);
+        return;
+    }
+    const auto& bits = _bitmaps[bitmap];
+    const auto& present = _bitmaps.back();
+    std::vector<uint64_t> notEqual(bits.size());
+    for (size_t word = 0; word < bits.size(); ++word)
+    {
+        notEqual[word] = present[word] & ~bits[word];
+    }
+    appendRows(notEqual, rows);
+}
@@ -0,0 +1,77 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+#include "StyleExpression.h"
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vsgCs
+{
+    enum class FeatureCompare
+    {
+        LESS,
+        LESS_EQUAL,
+        EQUAL,
+        NOT_EQUAL,
+        GREATER_EQUAL,
+        GREATER
+    };
+
+    /**
+     * @brief An index over a feature property column for selecting features without scanning the
+     * column.
+     *
+     * Number columns are indexed by the rows sorted by value, so a comparison is a binary search
+     * and a copy of the matching range. String and boolean columns get a bitmap of rows for each
+     * distinct value. Missing values never match. Selected rows, which are feature IDs, are
+     * returned in ascending order.
+     */
+    class VSGCS_EXPORT FeatureIndex : public vsg::Inherit<vsg::Object, FeatureIndex>
+    {
+    public:
+        explicit FeatureIndex(const StyleColumn& column, size_t size);
+        /// @brief Select rows of a number or boolean (0 or 1) column.
+        void select(FeatureCompare compare, double value, std::vector<uint32_t>& rows) const;
+        /// @brief Select rows of a string column that are equal, or not equal, to value.
+        void select(const std::string_view& value, bool equal, std::vector<uint32_t>& rows) const;
+    protected:
+        void selectBitmap(size_t bitmap, bool equal, std::vector<uint32_t>& rows) const;
+        StyleColumn::Type _type;
+        size_t _size;
+        std::vector<double> _sortedValues;
+        std::vector<uint32_t> _sortedRows;
+        std::vector<std::vector<uint64_t>> _bitmaps;
+        std::map<std::string, size_t, std::less<>> _dictionary;
+    };
+}
@@ -24,7 +24,12 @@ SOFTWARE.
 
 #include "GeoNode.h"
 
+#include "GltfLoader.h"
+#include "InstancedModel.h"
+#include "InstanceFile.h"
 #include "jsonUtils.h"
+#include "MeshSimplifier.h"
+#include "OpThreadTaskProcessor.h"
 #include "runtimeSupport.h"
 #include "RuntimeEnvironment.h"
 #include "pbr.h"
@@ -32,10 +37,15 @@ SOFTWARE.
 #include <CesiumUtility/JsonHelpers.h>
 #include <CesiumGeospatial/LocalHorizontalCoordinateSystem.h>
 
+#include <vsg/io/FileSystem.h>
 #include <vsg/maths/transform.h>
+#include <vsg/nodes/CullNode.h>
 #include <vsg/state/ViewDependentState.h>
+#include <vsg/utils/ComputeBounds.h>
 
 #include <map>
+#include <stdexcept>
+#include <vector>
 
 using namespace vsgCs;
 
@@ -99,11 +109,148 @@ void GeoNode::setCRS(const std::string& crs)
 
 namespace
 {
+    // Models with fewer instances aren't worth sorting into a grid.
+    constexpr size_t minGridInstances = 256;
+
+    // Levels of detail of a model definition, e.g.
+    // "lods": [{"triangleRatio": 1.0, "screenHeightRatio": 0.1}, {"triangleRatio": 0.25, "screenHeightRatio": 0.02}]
+    vsg::ref_ptr<LodSettings> readLods(const rapidjson::Value& modelDef)
+    {
+        auto lodsItr = modelDef.FindMember("lods");
+        if (lodsItr == modelDef.MemberEnd() || !lodsItr->value.IsArray())
+        {
+            return {};
+        }
+        auto result = LodSettings::create();
+        for (const auto& lod : lodsItr->value.GetArray())
+        {
+            if (!lod.IsObject())
+            {
+                continue;
+            }
+            LodLevel level;
+            level.triangleRatio = CesiumUtility::JsonHelpers::getDoubleOrDefault(lod, "triangleRatio", 1.0);
+            level.minimumScreenHeightRatio
+                = CesiumUtility::JsonHelpers::getDoubleOrDefault(lod, "screenHeightRatio", 0.0);
+            result->levels.push_back(level);
+        }
+        if (result->levels.size() < 2)
+        {
+            return {};
+        }
+        return result;
+    }
+
+    void reportLods(const std::string& name, const vsg::ref_ptr<vsg::Node>& modelNode)
+    {
+        const auto* statistics = modelNode->getObject<LodStatistics>("vsgCs_lodStatistics");
+        if (!statistics)
+        {
+            return;
+        }
+        std::string counts;
+        for (auto triangles : statistics->triangles)
+        {
+            counts += (counts.empty() ? "" : ", ") + std::to_string(triangles);
+        }
+        vsg::info("Model ", name, " triangles per level of detail: ", counts);
+    }
+
+    // glTF models are read by GltfLoader without blocking; other models are read in a worker
+    // thread.
+    // A model that fails to load is a null node, so that the other models are still placed.
+    CesiumAsync::Future<vsg::ref_ptr<vsg::Node>> readModelAsync(const std::string& path,
+                                                                const vsg::ref_ptr<const vsg::Options>& options)
+    {
+        auto catchError = [path](std::exception&& e)
+        {
+            vsg::warn("Couldn't read ", path, ": ", e.what());
+            return vsg::ref_ptr<vsg::Node>();
+        };
+        const std::string extension = vsg::lowerCaseFileExtension(path).string();
+        if (extension == ".gltf" || extension == ".glb")
+        {
+            for (const auto& readerWriter : options->readerWriters)
+            {
+                if (auto gltfLoader = readerWriter.cast<GltfLoader>())
+                {
+                    return gltfLoader->readAsync(path, options).catchImmediately(catchError);
+                }
+            }
+        }
+        return getAsyncSystem()
+            .runInWorkerThread([path, options]()
+            {
+                return vsg::read_cast<vsg::Node>(path, options);
+            })
+            .catchImmediately(catchError);
+    }
+
+    struct ModelPlacement
+    {
+        std::string name;
+        std::string path;
+        std::vector<vsg::dmat4>* matrices;
+        std::vector<InstanceCell> cells;
+        vsg::ref_ptr<const vsg::Options> options;
+        // Set if the model is read for GPU instancing
+        vsg::ref_ptr<vsg::dmat4Array> instances;
+    };
+
+    // Place a model with a transform per instance, grouping the transforms by grid cell under
+    // CullNodes.
+    void addTransformedInstances(const vsg::ref_ptr<vsg::Group>& parent, const vsg::ref_ptr<vsg::Node>& modelNode,
+                                 const std::vector<vsg::dmat4>& matrices, const std::vector<InstanceCell>& cells)
+    {
+        if (cells.empty())
+        {
+            for (const auto& matrix : matrices)
+            {
+                auto modelTransform = vsg::MatrixTransform::create(matrix);
+                modelTransform->addChild(modelNode);
+                parent->addChild(modelTransform);
+            }
+            return;
+        }
+        auto computeBounds = vsg::ComputeBounds::create();
+        modelNode->accept(*computeBounds);
+        for (const auto& cell : cells)
+        {
+            auto cellGroup = vsg::Group::create();
+            vsg::dbox cellBox;
+            for (uint32_t i = cell.first; i < cell.first + cell.count; ++i)
+            {
+                auto modelTransform = vsg::MatrixTransform::create(matrices[i]);
+                modelTransform->addChild(modelNode);
+                cellGroup->addChild(modelTransform);
+                if (computeBounds->bounds.valid())
+                {
+                    for (int corner = 0; corner < 8; ++corner)
+                    {
+                        const vsg::dbox& box = computeBounds->bounds;
+                        const vsg::dvec3 point((corner & 1) ? box.max.x : box.min.x,
+                                               (corner & 2) ? box.max.y : box.min.y,
+                                               (corner & 4) ? box.max.z : box.min.z);
+                        cellBox.add(matrices[i] * point);
+                    }
+                }
+            }
+            if (cellBox.valid())
+            {
+                vsg::dsphere bound((cellBox.min + cellBox.max) * 0.5, vsg::length(cellBox.max - cellBox.min) * 0.5);
+                parent->addChild(vsg::CullNode::create(bound, cellGroup));
+            }
+            else
+            {
+                parent->addChild(cellGroup);
+            }
+        }
+    }
+
     vsg::ref_ptr<vsg::Object> buildGeoNode(const rapidjson::Value& json,
                                            JSONObjectFactory*,
                                            const vsg::ref_ptr<vsg::Object>&)
     {
-        std::map<std::string, vsg::ref_ptr<vsg::Node>> models;
         using namespace CesiumGeospatial;
         std::string crs = CesiumUtility::JsonHelpers::getStringOrDefault(json, "crs", "wgs84");
         // Geographic coordinates are in degrees. If they are supplied, then we should probably
@@ -131,35 +278,9 @@ namespace
         node->matrix =  vsg::rotate(vsg::radians(-heading), 0.0, 0.0, 1.0);
         geoNode->addChild(node);
 
-        auto modelDefsItr = json.FindMember("modelDefinitions");
-        if (modelDefsItr != json.MemberEnd())
-        {
-            const auto& modelDefs = modelDefsItr->value;
-            if (modelDefs.IsArray())
-            {
-                for (rapidjson::SizeType i = 0; i < modelDefs.Size(); ++i)
-                {
-                    const rapidjson::Value& modelDef = modelDefs[i].GetObject();
-                    auto name = getStringOrError(modelDef, "name", "Missing name in model definition");
-                    // An empty path isn't an error; the user might not want a model for some reason.
-                    auto path = CesiumUtility::JsonHelpers::getStringOrDefault(modelDef, "path", "");
-                    // options is initialized for using the basic vsgCs shader with vsgXchange
-                    // models, including the option to treat textures as sRGB.
-                    if (!path.empty())
-                    {
-                        auto modelNode = vsg::read_cast<vsg::Node>(path, RuntimeEnvironment::get()->options);
-                        if (! modelNode)
-                        {
-                            vsg::error("Couldn't read ", path);
-                        }
-                        else
-                        {
-                            models[name] = modelNode;
-                        }
-                    }
-                }
-            }
-        }
+        // Read the instances first, so that models with several instances can be built for GPU
+        // instancing.
+        std::map<std::string, std::vector<vsg::dmat4>> modelInstances;
         auto instancesItr = json.FindMember("instances");
         if (instancesItr != json.MemberEnd())
         {
@@ -181,15 +302,131 @@ namespace
                     {
                         modelMat = vsg::translate((*coords)[0], (*coords)[1], (*coords)[2]) * modelMat;
                     }
-                    auto modelTransform = vsg::MatrixTransform::create(modelMat);
                     if (!modelName.empty())
                     {
-                        if (auto defItr = models.find(modelName); defItr != models.end())
+                        modelInstances[modelName].push_back(modelMat);
+                    }
+                }
+            }
+        }
+        // Large placements come from instance files, whose coordinates are in the GeoNode's CRS.
+        std::vector<std::string> instanceFiles;
+        if (auto filesItr = json.FindMember("instanceFiles"); filesItr != json.MemberEnd())
+        {
+            if (filesItr->value.IsString())
+            {
+                instanceFiles.emplace_back(filesItr->value.GetString());
+            }
+            else
+            {
+                instanceFiles = CesiumUtility::JsonHelpers::getStrings(json, "instanceFiles");
+            }
+        }
+        if (!instanceFiles.empty())
+        {
+            const vsg::dmat4 worldToLocal = vsg::inverse(geoNode->getCRS()->getENU(crsCoords) * node->matrix);
+            for (const auto& file : instanceFiles)
+            {
+                auto filePath = vsg::findFile(file, RuntimeEnvironment::get()->options);
+                if (filePath.empty())
+                {
+                    vsg::error("Couldn't find instance file ", file);
+                    continue;
+                }
+                readInstanceFile(filePath, geoNode->getCRS(), worldToLocal, modelInstances);
+            }
+        }
+        const auto& env = RuntimeEnvironment::get();
+        const bool gpuInstancing = CesiumUtility::JsonHelpers::getBoolOrDefault(json, "gpuInstancing",
+                                                                               env->gpuInstancing);
+        const double cellSize = CesiumUtility::JsonHelpers::getDoubleOrDefault(json, "cellSize", 500.0);
+        const double thinningDistance = CesiumUtility::JsonHelpers::getDoubleOrDefault(json, "thinningDistance",
+                                                                                       0.0);
+        auto modelDefsItr = json.FindMember("modelDefinitions");
+        if (modelDefsItr != json.MemberEnd())
+        {
+            const auto& modelDefs = modelDefsItr->value;
+            if (modelDefs.IsArray())
+            {
+                // The models are read concurrently, then placed.
+                std::vector<ModelPlacement> placements;
+                std::vector<CesiumAsync::Future<vsg::ref_ptr<vsg::Node>>> modelFutures;
+                for (rapidjson::SizeType i = 0; i < modelDefs.Size(); ++i)
+                {
+                    const rapidjson::Value& modelDef = modelDefs[i].GetObject();
+                    auto name = getStringOrError(modelDef, "name", "Missing name in model definition");
+                    // An empty path isn't an error; the user might not want a model for some reason.
+                    auto path = CesiumUtility::JsonHelpers::getStringOrDefault(modelDef, "path", "");
+                    auto instancesItr = modelInstances.find(name);
+                    if (path.empty() || instancesItr == modelInstances.end())
+                    {
+                        continue;
+                    }
+                    ModelPlacement placement{name, path, &instancesItr->second};
+                    std::vector<vsg::dmat4>& matrices = *placement.matrices;
+                    if (matrices.size() >= minGridInstances && cellSize > 0.0)
+                    {
+                        placement.cells = sortInstancesIntoGrid(matrices, cellSize);
+                    }
+                    // options is initialized for using the basic vsgCs shader with vsgXchange
+                    // models, including the option to treat textures as sRGB. GltfLoader builds
+                    // simplified levels of detail; other readers ignore them.
+                    placement.options = env->options;
+                    if (auto lods = readLods(modelDef))
+                    {
+                        auto lodOptions = vsg::Options::create(*env->options);
+                        lodOptions->setObject("vsgCs_lods", lods);
+                        placement.options = lodOptions;
+                    }
+                    if (gpuInstancing && matrices.size() > 1)
+                    {
+                        // GltfLoader builds the model with instanced draws; other readers ignore
+                        // the instances.
+                        placement.instances = vsg::dmat4Array::create(matrices.size());
+                        std::copy(matrices.begin(), matrices.end(), placement.instances->begin());
+                        auto options = vsg::Options::create(*placement.options);
+                        options->setObject("vsgCs_instances", placement.instances);
+                        modelFutures.push_back(readModelAsync(path, options));
+                    }
+                    else
+                    {
+                        modelFutures.push_back(readModelAsync(path, placement.options));
+                    }
+                    placements.push_back(std::move(placement));
+                }
+                auto allModels = getAsyncSystem().all(std::move(modelFutures));
+                if (isMainThread())
+                {
+                    // Can't block the dispatch of main thread tasks
+                    while (!allModels.isReady())
+                    {
+                        getAsyncSystem().dispatchMainThreadTasks();
+                    }
+                }
+                auto modelNodes = allModels.wait();
+                for (size_t i = 0; i < placements.size(); ++i)
+                {
+                    const ModelPlacement& placement = placements[i];
+                    vsg::ref_ptr<vsg::Node> modelNode = modelNodes[i];
+                    if (placement.instances)
+                    {
+                        if (InstancedModel::getInstanceBindings(modelNode))
                         {
-                            modelTransform->addChild(defItr->second);
+                            reportLods(placement.name, modelNode);
+                            auto instancedModel = InstancedModel::create(placement.instances, modelNode);
+                            instancedModel->setCells(placement.cells);
+                            instancedModel->thinningDistance = thinningDistance;
+                            node->addChild(instancedModel);
+                            continue;
                         }
                     }
-                    node->addChild(modelTransform);
+                    if (! modelNode)
+                    {
+                        vsg::error("Couldn't read ", placement.path);
+                        continue;
+                    }
+                    reportLods(placement.name, modelNode);
+                    addTransformedInstances(node, modelNode, *placement.matrices, placement.cells);
                 }
             }
         }
@@ -0,0 +1,190 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "Geodetic.h"
+
+#include "runtimeSupport.h"
+
+#include <CesiumGeospatial/Ellipsoid.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace vsgCs;
+
+namespace
+{
+    // WGS84
+    constexpr double a = 6378137.0;
+    constexpr double f = 1.0 / 298.257223563;
+    constexpr double e2 = f * (2.0 - f);
+    constexpr double e4 = e2 * e2;
+    constexpr double invA2 = 1.0 / (a * a);
+    // Closer to the center than this, use the iterative solution.
+    constexpr double minRadius2 = 0.25 * a * a;
+    // Points are converted in blocks of this size so that the temporaries stay in L1 cache. The
+    // loops over a block have no branches or dependencies between points, so the compiler can
+    // vectorize them; the transcendental functions are in loops of their own.
+    constexpr size_t blockSize = 64;
+
+    double toRadians(AngleUnit unit)
+    {
+        return unit == AngleUnit::DEGREES ? vsg::PI / 180.0 : 1.0;
+    }
+
+    void geodeticToECEFBlock(const vsg::dvec3* in, vsg::dvec3* out, size_t count, double angleScale)
+    {
+        double cosLat[blockSize], sinLat[blockSize], cosLon[blockSize], sinLon[blockSize];
+        double h[blockSize];
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double lon = in[i].x * angleScale;
+            const double lat = in[i].y * angleScale;
+            h[i] = in[i].z;
+            cosLat[i] = std::cos(lat);
+            sinLat[i] = std::sin(lat);
+            cosLon[i] = std::cos(lon);
+            sinLon[i] = std::sin(lon);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double n = a / std::sqrt(1.0 - e2 * sinLat[i] * sinLat[i]);
+            const double r = (n + h[i]) * cosLat[i];
+            out[i].x = r * cosLon[i];
+            out[i].y = r * sinLon[i];
+            out[i].z = (n * (1.0 - e2) + h[i]) * sinLat[i];
+        }
+    }
+
+    // Vermeille's closed form
+    void ecefToGeodeticBlock(const vsg::dvec3* in, vsg::dvec3* out, size_t count, double angleScale)
+    {
+        double x[blockSize], y[blockSize], z[blockSize], rho[blockSize];
+        double r[blockSize], t[blockSize], k[blockSize], d[blockSize], dz[blockSize];
+        double lat[blockSize], lon[blockSize];
+        for (size_t i = 0; i < count; ++i)
+        {
+            x[i] = in[i].x;
+            y[i] = in[i].y;
+            z[i] = in[i].z;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double rho2 = x[i] * x[i] + y[i] * y[i];
+            rho[i] = std::sqrt(rho2);
+            const double p = rho2 * invA2;
+            const double q = (1.0 - e2) * invA2 * z[i] * z[i];
+            r[i] = (p + q - e4) * (1.0 / 6.0);
+            const double s = e4 * p * q / (4.0 * r[i] * r[i] * r[i]);
+            t[i] = 1.0 + s + std::sqrt(s * (2.0 + s));
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            t[i] = std::cbrt(t[i]);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double q = (1.0 - e2) * invA2 * z[i] * z[i];
+            const double u = r[i] * (1.0 + t[i] + 1.0 / t[i]);
+            const double v = std::sqrt(u * u + e4 * q);
+            const double w = e2 * (u + v - q) / (2.0 * v);
+            k[i] = std::sqrt(u + v + w * w) - w;
+            d[i] = k[i] * rho[i] / (k[i] + e2);
+            dz[i] = std::sqrt(d[i] * d[i] + z[i] * z[i]);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            lat[i] = 2.0 * std::atan2(z[i], d[i] + dz[i]);
+            lon[i] = std::atan2(y[i], x[i]);
+        }
+        const double fromRadians = 1.0 / angleScale;
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i].set(lon[i] * fromRadians, lat[i] * fromRadians, (k[i] + e2 - 1.0) / k[i] * dz[i]);
+        }
+        // Deep inside the Earth; rare enough that the branch doesn't matter.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (rho[i] * rho[i] + z[i] * z[i] < minRadius2)
+            {
+                auto result = CesiumGeospatial::Ellipsoid::WGS84.cartesianToCartographic(
+                    glm::dvec3(x[i], y[i], z[i]));
+                out[i] = result
+                    ? vsg::dvec3(result->longitude * fromRadians, result->latitude * fromRadians, result->height)
+                    : vsg::dvec3(0.0, 0.0, 0.0);
+            }
+        }
+    }
+
+    template<typename F>
+    void forEachBlock(std::span<const vsg::dvec3> in, std::span<vsg::dvec3> out, const F& convert)
+    {
+        if (in.size() != out.size())
+        {
+            throw std::invalid_argument("geodetic conversion: spans have different sizes");
+        }
+        for (size_t start = 0; start < in.size(); start += blockSize)
+        {
+            convert(in.data() + start, out.data() + start, std::min(blockSize, in.size() - start));
+        }
+    }
+}
+
+namespace vsgCs
+{
+    vsg::dvec3 geodeticToECEF(const vsg::dvec3& geodetic, AngleUnit unit)
+    {
+        vsg::dvec3 result;
+        geodeticToECEFBlock(&geodetic, &result, 1, toRadians(unit));
+        return result;
+    }
+
+    vsg::dvec3 ecefToGeodetic(const vsg::dvec3& ecef, AngleUnit unit)
+    {
+        vsg::dvec3 result;
+        ecefToGeodeticBlock(&ecef, &result, 1, toRadians(unit));
+        return result;
+    }
+
+    void geodeticToECEF(std::span<const vsg::dvec3> geodetic, std::span<vsg::dvec3> ecef, AngleUnit unit)
+    {
+        const double angleScale = toRadians(unit);
+        forEachBlock(geodetic, ecef,
+                     [angleScale](const vsg::dvec3* in, vsg::dvec3* out, size_t count)
+                     {
+                         geodeticToECEFBlock(in, out, count, angleScale);
+                     });
+    }
+
+    void ecefToGeodetic(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> geodetic, AngleUnit unit)
+    {
+        const double angleScale = toRadians(unit);
+        forEachBlock(ecef, geodetic,
+                     [angleScale](const vsg::dvec3* in, vsg::dvec3* out, size_t count)
+                     {
+                         ecefToGeodeticBlock(in, out, count, angleScale);
+                     });
+    }
+}
@@ -0,0 +1,57 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/maths/vec3.h>
+
+#include <span>
+
+namespace vsgCs
+{
+    enum class AngleUnit
+    {
+        RADIANS,
+        DEGREES
+    };
+
+    /**
+     * @brief WGS84 geodetic <-> ECEF conversion kernels.
+     *
+     * Geodetic coordinates are (longitude, latitude, height), with angles in the given unit. The
+     * inverse is Vermeille's closed form (Journal of Geodesy 76, 2002), which has no iteration and
+     * is accurate to well under a millimeter; points less than half an Earth radius from the
+     * center fall back to cesium-native's iterative solution. The batch versions work on blocks
+     * of points in structure-of-arrays form so that the arithmetic is vectorized by the compiler.
+     * Input and output spans must have the same size and may be the same span.
+     */
+    VSGCS_EXPORT vsg::dvec3 geodeticToECEF(const vsg::dvec3& geodetic, AngleUnit unit = AngleUnit::RADIANS);
+    VSGCS_EXPORT vsg::dvec3 ecefToGeodetic(const vsg::dvec3& ecef, AngleUnit unit = AngleUnit::RADIANS);
+    VSGCS_EXPORT void geodeticToECEF(std::span<const vsg::dvec3> geodetic, std::span<vsg::dvec3> ecef,
+                                     AngleUnit unit = AngleUnit::RADIANS);
+    VSGCS_EXPORT void ecefToGeodetic(std::span<const vsg::dvec3> ecef, std::span<vsg::dvec3> geodetic,
+                                     AngleUnit unit = AngleUnit::RADIANS);
+}
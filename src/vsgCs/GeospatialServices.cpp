@@ -23,6 +23,7 @@ SOFTWARE.
 </editor-fold> */
 
 #include "GeospatialServices.h"
+#include "Geodetic.h"
 #include "runtimeSupport.h"
 
 #include <CesiumGeospatial/LocalHorizontalCoordinateSystem.h>
@@ -154,17 +155,10 @@ vsg::ref_ptr<vsg::Node> CsGeospatialServices::getWorldNode()
 
 vsg::dvec3 CsGeospatialServices::toCartographic(const vsg::dvec3 &worldPos)
 {
-    auto csResult = CesiumGeospatial::Ellipsoid::WGS84.cartesianToCartographic(vsgCs::vsg2glm(worldPos));
-    if (csResult)
-    {
-        return {csResult->longitude, csResult->latitude, csResult->height};
-    }
-    return {0, 0, 0}; // XXX Real error result
+    return ecefToGeodetic(worldPos);
 }
 
 vsg::dvec3 CsGeospatialServices::toWorld(const vsg::dvec3& cartographic)
 {
-    CesiumGeospatial::Cartographic carto(cartographic.x, cartographic.y, cartographic.z);
-    glm::dvec3 csResult = CesiumGeospatial::Ellipsoid::WGS84.cartographicToCartesian(carto);
-    return glm2vsg(csResult);
+    return geodeticToECEF(cartographic);
 }
@@ -24,18 +24,28 @@ SOFTWARE.
 
 #include "GltfLoader.h"
 
+#include "InstancedModel.h"
+#include "MappedFile.h"
 #include "ModelBuilder.h"
+#include "ModelCache.h"
 #include "OpThreadTaskProcessor.h"
+#include "ProgressiveModel.h"
 #include "RuntimeEnvironment.h"
 #include "runtimeSupport.h"
 #include "Styling.h"
 
 
+#include <CesiumAsync/HttpHeaders.h>
 #include <CesiumAsync/IAssetAccessor.h>
 #include <CesiumAsync/IAssetResponse.h>
 #include <CesiumGltfContent/GltfUtilities.h>
 
+#include <vsg/app/Viewer.h>
+
+#include <atomic>
 #include <filesystem>
+#include <map>
+#include <mutex>
 
 using namespace vsgCs;
 
@@ -69,25 +79,176 @@ struct ReadGltfResult
     std::vector<std::string> errors;
 };
 
-CesiumAsync::Future<GltfLoader::ReadGltfResult> GltfLoader::loadGltfNode(const std::string& uri) const
+namespace
 {
-    std::vector<CesiumAsync::IAssetAccessor::THeader> headers;
-    auto accessor = env-> getAssetAccessor();
-    return reader.loadGltf(getAsyncSystem(), uri, headers, accessor,
-                           readerOptions)
-        .thenInWorkerThread([this](CesiumGltfReader::GltfReaderResult&& gltfResult)
+    // The options that change the built model are part of the cache key, and so is the
+    // modification time of a local file, so that an edited file is read again.
+    std::string makeModelKey(const std::string& uri, const std::vector<LodLevel>& lods)
+    {
+        std::string key = uri;
+        const std::string fileScheme("file://");
+        if (uri.starts_with(fileScheme))
+        {
+            std::error_code ec;
+            auto writeTime = std::filesystem::last_write_time(uri.substr(fileScheme.size()), ec);
+            if (!ec)
+            {
+                key += "|mtime:" + std::to_string(writeTime.time_since_epoch().count());
+            }
+        }
+        for (const auto& lod : lods)
+        {
+            key += "|lod:" + std::to_string(lod.triangleRatio) + "," + std::to_string(lod.minimumScreenHeightRatio);
+        }
+        return key;
+    }
+
+    // Compile a model in a worker thread and merge the result in the main thread, as the tiles
+    // are compiled.
+    CesiumAsync::Future<vsg::ref_ptr<vsg::Node>>
+    compileModel(CesiumAsync::Future<vsg::ref_ptr<vsg::Node>>&& future, const vsg::ref_ptr<vsg::Viewer>& viewer)
+    {
+        if (!viewer || !viewer->compileManager)
+        {
+            return std::move(future);
+        }
+        return std::move(future)
+            .thenInWorkerThread([viewer](vsg::ref_ptr<vsg::Node>&& node)
+            {
+                vsg::CompileResult compileResult;
+                if (node)
+                {
+                    compileResult = viewer->compileManager->compile(node);
+                }
+                return std::make_pair(std::move(node), compileResult);
+            })
+            .thenInMainThread([viewer](std::pair<vsg::ref_ptr<vsg::Node>, vsg::CompileResult>&& compiled)
+            {
+                if (compiled.first)
+                {
+                    vsg::updateViewer(*viewer, compiled.second);
+                }
+                return std::move(compiled.first);
+            });
+    }
+
+    // Empty if a local file can't be found
+    std::string makeUri(const vsg::Path& path, const vsg::ref_ptr<const vsg::Options>& options)
+    {
+        std::string pathString = path.string();
+        if (pathString.starts_with("http:") || pathString.starts_with("https:"))
         {
+            return pathString;
+        }
+        auto realPath = vsg::findFile(path, options);
+        if (realPath.empty())
+        {
+            vsg::error("Can't find file ", path);
+            return {};
+        }
+        // Really need an absolute path in order to make a URI
+        std::filesystem::path p = realPath.string();
+        auto absPath = std::filesystem::absolute(p);
+        return "file://" + absPath.string();
+    }
+
+    template <typename TFuture>
+    void waitForLoad(TFuture& future)
+    {
+        if (isMainThread())
+        {
+            // Can't block the dispatch of main thread tasks
+            while (!future.isReady())
+            {
+                getAsyncSystem().dispatchMainThreadTasks();
+            }
+        }
+    }
+}
+
+CesiumAsync::Future<CesiumGltfReader::GltfReaderResult>
+GltfLoader::readGltf(const std::string& uri) const
+{
+    auto accessor = env->getAssetAccessor();
+    const std::string filePrefix = "file://";
+    if (!mapLocalFiles || !uri.starts_with(filePrefix) || !toLower(uri).ends_with(".glb"))
+    {
+        std::vector<CesiumAsync::IAssetAccessor::THeader> headers;
+        return reader.loadGltf(getAsyncSystem(), uri, headers, accessor, readerOptions);
+    }
+    // Parse a local GLB straight from the file's pages, instead of from a copy read by the asset
+    // accessor. External buffers and images are still read by the accessor.
+    return getAsyncSystem()
+        .runInWorkerThread([this, path = uri.substr(filePrefix.size())]()
+        {
+            MappedFile file(path);
+            if (!file.valid())
+            {
+                CesiumGltfReader::GltfReaderResult result;
+                result.errors.push_back("Can't map " + path);
+                return result;
+            }
+            return reader.readGltf(file.data(), readerOptions);
+        })
+        .thenImmediately([this, uri, accessor](CesiumGltfReader::GltfReaderResult&& result)
+        {
+            if (!result.model)
+            {
+                return getAsyncSystem().createResolvedFuture(std::move(result));
+            }
+            return CesiumGltfReader::GltfReader::resolveExternalData(getAsyncSystem(), uri, CesiumAsync::HttpHeaders(),
+                                                                      accessor, readerOptions, std::move(result));
+        });
+}
+
+CesiumAsync::Future<GltfLoader::ReadGltfResult>
+GltfLoader::loadGltfNode(const std::string& uri, const vsg::ref_ptr<const vsg::dmat4Array>& instances,
+                         const std::vector<LodLevel>& lods) const
+{
+    return readGltf(uri)
+        .thenInWorkerThread([this, instances, lods](CesiumGltfReader::GltfReaderResult&& gltfResult)
+        {
+            if (!gltfResult.model)
+            {
+                return ReadGltfResult{{}, gltfResult.errors};
+            }
             CreateModelOptions modelOptions{};
-            ModelBuilder modelBuilder(env->genv, &*gltfResult.model, modelOptions);
+            modelOptions.lods = lods;
             glm::dmat4 yUp(1.0);
             yUp = CesiumGltfContent::GltfUtilities::applyGltfUpAxisTransform(*gltfResult.model, yUp);
+            const vsg::dmat4 upTransform = glm2vsg(yUp);
+            if (instances && !isIdentity(yUp))
+            {
+                // The instances are placed in the coordinate system above the up axis transform.
+                const vsg::dmat4 fromUp = vsg::inverse(upTransform);
+                auto modelInstances = vsg::dmat4Array::create(instances->size());
+                for (size_t i = 0; i < instances->size(); ++i)
+                {
+                    modelInstances->at(i) = fromUp * instances->at(i) * upTransform;
+                }
+                modelOptions.instances = modelInstances;
+            }
+            else
+            {
+                modelOptions.instances = instances;
+            }
+            ModelBuilder modelBuilder(env->genv, &*gltfResult.model, modelOptions);
             auto modelNode = modelBuilder();
             if (isIdentity(yUp))
             {
                 return ReadGltfResult{modelNode, {}};
             }
-            auto transformNode = vsg::MatrixTransform::create(glm2vsg(yUp));
+            auto transformNode = vsg::MatrixTransform::create(upTransform);
             transformNode->addChild(modelNode);
+            if (auto bindings = InstancedModel::getInstanceBindings(modelNode))
+            {
+                bindings->modelBound.center = upTransform * bindings->modelBound.center;
+                transformNode->setObject("vsgCs_instanceBindings", bindings);
+            }
+            if (auto* statistics = modelNode->getObject<LodStatistics>("vsgCs_lodStatistics"))
+            {
+                transformNode->setObject("vsgCs_lodStatistics", vsg::ref_ptr<LodStatistics>(statistics));
+            }
             return ReadGltfResult{transformNode, {}};
         });
 }
@@ -95,33 +256,133 @@ CesiumAsync::Future<GltfLoader::ReadGltfResult> GltfLoader::loadGltfNode(const s
 vsg::ref_ptr<vsg::Object>
 GltfLoader::read(const vsg::Path& path, vsg::ref_ptr<const vsg::Options> options) const
 {
-    using namespace CesiumGltfReader;
-    std::string uriPath;
-    std::string pathString = path.string();
-    if (pathString.starts_with("http:") || pathString.starts_with("https:")) {
-        uriPath = pathString;
-    } else {
-        auto realPath = vsg::findFile(path, options);
-        if (realPath.empty())
+    auto future = readAsync(path, options);
+    waitForLoad(future);
+    return future.wait();
+}
+
+CesiumAsync::Future<vsg::ref_ptr<vsg::Node>>
+GltfLoader::readAsync(const vsg::Path& path, vsg::ref_ptr<const vsg::Options> options) const
+{
+    std::string uriPath = makeUri(path, options);
+    if (uriPath.empty())
+    {
+        return getAsyncSystem().createResolvedFuture(vsg::ref_ptr<vsg::Node>());
+    }
+    vsg::ref_ptr<const vsg::dmat4Array> instances;
+    std::vector<LodLevel> lods;
+    if (options)
+    {
+        instances = options->getObject<vsg::dmat4Array>("vsgCs_instances");
+        if (const auto* lodSettings = options->getObject<LodSettings>("vsgCs_lods"))
         {
-            vsg::fatal("Can't find file ", path);
+            lods = lodSettings->levels;
         }
-        // Really need an absolute path in order to make a URI
-        std::filesystem::path p = realPath.string();
-        auto absPath = std::filesystem::absolute(p);
-        uriPath = "file://" + absPath.string();
     }
-    auto future = loadGltfNode(uriPath);
-    if (isMainThread())
+    auto getNode = [uriPath](ReadGltfResult&& result)
     {
-        // Can't block the dispatch of main thread tasks
-        while (!future.isReady())
+        for (const auto& error : result.errors)
         {
-            getAsyncSystem().dispatchMainThreadTasks();
+            vsg::warn(uriPath, ": ", error);
         }
+        return result.node;
+    };
+    if (instances)
+    {
+        // Instanced models are built for their instances, so they aren't shared.
+        return loadGltfNode(uriPath, instances, lods).thenImmediately(getNode);
     }
+    return env->modelCache->getOrLoad(makeModelKey(uriPath, lods), [this, uriPath, lods, getNode]()
+        {
+            return loadGltfNode(uriPath, {}, lods).thenImmediately(getNode);
+        })
+        .thenImmediately([](const vsg::ref_ptr<vsg::Node>& node)
+        {
+            return node;
+        });
+}
 
-    auto loadResult = future.wait();
+CesiumAsync::Future<std::vector<vsg::ref_ptr<vsg::Node>>>
+GltfLoader::readBatchAsync(const std::vector<ModelRequest>& requests, const ProgressFunction& progress,
+                           bool compile) const
+{
+    vsg::ref_ptr<vsg::Viewer> viewer;
+    if (compile)
+    {
+        viewer = env->getViewer();
+    }
+    auto numRead = std::make_shared<std::atomic<size_t>>(0);
+    const size_t numModels = requests.size();
+    std::vector<CesiumAsync::Future<vsg::ref_ptr<vsg::Node>>> futures;
+    futures.reserve(numModels);
+    // Requests for the same model get the same node from the ModelCache. It must be compiled
+    // only once, not by several worker threads at the same time, so they share one compile.
+    struct SharedCompiles
+    {
+        std::mutex mutex;
+        std::map<const vsg::Node*, CesiumAsync::SharedFuture<vsg::ref_ptr<vsg::Node>>> compiles;
+    };
+    auto sharedCompiles = std::make_shared<SharedCompiles>();
+    auto compileOnce = [sharedCompiles, viewer](vsg::ref_ptr<vsg::Node>&& node)
+    {
+        if (!node || !viewer)
+        {
+            return getAsyncSystem().createResolvedFuture(std::move(node));
+        }
+        std::lock_guard<std::mutex> lock(sharedCompiles->mutex);
+        auto itr = sharedCompiles->compiles.find(node.get());
+        if (itr == sharedCompiles->compiles.end())
+        {
+            const vsg::Node* key = node.get();
+            auto compiled = compileModel(getAsyncSystem().createResolvedFuture(std::move(node)), viewer);
+            itr = sharedCompiles->compiles.emplace(key, std::move(compiled).share()).first;
+        }
+        return itr->second.thenImmediately([](const vsg::ref_ptr<vsg::Node>& compiled)
+        {
+            return compiled;
+        });
+    };
+    // All the models are downloaded, parsed and built at the same time.
+    for (const auto& request : requests)
+    {
+        futures.push_back(readAsync(request.path, request.options)
+                          .thenImmediately(compileOnce)
+                          .thenImmediately([numRead, numModels, progress](vsg::ref_ptr<vsg::Node>&& node)
+                          {
+                              const size_t count = ++*numRead;
+                              if (progress)
+                              {
+                                  progress(count, numModels);
+                              }
+                              return std::move(node);
+                          }));
+    }
+    return getAsyncSystem().all(std::move(futures));
+}
 
-    return loadResult.node;
+vsg::ref_ptr<ProgressiveModel>
+GltfLoader::readProgressive(const vsg::Path& path, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto model = ProgressiveModel::create();
+    std::string uriPath = makeUri(path, options);
+    if (uriPath.empty())
+    {
+        model->fail();
+        return model;
+    }
+    readGltf(uriPath)
+        .thenInWorkerThread([this, model, uriPath](CesiumGltfReader::GltfReaderResult&& gltfResult)
+        {
+            for (const auto& error : gltfResult.errors)
+            {
+                vsg::warn(uriPath, ": ", error);
+            }
+            if (!gltfResult.model)
+            {
+                model->fail();
+                return;
+            }
+            model->build(env->genv, *gltfResult.model);
+        });
+    return model;
 }
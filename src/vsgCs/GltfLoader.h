@@ -25,29 +25,83 @@ SOFTWARE.
 #pragma once
 
 #include "vsgCs/Export.h"
+#include "MeshSimplifier.h"
+#include "ProgressiveModel.h"
 #include "RuntimeEnvironment.h"
 
 #include <CesiumAsync/Future.h>
 #include <CesiumGltfReader/GltfReader.h>
 
 #include <vsg/io/ReaderWriter.h>
+#include <vsg/nodes/Node.h>
+
+#include <functional>
+#include <vector>
 
 namespace vsgCs
 {
 
+    /**
+     * @brief vsg::ReaderWriter for glTF models, using cesium-native and ModelBuilder.
+     *
+     * If the options hold a vsg::dmat4Array object named "vsgCs_instances", the model is built
+     * for drawing once per matrix with GPU instancing; see InstancedModel. If they hold a
+     * LodSettings object named "vsgCs_lods", simplified levels of detail of the model are built.
+     *
+     * Models without instances are shared through the RuntimeEnvironment's ModelCache, so the
+     * returned subgraph must not be modified. A local file is read again when it has been
+     * modified since it was cached.
+     */
     class VSGCS_EXPORT GltfLoader : public vsg::Inherit<vsg::ReaderWriter, GltfLoader>
     {
     public:
         GltfLoader(const vsg::ref_ptr<RuntimeEnvironment>& in_env = RuntimeEnvironment::get());
         vsg::ref_ptr<vsg::Object>
             read(const vsg::Path& /*filename*/, vsg::ref_ptr<const vsg::Options>) const override;
+        /**
+         * @brief Read a model without blocking the calling thread.
+         *
+         * The model is downloaded, parsed and built in worker threads. The future resolves to
+         * nullptr if the model can't be read.
+         */
+        CesiumAsync::Future<vsg::ref_ptr<vsg::Node>> readAsync(const vsg::Path& path,
+                                                                vsg::ref_ptr<const vsg::Options> options) const;
+        struct ModelRequest
+        {
+            vsg::Path path;
+            vsg::ref_ptr<const vsg::Options> options;
+        };
+        /// Called, possibly from a worker thread, as each model of a batch is finished.
+        using ProgressFunction = std::function<void(size_t numRead, size_t numModels)>;
+        /**
+         * @brief Read several models concurrently.
+         *
+         * If compile is true and the viewer has been compiled, each model is also compiled in a
+         * worker thread as soon as it is built. The models are in the order of the requests.
+         */
+        CesiumAsync::Future<std::vector<vsg::ref_ptr<vsg::Node>>>
+            readBatchAsync(const std::vector<ModelRequest>& requests, const ProgressFunction& progress = {},
+                           bool compile = false) const;
+        /**
+         * @brief Read a model that is shown a piece at a time as it is built.
+         *
+         * Returns at once; add the model to the scene and call its update() every frame. See
+         * ProgressiveModel.
+         */
+        vsg::ref_ptr<ProgressiveModel> readProgressive(const vsg::Path& path,
+                                                       vsg::ref_ptr<const vsg::Options> options) const;
+        /// Parse local .glb files from a memory mapping instead of reading them into memory first
+        bool mapLocalFiles = true;
     protected:
         struct ReadGltfResult
         {
             vsg::ref_ptr<vsg::Node> node;
             std::vector<std::string> errors;
         };
-        CesiumAsync::Future<ReadGltfResult> loadGltfNode(const std::string& uri) const;
+        CesiumAsync::Future<CesiumGltfReader::GltfReaderResult> readGltf(const std::string& uri) const;
+        CesiumAsync::Future<ReadGltfResult> loadGltfNode(const std::string& uri,
+                                                         const vsg::ref_ptr<const vsg::dmat4Array>& instances = {},
+                                                         const std::vector<LodLevel>& lods = {}) const;
         vsg::ref_ptr<RuntimeEnvironment> env;
         CesiumGltfReader::GltfReader reader;
         CesiumGltfReader::GltfReaderOptions readerOptions;
@@ -0,0 +1,324 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "GraphOptimizer.h"
+#include "runtimeSupport.h"
+#include "Tracing.h"
+
+#include <vsg/commands/VertexDraw.h>
+#include <vsg/commands/VertexIndexDraw.h>
+#include <vsg/core/Array.h>
+#include <vsg/core/ConstVisitor.h>
+#include <vsg/nodes/CullNode.h>
+#include <vsg/nodes/DepthSorted.h>
+#include <vsg/nodes/MatrixTransform.h>
+#include <vsg/nodes/StateGroup.h>
+#include <vsg/nodes/Switch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <typeinfo>
+#include <vector>
+
+using namespace vsgCs;
+
+namespace
+{
+    struct CountNodes : public vsg::ConstVisitor
+    {
+        uint32_t count = 0;
+        void apply(const vsg::Node& node) override
+        {
+            ++count;
+            node.traverse(*this);
+        }
+    };
+
+    double elapsedMicroseconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint32_t timedCount(const vsg::ref_ptr<vsg::Group>& root, double& microseconds)
+    {
+        auto start = std::chrono::steady_clock::now();
+        CountNodes counter;
+        root->accept(counter);
+        microseconds = elapsedMicroseconds(start);
+        return counter.count;
+    }
+
+    bool isIdentityMatrix(const vsg::dmat4& mat)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                if (!equiv(mat[c][r], c == r ? 1.0 : 0.0))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template<typename T>
+    bool isExactly(const vsg::Node& node)
+    {
+        return node.type_info() == typeid(T);
+    }
+
+    vsg::dsphere transformSphere(const vsg::dsphere& sphere, const vsg::dmat4& matrix)
+    {
+        if (!sphere.valid())
+        {
+            return sphere;
+        }
+        double maxScale = 0.0;
+        for (int c = 0; c < 3; ++c)
+        {
+            maxScale = std::max(maxScale, vsg::length(vsg::dvec3(matrix[c][0], matrix[c][1], matrix[c][2])));
+        }
+        return {matrix * sphere.center, sphere.radius * maxScale};
+    }
+
+    // The draw command at the bottom of a primitive subgraph built by ModelBuilder::loadPrimitive.
+    vsg::ref_ptr<vsg::Command> getPrimitiveDraw(const vsg::ref_ptr<vsg::StateGroup>& stateGroup)
+    {
+        if (!stateGroup || stateGroup->children.size() != 1)
+        {
+            return {};
+        }
+        auto& child = stateGroup->children[0];
+        if (ref_ptr_cast<vsg::VertexIndexDraw>(child) || ref_ptr_cast<vsg::VertexDraw>(child))
+        {
+            return ref_ptr_cast<vsg::Command>(child);
+        }
+        return {};
+    }
+}
+
+GraphOptimizer::Stats GraphOptimizer::optimize(const vsg::ref_ptr<vsg::Group>& root)
+{
+    VSGCS_ZONESCOPED;
+    _stats = Stats();
+    _bakedData.clear();
+    if (!root)
+    {
+        return _stats;
+    }
+    auto start = std::chrono::steady_clock::now();
+    _stats.nodesBefore = timedCount(root, _stats.traversalBefore);
+    vsg::Group::Children result;
+    vsg::Group::Children needTransform;
+    vsg::dmat4 identity;
+    for (auto& child : root->children)
+    {
+        flatten(child, identity, true, result, needTransform);
+    }
+    root->children = std::move(result);
+    _stats.optimizeTime = elapsedMicroseconds(start);
+    _stats.nodesAfter = timedCount(root, _stats.traversalAfter);
+    return _stats;
+}
+
+// Append the flattened version of node to result. If node is a leaf that has a non-identity
+// transform that can't be baked into its vertices, it's appended to needTransform instead, and the
+// closest MatrixTransform ancestor will create a single transform node for it and its siblings.
+
+void GraphOptimizer::flatten(const vsg::ref_ptr<vsg::Node>& node, const vsg::dmat4& matrix, bool identity,
+                             vsg::Group::Children& result, vsg::Group::Children& needTransform)
+{
+    if (!node)
+    {
+        return;
+    }
+    if (isExactly<vsg::Group>(*node))
+    {
+        auto group = ref_ptr_cast<vsg::Group>(node);
+        for (auto& child : group->children)
+        {
+            flatten(child, matrix, identity, result, needTransform);
+        }
+        return;
+    }
+    if (isExactly<vsg::MatrixTransform>(*node))
+    {
+        auto transform = ref_ptr_cast<vsg::MatrixTransform>(node);
+        vsg::dmat4 accumulated = matrix * transform->matrix;
+        bool accumulatedIdentity = isIdentityMatrix(accumulated);
+        vsg::Group::Children localNeedTransform;
+        for (auto& child : transform->children)
+        {
+            flatten(child, accumulated, accumulatedIdentity, result, localNeedTransform);
+        }
+        if (!localNeedTransform.empty())
+        {
+            auto newTransform = vsg::MatrixTransform::create(accumulated);
+            newTransform->children = std::move(localNeedTransform);
+            result.push_back(newTransform);
+        }
+        return;
+    }
+    if (identity)
+    {
+        result.push_back(node);
+    }
+    else if (bakeTransforms && bake(node, matrix))
+    {
+        ++_stats.transformsBaked;
+        result.push_back(node);
+    }
+    else
+    {
+        needTransform.push_back(node);
+    }
+}
+
+// Transform the positions and normals of a primitive in place. This is only possible before the
+// primitive is compiled, if its data isn't used elsewhere, if it doesn't use GPU instancing --
+// the instance matrix is applied before the node's transform -- and if the translation isn't too
+// far for float positions. With the depth pre-pass a primitive
+// is a Switch whose children share one draw command.
+
+bool GraphOptimizer::bake(const vsg::ref_ptr<vsg::Node>& node, const vsg::dmat4& matrix)
+{
+    std::vector<vsg::ref_ptr<vsg::Node>> parts;
+    if (auto passSwitch = ref_ptr_cast<vsg::Switch>(node))
+    {
+        for (auto& child : passSwitch->children)
+        {
+            parts.push_back(child.node);
+        }
+    }
+    else
+    {
+        parts.push_back(node);
+    }
+    std::vector<vsg::dsphere*> bounds;
+    std::vector<vsg::ref_ptr<vsg::vec3Array>> bakeArrays;
+    std::set<vsg::Command*> draws;
+    for (auto& part : parts)
+    {
+        vsg::ref_ptr<vsg::StateGroup> stateGroup;
+        if (auto cullNode = ref_ptr_cast<vsg::CullNode>(part))
+        {
+            stateGroup = ref_ptr_cast<vsg::StateGroup>(cullNode->child);
+            bounds.push_back(&cullNode->bound);
+        }
+        else if (auto depthSorted = ref_ptr_cast<vsg::DepthSorted>(part))
+        {
+            stateGroup = ref_ptr_cast<vsg::StateGroup>(depthSorted->child);
+            bounds.push_back(&depthSorted->bound);
+        }
+        else
+        {
+            stateGroup = ref_ptr_cast<vsg::StateGroup>(part);
+        }
+        auto draw = getPrimitiveDraw(stateGroup);
+        if (!draw)
+        {
+            return false;
+        }
+        if (!draws.insert(draw.get()).second)
+        {
+            continue;
+        }
+        bool instanced = false;
+        if (draw->getValue("vsgCs_instanced", instanced) && instanced)
+        {
+            return false;
+        }
+        vsg::BufferInfoList* arrays = nullptr;
+        if (auto vid = ref_ptr_cast<vsg::VertexIndexDraw>(draw))
+        {
+            arrays = &vid->arrays;
+        }
+        else
+        {
+            arrays = &ref_ptr_cast<vsg::VertexDraw>(draw)->arrays;
+        }
+        // ModelBuilder assigns vsg_Vertex and then vsg_Normal.
+        if (arrays->size() < 2 || !(*arrays)[0] || !(*arrays)[1])
+        {
+            return false;
+        }
+        auto positions = ref_ptr_cast<vsg::vec3Array>((*arrays)[0]->data);
+        auto normals = ref_ptr_cast<vsg::vec3Array>((*arrays)[1]->data);
+        if (!positions || _bakedData.count(positions.get()) != 0
+            || (normals && (normals->size() != positions->size() || _bakedData.count(normals.get()) != 0)))
+        {
+            return false;
+        }
+        bakeArrays.push_back(positions);
+        bakeArrays.push_back(normals);
+    }
+    // Positions are floats, so a translation that is large compared to the primitive, e.g. to an
+    // ECEF position, would cost it its precision. It stays in a transform instead.
+    const vsg::dvec3 translation(matrix[3][0], matrix[3][1], matrix[3][2]);
+    double extent = 0.0;
+    for (size_t i = 0; i < bakeArrays.size(); i += 2)
+    {
+        for (const auto& position : *bakeArrays[i])
+        {
+            extent = std::max(extent, vsg::length(matrix * vsg::dvec3(position) - translation));
+        }
+    }
+    if (vsg::length(translation) > maxTranslationRatio * extent)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < bakeArrays.size(); i += 2)
+    {
+        auto& positions = bakeArrays[i];
+        auto& normals = bakeArrays[i + 1];
+        for (auto& position : *positions)
+        {
+            position = vsg::vec3(matrix * vsg::dvec3(position));
+        }
+        _bakedData.insert(positions.get());
+        if (normals)
+        {
+            // Normals are transformed by the inverse transpose.
+            const vsg::dmat4 inv = vsg::inverse(matrix);
+            for (auto& normal : *normals)
+            {
+                vsg::dvec3 n(normal);
+                vsg::dvec3 transformed(inv[0][0] * n.x + inv[0][1] * n.y + inv[0][2] * n.z,
+                                       inv[1][0] * n.x + inv[1][1] * n.y + inv[1][2] * n.z,
+                                       inv[2][0] * n.x + inv[2][1] * n.y + inv[2][2] * n.z);
+                double len = vsg::length(transformed);
+                normal = len > 0.0 ? vsg::vec3(transformed / len) : normal;
+            }
+            _bakedData.insert(normals.get());
+        }
+    }
+    for (auto* bound : bounds)
+    {
+        *bound = transformSphere(*bound, matrix);
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/maths/mat4.h>
+#include <vsg/nodes/Group.h>
+
+#include <cstdint>
+#include <set>
+
+namespace vsgCs
+{
+    /**
+     * @brief Flatten the scene graph produced by ModelBuilder before it is compiled.
+     *
+     * glTF models, and 3D Tiles in particular, often contain long chains of nodes with identity
+     * transforms, groups with a single child, and static transforms that only exist because of the
+     * authoring tool. These cost time in every record traversal. This pass, run in the load
+     * thread, removes trivial groups, splices single-child chains into their parents, and bakes
+     * static transforms into the vertex positions and normals of primitives that aren't
+     * instanced. Primitives that can't be baked keep a single transform with the accumulated
+     * matrix, as do primitives whose translation is more than maxTranslationRatio times their
+     * size, which would lose precision in float vertex positions.
+     *
+     * Only plain vsg::Group and vsg::MatrixTransform nodes are removed; anything else is treated
+     * as a leaf.
+     */
+    class VSGCS_EXPORT GraphOptimizer
+    {
+    public:
+        struct Stats
+        {
+            uint32_t nodesBefore = 0;
+            uint32_t nodesAfter = 0;
+            uint32_t transformsBaked = 0;
+            // Time of a simple traversal of the graph, in microseconds. This is a proxy for
+            // the cost of the graph in the record traversal.
+            double traversalBefore = 0.0;
+            double traversalAfter = 0.0;
+            // Time of the whole optimization, in microseconds
+            double optimizeTime = 0.0;
+        };
+        /**
+         * @brief Optimize the graph under root in place. The root node itself is preserved.
+         */
+        Stats optimize(const vsg::ref_ptr<vsg::Group>& root);
+        bool bakeTransforms = true;
+        double maxTranslationRatio = 16.0;
+    protected:
+        void flatten(const vsg::ref_ptr<vsg::Node>& node, const vsg::dmat4& matrix, bool identity,
+                     vsg::Group::Children& result, vsg::Group::Children& needTransform);
+        bool bake(const vsg::ref_ptr<vsg::Node>& node, const vsg::dmat4& matrix);
+        std::set<const vsg::Data*> _bakedData;
+        Stats _stats;
+    };
+}
@@ -49,6 +49,7 @@ namespace vsgCs
         bool textureCompressionBC = false;
         bool textureCompressionPVRTC = false;
         bool depthClamp = false;
+        bool pipelineStatisticsQuery = false;
         CesiumGltf::Ktx2TranscodeTargets ktx2TranscodeTargets;
         float pointSizeRange[2];
         PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT
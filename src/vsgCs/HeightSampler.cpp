@@ -0,0 +1,143 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "HeightSampler.h"
+
+#include <vsg/core/observer_ptr.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace vsgCs;
+
+namespace
+{
+    // Good enough for converting sample spacing to angles
+    const double earthRadius = 6371000.0;
+}
+
+HeightSampler::HeightSampler(const vsg::ref_ptr<TerrainService>& terrainService, uint32_t gridSize)
+    : refreshInterval(0.5), _terrainService(terrainService), _gridSize(std::max(gridSize, 2u)), _pending(false)
+{
+}
+
+bool HeightSampler::needsRefresh(double longitude, double latitude, double spacing, vsg::time_point now) const
+{
+    if (!_grid)
+    {
+        return true;
+    }
+    if (spacing > _grid->spacing * 2.0 || spacing < _grid->spacing * 0.5)
+    {
+        return true;
+    }
+    const double lonExtent = _grid->lonStep * (_gridSize - 1);
+    const double latExtent = _grid->latStep * (_gridSize - 1);
+    const double u = (longitude - _grid->west) / lonExtent;
+    const double v = (latitude - _grid->south) / latExtent;
+    if (u < 0.25 || u > 0.75 || v < 0.25 || v > 0.75)
+    {
+        return true;
+    }
+    return std::chrono::duration<double>(now - _lastRequest).count() > refreshInterval;
+}
+
+void HeightSampler::update(double longitude, double latitude, double spacing, vsg::time_point now)
+{
+    if (_pending || !needsRefresh(longitude, latitude, spacing, now))
+    {
+        return;
+    }
+    Grid grid;
+    grid.spacing = spacing;
+    grid.latStep = spacing / earthRadius;
+    grid.lonStep = grid.latStep / std::max(std::cos(latitude), 0.01);
+    const double halfSize = (_gridSize - 1) * 0.5;
+    grid.west = longitude - grid.lonStep * halfSize;
+    grid.south = latitude - grid.latStep * halfSize;
+    std::vector<vsg::dvec2> lonLats;
+    lonLats.reserve(static_cast<size_t>(_gridSize) * _gridSize);
+    for (uint32_t j = 0; j < _gridSize; ++j)
+    {
+        for (uint32_t i = 0; i < _gridSize; ++i)
+        {
+            lonLats.emplace_back(grid.west + i * grid.lonStep, grid.south + j * grid.latStep);
+        }
+    }
+    _pending = true;
+    _lastRequest = now;
+    vsg::observer_ptr<HeightSampler> observer(this);
+    _terrainService->getHeightsAsync(std::move(lonLats))
+        .thenInMainThread([observer, grid = std::move(grid)](std::vector<std::optional<double>>&& heights) mutable
+        {
+            vsg::ref_ptr<HeightSampler> sampler = observer;
+            if (!sampler)
+            {
+                return;
+            }
+            sampler->_pending = false;
+            grid.heights = std::move(heights);
+            sampler->_grid = std::move(grid);
+        });
+}
+
+std::optional<double> HeightSampler::getHeight(double longitude, double latitude) const
+{
+    if (!_grid)
+    {
+        return {};
+    }
+    const double u = (longitude - _grid->west) / _grid->lonStep;
+    const double v = (latitude - _grid->south) / _grid->latStep;
+    const double last = _gridSize - 1;
+    if (u < 0.0 || v < 0.0 || u > last || v > last)
+    {
+        return {};
+    }
+    const auto i = std::min(static_cast<uint32_t>(u), _gridSize - 2);
+    const auto j = std::min(static_cast<uint32_t>(v), _gridSize - 2);
+    const double fu = u - i;
+    const double fv = v - j;
+    // Samples that missed the terrain are left out of the interpolation.
+    double height = 0.0;
+    double weight = 0.0;
+    auto accumulate = [&](uint32_t si, uint32_t sj, double w)
+    {
+        const auto& sample = _grid->heights[sj * _gridSize + si];
+        if (sample && w > 0.0)
+        {
+            height += *sample * w;
+            weight += w;
+        }
+    };
+    accumulate(i, j, (1.0 - fu) * (1.0 - fv));
+    accumulate(i + 1, j, fu * (1.0 - fv));
+    accumulate(i, j + 1, (1.0 - fu) * fv);
+    accumulate(i + 1, j + 1, fu * fv);
+    if (weight <= 0.0)
+    {
+        return {};
+    }
+    return height / weight;
+}
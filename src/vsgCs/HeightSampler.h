@@ -0,0 +1,78 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+#include "TerrainService.h"
+
+#include <vsg/core/Inherit.h>
+#include <vsg/ui/UIEvent.h>
+
+#include <optional>
+#include <vector>
+
+namespace vsgCs
+{
+    /**
+     * @brief A grid of terrain heights around a moving point, such as the camera, sampled
+     * asynchronously from a TerrainService and interpolated between refreshes.
+     *
+     * Call update() each frame in the main thread. A new grid centered on the point is requested
+     * when the point leaves the inner half of the current grid, when the sample spacing changes by
+     * more than a factor of two, or when refreshInterval has passed, so that finer tiles are
+     * picked up. Only one request is in flight at a time, so the cost per frame is bounded.
+     */
+    class VSGCS_EXPORT HeightSampler : public vsg::Inherit<vsg::Object, HeightSampler>
+    {
+    public:
+        explicit HeightSampler(const vsg::ref_ptr<TerrainService>& terrainService, uint32_t gridSize = 9);
+        /**
+         * @param longitude in radians
+         * @param latitude in radians
+         * @param spacing distance between samples, in meters
+         */
+        void update(double longitude, double latitude, double spacing, vsg::time_point now);
+        /// @brief Bilinear interpolation of the latest grid; empty outside of it.
+        std::optional<double> getHeight(double longitude, double latitude) const;
+        /// Seconds between refreshes of a grid that is still usable
+        double refreshInterval;
+    protected:
+        struct Grid
+        {
+            double west;
+            double south;
+            double lonStep;
+            double latStep;
+            double spacing;
+            std::vector<std::optional<double>> heights;
+        };
+        bool needsRefresh(double longitude, double latitude, double spacing, vsg::time_point now) const;
+        vsg::ref_ptr<TerrainService> _terrainService;
+        uint32_t _gridSize;
+        std::optional<Grid> _grid;
+        bool _pending;
+        vsg::time_point _lastRequest;
+    };
+}
@@ -0,0 +1,391 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "InstanceFile.h"
+
+#include "OpThreadTaskProcessor.h"
+#include "runtimeSupport.h"
+
+#include <vsg/io/Logger.h>
+#include <vsg/maths/transform.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+using namespace vsgCs;
+
+namespace
+{
+    const char instanceMagic[8] = {'v', 's', 'g', 'C', 's', 'I', 'N', 'S'};
+    constexpr uint32_t instanceVersion = 1;
+    constexpr size_t recordSize = 36;
+    // Instances converted by one worker thread task
+    constexpr size_t batchSize = 65536;
+
+    using Dispatch = std::function<void(std::vector<InstanceRecord>&&)>;
+
+    struct ConvertedBatch
+    {
+        std::vector<uint32_t> models;
+        std::vector<vsg::dmat4> matrices;
+    };
+
+    ConvertedBatch convertBatch(const std::vector<InstanceRecord>& records, CRS& crs,
+                                const vsg::dmat4& worldToLocal)
+    {
+        // WGS84 radii, for the surface normal
+        constexpr double a = 6378137.0;
+        constexpr double b = 6356752.3142451793;
+        std::vector<vsg::dvec3> ecef(records.size());
+        std::transform(records.begin(), records.end(), ecef.begin(),
+                       [](const InstanceRecord& record)
+                       {
+                           return record.coords;
+                       });
+        crs.getECEF(ecef, ecef);
+        // Without a globe the coordinates are already local, and the frame is the identity.
+        const bool hasGlobe = crs.hasGlobe();
+        ConvertedBatch result;
+        result.models.reserve(records.size());
+        result.matrices.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            const vsg::dvec3& p = ecef[i];
+            if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+            {
+                // The CRS couldn't convert it.
+                continue;
+            }
+            vsg::dmat4 enu;
+            if (hasGlobe)
+            {
+                const vsg::dvec3 up = vsg::normalize(vsg::dvec3(p.x / (a * a), p.y / (a * a), p.z / (b * b)));
+                vsg::dvec3 east(-up.y, up.x, 0.0);
+                const double eastLength = vsg::length(east);
+                // At the poles any east will do.
+                east = eastLength > 1e-12 ? east / eastLength : vsg::dvec3(0.0, 1.0, 0.0);
+                const vsg::dvec3 north = vsg::cross(up, east);
+                enu[0] = vsg::dvec4(east, 0.0);
+                enu[1] = vsg::dvec4(north, 0.0);
+                enu[2] = vsg::dvec4(up, 0.0);
+            }
+            enu[3] = vsg::dvec4(p, 1.0);
+            const double scale = records[i].scale;
+            result.matrices.push_back(worldToLocal * enu
+                                      * vsg::rotate(vsg::radians(-static_cast<double>(records[i].heading)),
+                                                    0.0, 0.0, 1.0)
+                                      * vsg::scale(scale, scale, scale));
+            result.models.push_back(records[i].model);
+        }
+        return result;
+    }
+
+    template<typename T>
+    bool readValue(std::istream& stream, T& value)
+    {
+        char bytes[sizeof(T)];
+        if (!stream.read(bytes, sizeof(T)))
+        {
+            return false;
+        }
+        std::memcpy(&value, bytes, sizeof(T));
+        return true;
+    }
+
+    template<typename T>
+    void writeValue(std::ostream& stream, const T& value)
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        stream.write(bytes, sizeof(T));
+    }
+
+    bool readBinary(std::istream& stream, std::vector<std::string>& modelNames, const Dispatch& dispatch)
+    {
+        uint32_t version = 0;
+        uint32_t numModels = 0;
+        if (!readValue(stream, version) || version != instanceVersion || !readValue(stream, numModels))
+        {
+            vsg::warn("Unsupported instance file version ", version);
+            return false;
+        }
+        for (uint32_t i = 0; i < numModels; ++i)
+        {
+            uint32_t length = 0;
+            if (!readValue(stream, length))
+            {
+                return false;
+            }
+            std::string name(length, '\0');
+            if (!stream.read(name.data(), length))
+            {
+                return false;
+            }
+            modelNames.push_back(std::move(name));
+        }
+        uint64_t remaining = 0;
+        if (!readValue(stream, remaining))
+        {
+            return false;
+        }
+        std::vector<char> buffer(batchSize * recordSize);
+        while (remaining > 0)
+        {
+            const size_t count = static_cast<size_t>(std::min<uint64_t>(remaining, batchSize));
+            if (!stream.read(buffer.data(), static_cast<std::streamsize>(count * recordSize)))
+            {
+                vsg::warn("Instance file is truncated");
+                return false;
+            }
+            std::vector<InstanceRecord> records(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const char* bytes = buffer.data() + i * recordSize;
+                std::memcpy(&records[i].coords.x, bytes, 8);
+                std::memcpy(&records[i].coords.y, bytes + 8, 8);
+                std::memcpy(&records[i].coords.z, bytes + 16, 8);
+                std::memcpy(&records[i].heading, bytes + 24, 4);
+                std::memcpy(&records[i].scale, bytes + 28, 4);
+                std::memcpy(&records[i].model, bytes + 32, 4);
+            }
+            dispatch(std::move(records));
+            remaining -= count;
+        }
+        return true;
+    }
+
+    std::string_view trim(std::string_view field)
+    {
+        const auto first = field.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos)
+        {
+            return {};
+        }
+        const auto last = field.find_last_not_of(" \t\r");
+        return field.substr(first, last - first + 1);
+    }
+
+    template<typename T>
+    bool parseNumber(std::string_view field, T& value)
+    {
+        field = trim(field);
+        if (!field.empty() && field.front() == '+')
+        {
+            field.remove_prefix(1);
+        }
+        const auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+        return ec == std::errc() && end == field.data() + field.size();
+    }
+
+    bool readCsv(std::istream& stream, std::vector<std::string>& modelNames, const Dispatch& dispatch)
+    {
+        std::map<std::string, uint32_t, std::less<>> modelIndices;
+        std::vector<InstanceRecord> records;
+        records.reserve(batchSize);
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(stream, line))
+        {
+            ++lineNumber;
+            std::string_view rest = trim(line);
+            if (rest.empty() || rest.front() == '#')
+            {
+                continue;
+            }
+            std::array<std::string_view, 6> fields;
+            size_t numFields = 0;
+            while (numFields < fields.size())
+            {
+                const auto comma = rest.find(',');
+                fields[numFields++] = rest.substr(0, comma);
+                if (comma == std::string_view::npos)
+                {
+                    break;
+                }
+                rest.remove_prefix(comma + 1);
+            }
+            InstanceRecord record;
+            if (numFields < 4
+                || !parseNumber(fields[1], record.coords.x)
+                || !parseNumber(fields[2], record.coords.y)
+                || !parseNumber(fields[3], record.coords.z)
+                || (numFields > 4 && !parseNumber(fields[4], record.heading))
+                || (numFields > 5 && !parseNumber(fields[5], record.scale)))
+            {
+                vsg::warn("Instance file line ", lineNumber, ": expected modelName,x,y,z[,heading[,scale]]");
+                continue;
+            }
+            const std::string_view name = trim(fields[0]);
+            auto itr = modelIndices.find(name);
+            if (itr == modelIndices.end())
+            {
+                itr = modelIndices.emplace(std::string(name), static_cast<uint32_t>(modelNames.size())).first;
+                modelNames.emplace_back(name);
+            }
+            record.model = itr->second;
+            records.push_back(record);
+            if (records.size() == batchSize)
+            {
+                dispatch(std::move(records));
+                records = {};
+                records.reserve(batchSize);
+            }
+        }
+        if (!records.empty())
+        {
+            dispatch(std::move(records));
+        }
+        return true;
+    }
+}
+
+int64_t vsgCs::readInstanceFile(const vsg::Path& path, const std::shared_ptr<CRS>& crs,
+                                const vsg::dmat4& worldToLocal,
+                                std::map<std::string, std::vector<vsg::dmat4>>& modelInstances)
+{
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    std::ifstream stream(path.string(), std::ios::binary);
+    if (!stream)
+    {
+        vsg::warn("Couldn't open instance file ", path);
+        return -1;
+    }
+    std::vector<std::string> modelNames;
+    std::vector<CesiumAsync::Future<ConvertedBatch>> futures;
+    // Batches are converted while the rest of the file is read.
+    auto dispatch = [&futures, crs, worldToLocal, &path](std::vector<InstanceRecord>&& records)
+    {
+        auto batch = std::make_shared<std::vector<InstanceRecord>>(std::move(records));
+        futures.push_back(getAsyncSystem().runInWorkerThread([batch, crs, worldToLocal, fileName = path.string()]()
+        {
+            // A failed conversion, e.g. coordinates outside the CRS, only loses its own batch.
+            try
+            {
+                return convertBatch(*batch, *crs, worldToLocal);
+            }
+            catch (const std::exception& e)
+            {
+                vsg::warn("Instance file ", fileName, ": couldn't convert ", batch->size(), " instances: ",
+                          e.what());
+                return ConvertedBatch();
+            }
+        }));
+    };
+    char magic[sizeof(instanceMagic)];
+    bool readOK = false;
+    if (stream.read(magic, sizeof(magic)) && std::memcmp(magic, instanceMagic, sizeof(magic)) == 0)
+    {
+        readOK = readBinary(stream, modelNames, dispatch);
+    }
+    else
+    {
+        stream.clear();
+        stream.seekg(0);
+        readOK = readCsv(stream, modelNames, dispatch);
+    }
+    auto allBatches = getAsyncSystem().all(std::move(futures));
+    if (isMainThread())
+    {
+        // Can't block the dispatch of main thread tasks
+        while (!allBatches.isReady())
+        {
+            getAsyncSystem().dispatchMainThreadTasks();
+        }
+    }
+    auto batches = allBatches.wait();
+    if (!readOK)
+    {
+        vsg::warn("Error reading instance file ", path);
+        return -1;
+    }
+    std::vector<std::vector<vsg::dmat4>*> targets;
+    targets.reserve(modelNames.size());
+    for (const auto& name : modelNames)
+    {
+        targets.push_back(&modelInstances[name]);
+    }
+    int64_t numInstances = 0;
+    size_t badModels = 0;
+    for (auto& batch : batches)
+    {
+        for (size_t i = 0; i < batch.matrices.size(); ++i)
+        {
+            if (batch.models[i] >= targets.size())
+            {
+                ++badModels;
+                continue;
+            }
+            targets[batch.models[i]]->push_back(batch.matrices[i]);
+            ++numInstances;
+        }
+        // Release each batch as soon as it's copied.
+        batch = ConvertedBatch();
+    }
+    if (badModels > 0)
+    {
+        vsg::warn(path, ": ", badModels, " instances have an invalid model index");
+    }
+    vsg::info("Read ", numInstances, " instances from ", path, " in ",
+              std::chrono::duration<double, std::milli>(clock::now() - start).count(), " ms");
+    return numInstances;
+}
+
+bool vsgCs::writeInstanceFile(const vsg::Path& path, const std::vector<std::string>& modelNames,
+                              std::span<const InstanceRecord> records)
+{
+    std::ofstream stream(path.string(), std::ios::binary);
+    if (!stream)
+    {
+        vsg::warn("Couldn't create instance file ", path);
+        return false;
+    }
+    stream.write(instanceMagic, sizeof(instanceMagic));
+    writeValue(stream, instanceVersion);
+    writeValue(stream, static_cast<uint32_t>(modelNames.size()));
+    for (const auto& name : modelNames)
+    {
+        writeValue(stream, static_cast<uint32_t>(name.size()));
+        stream.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+    writeValue(stream, static_cast<uint64_t>(records.size()));
+    for (const auto& record : records)
+    {
+        writeValue(stream, record.coords.x);
+        writeValue(stream, record.coords.y);
+        writeValue(stream, record.coords.z);
+        writeValue(stream, record.heading);
+        writeValue(stream, record.scale);
+        writeValue(stream, record.model);
+    }
+    return static_cast<bool>(stream);
+}
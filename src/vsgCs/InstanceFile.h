@@ -0,0 +1,80 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+#include "CRS.h"
+
+#include <vsg/io/Path.h>
+#include <vsg/maths/mat4.h>
+
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace vsgCs
+{
+    /**
+     * @brief One model instance, as stored in an instance file. The coordinates are in the CRS of
+     * the file's user, e.g. longitude, latitude and height in degrees for WGS84; the heading is in
+     * degrees clockwise from north.
+     */
+    struct InstanceRecord
+    {
+        vsg::dvec3 coords;
+        float heading = 0.0f;
+        float scale = 1.0f;
+        // Index into the model names of the file
+        uint32_t model = 0;
+    };
+
+    /**
+     * @brief Read model instances from a CSV or binary instance file.
+     *
+     * The file is streamed in batches, which are converted to ECEF and then to the instances'
+     * local frame in worker threads. Each instance is oriented in the East North Up frame at its
+     * position, so that large placements follow the curve of the Earth.
+     *
+     * A CSV file has a line per instance: modelName,x,y,z[,heading[,scale]]. Empty lines and
+     * lines that begin with '#' are ignored. A binary file is written by writeInstanceFile.
+     * @param worldToLocal transform from ECEF to the local frame
+     * @param modelInstances the instance matrices are appended here, by model name
+     * @return the number of instances read, or -1 if the file couldn't be read
+     */
+    VSGCS_EXPORT int64_t readInstanceFile(const vsg::Path& path, const std::shared_ptr<CRS>& crs,
+                                          const vsg::dmat4& worldToLocal,
+                                          std::map<std::string, std::vector<vsg::dmat4>>& modelInstances);
+
+    /**
+     * @brief Write instances in the binary instance format: the magic "vsgCsINS", a uint32
+     * version and model count, the model names as a uint32 length and characters, a uint64
+     * instance count and then 36 byte records of three doubles, the heading and scale as floats
+     * and a uint32 model index, all little-endian.
+     */
+    VSGCS_EXPORT bool writeInstanceFile(const vsg::Path& path, const std::vector<std::string>& modelNames,
+                                        std::span<const InstanceRecord> records);
+}
@@ -0,0 +1,361 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "InstancedModel.h"
+
+#include <vsg/app/RecordTraversal.h>
+#include <vsg/maths/box.h>
+#include <vsg/maths/transform.h>
+#include <vsg/ui/FrameStamp.h>
+#include <vsg/vk/State.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+using namespace vsgCs;
+
+namespace
+{
+    double maxScale(const vsg::dmat4& m)
+    {
+        double scale2 = 0.0;
+        for (int c = 0; c < 3; ++c)
+        {
+            scale2 = std::max(scale2, vsg::length2(vsg::dvec3(m[c][0], m[c][1], m[c][2])));
+        }
+        return std::sqrt(scale2);
+    }
+
+    // Instances culled together; small enough that the visibility masks stay in L1.
+    constexpr size_t cullBatchSize = 256;
+}
+
+InstancedModel::InstancedModel(const vsg::ref_ptr<const vsg::dmat4Array>& instances,
+                               const vsg::ref_ptr<vsg::Node>& in_model)
+    : model(in_model), _bindings(getInstanceBindings(in_model))
+{
+    if (!_bindings || !instances)
+    {
+        return;
+    }
+    const size_t numInstances = instances->size();
+    _x.resize(numInstances);
+    _y.resize(numInstances);
+    _z.resize(numInstances);
+    _radius.resize(numInstances);
+    const vsg::dsphere& bound = _bindings->modelBound;
+    for (size_t i = 0; i < numInstances; ++i)
+    {
+        const vsg::dmat4& matrix = instances->at(i);
+        const vsg::dvec3 center = matrix * bound.center;
+        _x[i] = static_cast<float>(center.x);
+        _y[i] = static_cast<float>(center.y);
+        _z[i] = static_cast<float>(center.z);
+        // Without a bound the instance is never culled.
+        _radius[i] = bound.valid() ? static_cast<float>(bound.radius * maxScale(matrix))
+            : std::numeric_limits<float>::max();
+    }
+    _recorded.resize(numInstances, 0);
+    // ModelBuilder leaves all the instances in the live arrays of every level.
+    const size_t numLevels = std::max<size_t>(_bindings->minimumScreenHeightRatios.size(), 1);
+    _liveOrder.resize(numLevels, std::vector<uint32_t>(numInstances));
+    for (auto& order : _liveOrder)
+    {
+        std::iota(order.begin(), order.end(), 0u);
+    }
+    _liveModified.resize(numLevels, 0);
+    _numVisible.resize(numLevels, static_cast<uint32_t>(numInstances));
+}
+
+vsg::ref_ptr<InstanceBindings> InstancedModel::getInstanceBindings(const vsg::ref_ptr<vsg::Node>& model)
+{
+    if (!model)
+    {
+        return {};
+    }
+    return vsg::ref_ptr<InstanceBindings>(model->getObject<InstanceBindings>("vsgCs_instanceBindings"));
+}
+
+void InstancedModel::traverse(vsg::Visitor& visitor)
+{
+    if (model)
+    {
+        model->accept(visitor);
+    }
+}
+
+void InstancedModel::traverse(vsg::ConstVisitor& visitor) const
+{
+    if (model)
+    {
+        model->accept(visitor);
+    }
+}
+
+size_t InstancedModel::getNumVisible() const
+{
+    std::scoped_lock lock(_mutex);
+    return std::accumulate(_numVisible.begin(), _numVisible.end(), size_t(0));
+}
+
+void InstancedModel::copyInstance(uint32_t instance, size_t level, uint32_t slot) const
+{
+    if (_liveOrder[level][slot] == instance)
+    {
+        return;
+    }
+    _liveOrder[level][slot] = instance;
+    for (const auto& binding : _bindings->bindings)
+    {
+        const size_t perModel = binding.instancesPerModel;
+        for (size_t j = 0; j < 3; ++j)
+        {
+            std::copy_n(binding.source[j]->data() + instance * perModel, perModel,
+                        binding.levels[level].live[j]->data() + slot * perModel);
+        }
+    }
+    _liveModified[level] = 1;
+}
+
+void InstancedModel::setVisibleCounts() const
+{
+    for (const auto& binding : _bindings->bindings)
+    {
+        for (size_t level = 0; level < binding.levels.size() && level < _numVisible.size(); ++level)
+        {
+            const auto& bindingLevel = binding.levels[level];
+            const uint32_t instanceCount = _numVisible[level] * binding.instancesPerModel;
+            for (const auto& draw : bindingLevel.indexedDraws)
+            {
+                draw->instanceCount = instanceCount;
+            }
+            for (const auto& draw : bindingLevel.draws)
+            {
+                draw->instanceCount = instanceCount;
+            }
+            if (_liveModified[level])
+            {
+                for (const auto& array : bindingLevel.live)
+                {
+                    array->dirty();
+                }
+            }
+        }
+    }
+    std::fill(_liveModified.begin(), _liveModified.end(), 0);
+}
+
+void InstancedModel::setCells(const std::vector<InstanceCell>& cells)
+{
+    _cells.clear();
+    for (const auto& cell : cells)
+    {
+        if (cell.count == 0 || cell.first + cell.count > _radius.size())
+        {
+            continue;
+        }
+        vsg::dbox box;
+        for (uint32_t i = cell.first; i < cell.first + cell.count; ++i)
+        {
+            const vsg::dvec3 center(_x[i], _y[i], _z[i]);
+            box.add(center - vsg::dvec3(_radius[i], _radius[i], _radius[i]));
+            box.add(center + vsg::dvec3(_radius[i], _radius[i], _radius[i]));
+        }
+        _cells.push_back({vsg::dsphere((box.min + box.max) * 0.5, vsg::length(box.max - box.min) * 0.5),
+                          cell.first, cell.count});
+    }
+}
+
+// Choose the level of detail of a visible instance as vsg::LOD does, and copy it to the end of
+// that level's instances.
+void InstancedModel::recordInstance(const vsg::dvec4& lodScale, uint32_t instance) const
+{
+    _recorded[instance] = 1;
+    size_t level = 0;
+    const auto& ratios = _bindings->minimumScreenHeightRatios;
+    if (!ratios.empty())
+    {
+        const double lodDistance = lodScale.x * _x[instance] + lodScale.y * _y[instance]
+            + lodScale.z * _z[instance] + lodScale.w;
+        while (level < ratios.size() && _radius[instance] <= lodDistance * ratios[level])
+        {
+            ++level;
+        }
+        if (level == ratios.size())
+        {
+            // Too small to draw at any level
+            return;
+        }
+    }
+    copyInstance(instance, level, _numVisible[level]++);
+}
+
+void InstancedModel::cullRange(const vsg::State& state, uint32_t first, uint32_t count) const
+{
+    const auto& frustum = state._frustumStack.top();
+    std::array<uint8_t, cullBatchSize> visible{};
+    const uint32_t end = first + count;
+    for (uint32_t batchFirst = first; batchFirst < end; batchFirst += cullBatchSize)
+    {
+        const size_t batchCount = std::min<size_t>(cullBatchSize, end - batchFirst);
+        const float* x = &_x[batchFirst];
+        const float* y = &_y[batchFirst];
+        const float* z = &_z[batchFirst];
+        const float* r = &_radius[batchFirst];
+        std::fill_n(visible.begin(), batchCount, uint8_t(1));
+        for (const auto& plane : frustum.face)
+        {
+            const auto a = static_cast<float>(plane.value[0]);
+            const auto b = static_cast<float>(plane.value[1]);
+            const auto c = static_cast<float>(plane.value[2]);
+            const auto d = static_cast<float>(plane.value[3]);
+            // Branch free, so that the compiler vectorizes it.
+            for (size_t i = 0; i < batchCount; ++i)
+            {
+                visible[i] &= static_cast<uint8_t>(a * x[i] + b * y[i] + c * z[i] + d >= -r[i]);
+            }
+        }
+        for (size_t i = 0; i < batchCount; ++i)
+        {
+            const auto instance = static_cast<uint32_t>(batchFirst + i);
+            if (visible[i] && !_recorded[instance])
+            {
+                recordInstance(frustum.lodScale, instance);
+            }
+        }
+    }
+}
+
+void InstancedModel::traverse(vsg::RecordTraversal& visitor) const
+{
+    if (!model)
+    {
+        return;
+    }
+    if (!_bindings || _radius.empty())
+    {
+        model->accept(visitor);
+        return;
+    }
+    // The draw commands are shared by all the views that record this node, so their instance
+    // count can't change between setting it and recording the model.
+    std::scoped_lock lock(_mutex);
+    const auto* frameStamp = visitor.getFrameStamp();
+    const uint64_t frameCount = frameStamp ? frameStamp->frameCount : 0;
+    if (frameCount != _frameCount)
+    {
+        _frameCount = frameCount;
+        std::fill(_recorded.begin(), _recorded.end(), 0);
+        std::fill(_numVisible.begin(), _numVisible.end(), 0);
+    }
+    // Otherwise another view has already recorded instances this frame; keep them in place.
+    const auto numInstances = static_cast<uint32_t>(_radius.size());
+    const vsg::State& state = *visitor.getState();
+    const auto& frustum = state._frustumStack.top();
+    if (!cullInstances)
+    {
+        for (uint32_t i = 0; i < numInstances; ++i)
+        {
+            if (!_recorded[i])
+            {
+                recordInstance(frustum.lodScale, i);
+            }
+        }
+    }
+    else if (_cells.empty())
+    {
+        cullRange(state, 0, numInstances);
+    }
+    else
+    {
+        const vsg::dmat4 localToEye = state.modelviewMatrixStack.top();
+        for (const auto& cell : _cells)
+        {
+            if (!frustum.intersect(cell.bound))
+            {
+                continue;
+            }
+            uint32_t count = cell.count;
+            if (thinningDistance > 0.0)
+            {
+                const double distance = vsg::length(localToEye * cell.bound.center) - cell.bound.radius;
+                if (distance > thinningDistance)
+                {
+                    const double fraction = (thinningDistance * thinningDistance) / (distance * distance);
+                    count = std::max(1u, static_cast<uint32_t>(std::ceil(count * fraction)));
+                }
+            }
+            cullRange(state, cell.first, count);
+        }
+    }
+    setVisibleCounts();
+    if (std::any_of(_numVisible.begin(), _numVisible.end(), [](uint32_t count) { return count > 0; }))
+    {
+        model->accept(visitor);
+    }
+}
+
+std::vector<InstanceCell> vsgCs::sortInstancesIntoGrid(std::vector<vsg::dmat4>& instances, double cellSize)
+{
+    struct Key
+    {
+        int64_t x;
+        int64_t y;
+        uint64_t order;
+        uint32_t index;
+    };
+    std::vector<Key> keys(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i)
+    {
+        const vsg::dvec4& translation = instances[i][3];
+        // splitmix64 of the index shuffles the instances within a cell.
+        uint64_t order = i + 0x9e3779b97f4a7c15ull;
+        order = (order ^ (order >> 30)) * 0xbf58476d1ce4e5b9ull;
+        order = (order ^ (order >> 27)) * 0x94d049bb133111ebull;
+        order ^= order >> 31;
+        keys[i] = {static_cast<int64_t>(std::floor(translation.x / cellSize)),
+                   static_cast<int64_t>(std::floor(translation.y / cellSize)), order, static_cast<uint32_t>(i)};
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& lhs, const Key& rhs)
+    {
+        return std::tie(lhs.x, lhs.y, lhs.order) < std::tie(rhs.x, rhs.y, rhs.order);
+    });
+    std::vector<vsg::dmat4> sorted(instances.size());
+    std::vector<InstanceCell> cells;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        sorted[i] = instances[keys[i].index];
+        if (i == 0 || keys[i].x != keys[i - 1].x || keys[i].y != keys[i - 1].y)
+        {
+            cells.push_back({static_cast<uint32_t>(i), 0});
+        }
+        ++cells.back().count;
+    }
+    instances.swap(sorted);
+    return cells;
+}
@@ -0,0 +1,168 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+#include "ModelBuilder.h"
+
+#include <vsg/commands/VertexDraw.h>
+#include <vsg/commands/VertexIndexDraw.h>
+#include <vsg/core/Array.h>
+#include <vsg/maths/sphere.h>
+#include <vsg/nodes/Node.h>
+#include <vsg/vk/State.h>
+
+#include <mutex>
+#include <vector>
+
+namespace vsgCs
+{
+    /**
+     * @brief The instance arrays of one glTF node that is drawn once per model instance, as
+     * built by ModelBuilder when CreateModelOptions::instances is set.
+     */
+    struct InstanceBinding
+    {
+        // Matrices of all the instances
+        ModelBuilder::InstanceData source;
+        // Instances of the node per model instance, from EXT_mesh_gpu_instancing
+        uint32_t instancesPerModel = 1;
+        // The draws of one level of detail, and the arrays bound to them. The instances drawn at
+        // that level are copied to the front of the arrays.
+        struct Level
+        {
+            ModelBuilder::InstanceData live;
+            std::vector<vsg::ref_ptr<vsg::VertexIndexDraw>> indexedDraws;
+            std::vector<vsg::ref_ptr<vsg::VertexDraw>> draws;
+        };
+        std::vector<Level> levels;
+    };
+
+    /**
+     * @brief All the instance bindings of a model. ModelBuilder attaches this to the root of the
+     * model as the "vsgCs_instanceBindings" object.
+     */
+    class VSGCS_EXPORT InstanceBindings : public vsg::Inherit<vsg::Object, InstanceBindings>
+    {
+    public:
+        std::vector<InstanceBinding> bindings;
+        // Bound of one instance of the model, in the coordinates of the instance matrices
+        vsg::dsphere modelBound;
+        // The minimum screen height ratio of each level of detail, as in vsg::LOD
+        std::vector<double> minimumScreenHeightRatios;
+    };
+
+    /**
+     * @brief A contiguous range of instances in one cell of a grid.
+     */
+    struct InstanceCell
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    /**
+     * @brief Sort instances into the cells of a grid in the XY plane of their coordinate system.
+     * Within a cell, the instances are shuffled so that any prefix of the cell is spread evenly
+     * over it.
+     * @return the cells that contain instances
+     */
+    VSGCS_EXPORT std::vector<InstanceCell> sortInstancesIntoGrid(std::vector<vsg::dmat4>& instances,
+                                                                 double cellSize);
+
+    /**
+     * @brief A model drawn at many positions with one instanced draw per primitive.
+     *
+     * The record traversal culls the instances against the view frustum in batches and copies
+     * the visible ones to the front of the instance arrays, which are transferred after
+     * recording. When several views record the model in the same frame, the instances visible in
+     * a later view are appended, so the instances drawn by an earlier view are unchanged.
+     *
+     * With cells, whole cells are culled before the instances in them, and distant cells can be
+     * thinned out. If the model has levels of detail, each instance is drawn at the level that
+     * vsg::LOD would choose for it.
+     */
+    class VSGCS_EXPORT InstancedModel : public vsg::Inherit<vsg::Node, InstancedModel>
+    {
+    public:
+        InstancedModel(const vsg::ref_ptr<const vsg::dmat4Array>& instances, const vsg::ref_ptr<vsg::Node>& model);
+
+        void traverse(vsg::Visitor& visitor) override;
+        void traverse(vsg::ConstVisitor& visitor) const override;
+        void traverse(vsg::RecordTraversal& visitor) const override;
+
+        /**
+         * @brief The bindings built for a model, or null if it wasn't built with instances.
+         */
+        static vsg::ref_ptr<InstanceBindings> getInstanceBindings(const vsg::ref_ptr<vsg::Node>& model);
+
+        size_t getNumInstances() const
+        {
+            return _radius.size();
+        }
+        // The number of instances recorded in the last frame
+        size_t getNumVisible() const;
+        /**
+         * @brief Cull cells of instances, as returned by sortInstancesIntoGrid for the
+         * instances of this model.
+         */
+        void setCells(const std::vector<InstanceCell>& cells);
+
+        vsg::ref_ptr<vsg::Node> model;
+        bool cullInstances = true;
+        // Beyond this distance the fraction of a cell's instances that is drawn falls with the
+        // square of the distance, which keeps their density on the screen constant. 0 disables
+        // thinning.
+        double thinningDistance = 0.0;
+    protected:
+        struct Cell
+        {
+            vsg::dsphere bound;
+            uint32_t first;
+            uint32_t count;
+        };
+        void cullRange(const vsg::State& state, uint32_t first, uint32_t count) const;
+        void recordInstance(const vsg::dvec4& lodScale, uint32_t instance) const;
+        void copyInstance(uint32_t instance, size_t level, uint32_t slot) const;
+        void setVisibleCounts() const;
+
+        vsg::ref_ptr<InstanceBindings> _bindings;
+        // Bounding spheres of the instances, as a structure of arrays for batched culling.
+        std::vector<float> _x;
+        std::vector<float> _y;
+        std::vector<float> _z;
+        std::vector<float> _radius;
+        std::vector<Cell> _cells;
+        mutable std::mutex _mutex;
+        mutable uint64_t _frameCount = ~0ull;
+        // Instances recorded by a view in this frame
+        mutable std::vector<uint8_t> _recorded;
+        // Per level of detail: the instance in each slot of the live arrays, whether they have
+        // changed, and the number of instances drawn
+        mutable std::vector<std::vector<uint32_t>> _liveOrder;
+        mutable std::vector<uint8_t> _liveModified;
+        mutable std::vector<uint32_t> _numVisible;
+    };
+}
@@ -7,8 +7,10 @@
 #include "CesiumGltf/MeshPrimitive.h"
 #include "CesiumGltf/Model.h"
 
+#include <atomic>
 #include <cstdint>
 #include <glm/mat4x4.hpp>
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -23,6 +25,8 @@ namespace vsgCs
     {
         vsg::ref_ptr<vsg::Node> modelResult;
         vsg::CompileResult compileResult;
+        // The tileset's count of kept tile geometry bytes, if the tile keeps its triangles
+        std::shared_ptr<std::atomic<int64_t>> geometryBytes;
     };
 
     // Reference to model that is kept in a Cesium Tile as a pointer to void.
@@ -30,6 +34,9 @@ namespace vsgCs
     struct RenderResources
     {
         vsg::ref_ptr<vsg::Node> model;
+        // Added to geometryBytes when the tile is loaded and subtracted when it is freed
+        std::shared_ptr<std::atomic<int64_t>> geometryBytes;
+        int64_t geometrySize = 0;
     };
 
     // Not a great place for this definition, but it is "low level."
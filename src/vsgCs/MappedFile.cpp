@@ -0,0 +1,126 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "MappedFile.h"
+
+#include <vsg/io/Logger.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace vsgCs;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const vsg::Path& path)
+{
+    _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        _file = nullptr;
+        vsg::warn("Can't open ", path);
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+    {
+        return;
+    }
+    _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!_mapping)
+    {
+        vsg::warn("Can't map ", path);
+        return;
+    }
+    _data = static_cast<const std::byte*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (_data)
+    {
+        _size = static_cast<size_t>(size.QuadPart);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file)
+    {
+        CloseHandle(_file);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const vsg::Path& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        vsg::warn("Can't open ", path);
+        return;
+    }
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        const auto size = static_cast<size_t>(fileStat.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            // The glTF parser reads the file from front to back.
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            _data = static_cast<const std::byte*>(mapped);
+            _size = size;
+        }
+        else
+        {
+            vsg::warn("Can't map ", path);
+        }
+    }
+    // The mapping stays valid after the file is closed.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+    {
+        munmap(const_cast<std::byte*>(_data), _size);
+    }
+}
+
+#endif
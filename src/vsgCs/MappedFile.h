@@ -0,0 +1,66 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/io/Path.h>
+
+#include <cstddef>
+#include <span>
+
+namespace vsgCs
+{
+    /**
+     * @brief A read-only memory mapping of a whole file.
+     *
+     * The pages are read from the file, or shared with the operating system's file cache, as they
+     * are touched, so the file isn't copied into the process's memory.
+     */
+    class VSGCS_EXPORT MappedFile
+    {
+    public:
+        explicit MappedFile(const vsg::Path& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        /// @brief false if the file couldn't be opened or mapped, or is empty
+        bool valid() const
+        {
+            return _data != nullptr;
+        }
+        std::span<const std::byte> data() const
+        {
+            return {_data, _size};
+        }
+    private:
+        const std::byte* _data = nullptr;
+        size_t _size = 0;
+#ifdef _WIN32
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+#endif
+    };
+}
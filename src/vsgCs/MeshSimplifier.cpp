@@ -0,0 +1,451 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <queue>
+#include <tuple>
+
+using namespace vsgCs;
+
+namespace
+{
+    struct Point
+    {
+        double x;
+        double y;
+        double z;
+    };
+
+    Point operator-(const Point& lhs, const Point& rhs)
+    {
+        return {lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
+    }
+
+    double dot(const Point& lhs, const Point& rhs)
+    {
+        return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+    }
+
+    Point cross(const Point& lhs, const Point& rhs)
+    {
+        return {lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z, lhs.x * rhs.y - lhs.y * rhs.x};
+    }
+
+    double length(const Point& p)
+    {
+        return std::sqrt(dot(p, p));
+    }
+
+    // Symmetric 4x4 matrix of the sum of squared distances to a set of planes
+    struct Quadric
+    {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+
+        void addPlane(const Point& n, double d, double weight)
+        {
+            a00 += weight * n.x * n.x;
+            a01 += weight * n.x * n.y;
+            a02 += weight * n.x * n.z;
+            a03 += weight * n.x * d;
+            a11 += weight * n.y * n.y;
+            a12 += weight * n.y * n.z;
+            a13 += weight * n.y * d;
+            a22 += weight * n.z * n.z;
+            a23 += weight * n.z * d;
+            a33 += weight * d * d;
+        }
+
+        Quadric& operator+=(const Quadric& rhs)
+        {
+            a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02; a03 += rhs.a03;
+            a11 += rhs.a11; a12 += rhs.a12; a13 += rhs.a13;
+            a22 += rhs.a22; a23 += rhs.a23;
+            a33 += rhs.a33;
+            return *this;
+        }
+
+        double error(const Point& p) const
+        {
+            return a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x
+                + a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y
+                + a22 * p.z * p.z + 2.0 * a23 * p.z
+                + a33;
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        bool operator>(const Collapse& rhs) const
+        {
+            return cost > rhs.cost;
+        }
+    };
+
+    // Border edges are weighted heavily so that the outline of an open mesh stays put.
+    constexpr double borderWeight = 100.0;
+    // A collapse can't turn a triangle's normal by more than about 78 degrees.
+    constexpr double minNormalCosine = 0.2;
+
+    class Simplifier
+    {
+    public:
+        Simplifier(std::span<const vsg::vec3> positions, std::span<const vsg::vec3> normals,
+                   std::span<const uint32_t> indices)
+            : _points(positions.size()), _normals(normals.size() == positions.size() ? normals.size() : 0),
+              _triangles(indices.begin(), indices.begin() + indices.size() / 3 * 3),
+              _removedTriangle(indices.size() / 3, 0),
+              _vertexTriangles(positions.size()), _quadrics(positions.size()),
+              _locked(positions.size(), 0), _border(positions.size(), 0),
+              _removedVertex(positions.size(), 0), _version(positions.size(), 0),
+              _numTriangles(indices.size() / 3)
+        {
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                _points[i] = {positions[i].x, positions[i].y, positions[i].z};
+            }
+            for (size_t i = 0; i < _normals.size(); ++i)
+            {
+                _normals[i] = {normals[i].x, normals[i].y, normals[i].z};
+            }
+        }
+
+        bool valid() const
+        {
+            return std::all_of(_triangles.begin(), _triangles.end(),
+                               [this](uint32_t index)
+                               {
+                                   return index < _points.size();
+                               });
+        }
+
+        void lockSeams()
+        {
+            std::vector<uint32_t> order(_points.size());
+            std::iota(order.begin(), order.end(), 0u);
+            auto less = [this](uint32_t lhs, uint32_t rhs)
+            {
+                const Point& l = _points[lhs];
+                const Point& r = _points[rhs];
+                return std::tie(l.x, l.y, l.z) < std::tie(r.x, r.y, r.z);
+            };
+            std::sort(order.begin(), order.end(), less);
+            for (size_t i = 1; i < order.size(); ++i)
+            {
+                if (!less(order[i - 1], order[i]))
+                {
+                    _locked[order[i - 1]] = 1;
+                    _locked[order[i]] = 1;
+                }
+            }
+        }
+
+        void computeQuadrics()
+        {
+            for (uint32_t t = 0; t < _removedTriangle.size(); ++t)
+            {
+                const uint32_t* tri = &_triangles[t * 3];
+                for (int i = 0; i < 3; ++i)
+                {
+                    _vertexTriangles[tri[i]].push_back(t);
+                }
+                Point n = cross(_points[tri[1]] - _points[tri[0]], _points[tri[2]] - _points[tri[0]]);
+                const double area2 = length(n);
+                if (area2 <= 0.0)
+                {
+                    continue;
+                }
+                n = {n.x / area2, n.y / area2, n.z / area2};
+                const double d = -dot(n, _points[tri[0]]);
+                for (int i = 0; i < 3; ++i)
+                {
+                    _quadrics[tri[i]].addPlane(n, d, area2 * 0.5);
+                }
+            }
+            // Border edges belong to one triangle.
+            for (uint32_t t = 0; t < _removedTriangle.size(); ++t)
+            {
+                const uint32_t* tri = &_triangles[t * 3];
+                const Point faceNormal = cross(_points[tri[1]] - _points[tri[0]], _points[tri[2]] - _points[tri[0]]);
+                for (int i = 0; i < 3; ++i)
+                {
+                    const uint32_t a = tri[i];
+                    const uint32_t b = tri[(i + 1) % 3];
+                    if (countShared(a, b) != 1)
+                    {
+                        continue;
+                    }
+                    _border[a] = _border[b] = 1;
+                    const Point edge = _points[b] - _points[a];
+                    Point n = cross(edge, faceNormal);
+                    const double nLength = length(n);
+                    if (nLength <= 0.0)
+                    {
+                        continue;
+                    }
+                    n = {n.x / nLength, n.y / nLength, n.z / nLength};
+                    const double weight = borderWeight * dot(edge, edge);
+                    _quadrics[a].addPlane(n, -dot(n, _points[a]), weight);
+                    _quadrics[b].addPlane(n, -dot(n, _points[a]), weight);
+                }
+            }
+        }
+
+        std::vector<uint32_t> simplify(size_t targetTriangles)
+        {
+            for (uint32_t t = 0; t < _removedTriangle.size(); ++t)
+            {
+                const uint32_t* tri = &_triangles[t * 3];
+                for (int i = 0; i < 3; ++i)
+                {
+                    pushCollapse(tri[i], tri[(i + 1) % 3]);
+                    pushCollapse(tri[(i + 1) % 3], tri[i]);
+                }
+            }
+            while (_numTriangles > targetTriangles && !_queue.empty())
+            {
+                const Collapse collapse = _queue.top();
+                _queue.pop();
+                if (_removedVertex[collapse.from] || _removedVertex[collapse.to]
+                    || _version[collapse.from] != collapse.fromVersion
+                    || _version[collapse.to] != collapse.toVersion
+                    || !canCollapse(collapse.from, collapse.to))
+                {
+                    continue;
+                }
+                doCollapse(collapse.from, collapse.to);
+            }
+            std::vector<uint32_t> result;
+            result.reserve(_numTriangles * 3);
+            for (uint32_t t = 0; t < _removedTriangle.size(); ++t)
+            {
+                if (!_removedTriangle[t])
+                {
+                    result.insert(result.end(), &_triangles[t * 3], &_triangles[t * 3] + 3);
+                }
+            }
+            return result;
+        }
+
+    protected:
+        bool contains(uint32_t t, uint32_t v) const
+        {
+            const uint32_t* tri = &_triangles[t * 3];
+            return tri[0] == v || tri[1] == v || tri[2] == v;
+        }
+
+        // Number of live triangles that contain the edge
+        int countShared(uint32_t u, uint32_t v) const
+        {
+            int count = 0;
+            for (uint32_t t : _vertexTriangles[u])
+            {
+                if (!_removedTriangle[t] && contains(t, v))
+                {
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+        void neighbors(uint32_t u, std::vector<uint32_t>& result) const
+        {
+            result.clear();
+            for (uint32_t t : _vertexTriangles[u])
+            {
+                if (_removedTriangle[t])
+                {
+                    continue;
+                }
+                for (int i = 0; i < 3; ++i)
+                {
+                    const uint32_t w = _triangles[t * 3 + i];
+                    if (w != u)
+                    {
+                        result.push_back(w);
+                    }
+                }
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+        }
+
+        void pushCollapse(uint32_t from, uint32_t to)
+        {
+            if (_locked[from] || from == to)
+            {
+                return;
+            }
+            Quadric q = _quadrics[from];
+            q += _quadrics[to];
+            double cost = q.error(_points[to]);
+            if (!_normals.empty())
+            {
+                const Point edge = _points[to] - _points[from];
+                const double length2 = dot(edge, edge);
+                cost += (1.0 - dot(_normals[from], _normals[to])) * length2 * length2;
+            }
+            _queue.push({cost, from, to, _version[from], _version[to]});
+        }
+
+        bool canCollapse(uint32_t u, uint32_t v)
+        {
+            const int shared = countShared(u, v);
+            if (_border[u])
+            {
+                // Only slide along the border.
+                if (shared != 1 || !_border[v])
+                {
+                    return false;
+                }
+            }
+            else if (shared != 2)
+            {
+                return false;
+            }
+            // The link condition: the only common neighbors are the apexes of the shared
+            // triangles, otherwise the collapse makes the mesh non-manifold.
+            neighbors(u, _scratchU);
+            neighbors(v, _scratchV);
+            std::vector<uint32_t> common;
+            std::set_intersection(_scratchU.begin(), _scratchU.end(), _scratchV.begin(), _scratchV.end(),
+                                  std::back_inserter(common));
+            if (common.size() != static_cast<size_t>(shared))
+            {
+                return false;
+            }
+            // The triangles that move must not flip or degenerate.
+            for (uint32_t t : _vertexTriangles[u])
+            {
+                if (_removedTriangle[t] || contains(t, v))
+                {
+                    continue;
+                }
+                Point p[3];
+                Point moved[3];
+                for (int i = 0; i < 3; ++i)
+                {
+                    const uint32_t w = _triangles[t * 3 + i];
+                    p[i] = _points[w];
+                    moved[i] = w == u ? _points[v] : p[i];
+                }
+                const Point before = cross(p[1] - p[0], p[2] - p[0]);
+                const Point after = cross(moved[1] - moved[0], moved[2] - moved[0]);
+                const double afterLength = length(after);
+                if (afterLength <= 0.0 || dot(before, after) < minNormalCosine * length(before) * afterLength)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void doCollapse(uint32_t u, uint32_t v)
+        {
+            for (uint32_t t : _vertexTriangles[u])
+            {
+                if (_removedTriangle[t])
+                {
+                    continue;
+                }
+                if (contains(t, v))
+                {
+                    _removedTriangle[t] = 1;
+                    --_numTriangles;
+                    continue;
+                }
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (_triangles[t * 3 + i] == u)
+                    {
+                        _triangles[t * 3 + i] = v;
+                    }
+                }
+                _vertexTriangles[v].push_back(t);
+            }
+            _vertexTriangles[u].clear();
+            auto& vTriangles = _vertexTriangles[v];
+            vTriangles.erase(std::remove_if(vTriangles.begin(), vTriangles.end(),
+                                            [this](uint32_t t)
+                                            {
+                                                return _removedTriangle[t] != 0;
+                                            }),
+                             vTriangles.end());
+            _quadrics[v] += _quadrics[u];
+            _removedVertex[u] = 1;
+            ++_version[u];
+            ++_version[v];
+            neighbors(v, _scratchV);
+            for (uint32_t w : _scratchV)
+            {
+                pushCollapse(v, w);
+                pushCollapse(w, v);
+            }
+        }
+
+        std::vector<Point> _points;
+        std::vector<Point> _normals;
+        std::vector<uint32_t> _triangles;
+        std::vector<uint8_t> _removedTriangle;
+        std::vector<std::vector<uint32_t>> _vertexTriangles;
+        std::vector<Quadric> _quadrics;
+        std::vector<uint8_t> _locked;
+        std::vector<uint8_t> _border;
+        std::vector<uint8_t> _removedVertex;
+        std::vector<uint32_t> _version;
+        size_t _numTriangles;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> _queue;
+        std::vector<uint32_t> _scratchU;
+        std::vector<uint32_t> _scratchV;
+    };
+}
+
+std::vector<uint32_t> vsgCs::simplifyTriangles(std::span<const vsg::vec3> positions,
+                                               std::span<const vsg::vec3> normals,
+                                               std::span<const uint32_t> indices,
+                                               size_t targetTriangles)
+{
+    Simplifier simplifier(positions, normals, indices);
+    if (indices.size() / 3 <= targetTriangles || !simplifier.valid())
+    {
+        return {indices.begin(), indices.begin() + indices.size() / 3 * 3};
+    }
+    simplifier.lockSeams();
+    simplifier.computeQuadrics();
+    return simplifier.simplify(targetTriangles);
+}
@@ -0,0 +1,84 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+#include <vsg/maths/vec3.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace vsgCs
+{
+    /**
+     * @brief Reduce a triangle list to about targetTriangles triangles by quadric error edge
+     * collapse (Garland and Heckbert, 1997).
+     *
+     * Vertices collapse onto one of their neighbors, so the vertex arrays are unchanged and only
+     * the indices are rewritten. Vertices that share their position with another vertex, i.e. that
+     * lie on a texture or normal seam, are never removed, so seams don't crack; open borders are
+     * kept in place by extra quadrics, and collapses across creases in the normals are penalized.
+     * @param normals vertex normals, the same size as positions, or empty
+     * @return the indices of the simplified triangles
+     */
+    VSGCS_EXPORT std::vector<uint32_t> simplifyTriangles(std::span<const vsg::vec3> positions,
+                                                         std::span<const vsg::vec3> normals,
+                                                         std::span<const uint32_t> indices,
+                                                         size_t targetTriangles);
+
+    /**
+     * @brief One level of detail of a model: the fraction of the triangles to keep, and the
+     * minimum screen height ratio at which it is drawn, as in vsg::LOD.
+     */
+    struct LodLevel
+    {
+        double triangleRatio = 1.0;
+        double minimumScreenHeightRatio = 0.0;
+    };
+
+    /**
+     * @brief Levels of detail to build for a model, from the most detailed. GltfLoader reads these
+     * from the "vsgCs_lods" object of its options.
+     */
+    class VSGCS_EXPORT LodSettings : public vsg::Inherit<vsg::Object, LodSettings>
+    {
+    public:
+        std::vector<LodLevel> levels;
+    };
+
+    /**
+     * @brief The number of triangles in each level of detail of a model. ModelBuilder attaches
+     * this to the root of a model as the "vsgCs_lodStatistics" object.
+     */
+    class VSGCS_EXPORT LodStatistics : public vsg::Inherit<vsg::Object, LodStatistics>
+    {
+    public:
+        std::vector<uint64_t> triangles;
+    };
+}
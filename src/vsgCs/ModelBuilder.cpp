@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include "accessor_traits.h"
 #include "accessorUtils.h"
+#include "InstancedModel.h"
 #include "LoadGltfResult.h"
 #include "pbr.h"
 #include "Styling.h"
@@ -36,9 +37,13 @@ SOFTWARE.
 #include <CesiumGltf/ExtensionTextureWebp.h>
 
 #include <vsg/maths/transform.h>
+#include <vsg/nodes/LOD.h>
+#include <vsg/nodes/Switch.h>
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
+#include <limits>
 
 using namespace vsgCs;
 using namespace CesiumGltf;
@@ -178,10 +183,127 @@ namespace
     {
         return index >= 0 && static_cast<uint32_t>(index) < items.size();
     }
+
+    vsg::dmat4 getNodeMatrix(const CesiumGltf::Node* node)
+    {
+        const std::vector<double>& matrix = node->matrix;
+        vsg::dmat4 transformMatrix;
+        if (matrix.size() == 16 && !isGltfIdentity(matrix))
+        {
+            std::copy(matrix.begin(), matrix.end(), transformMatrix.data());
+        }
+        else
+        {
+            vsg::dmat4 translation;
+            if (node->translation.size() == 3)
+            {
+                translation = vsg::translate(node->translation[0], node->translation[1], node->translation[2]);
+            }
+            vsg::dquat rotation(0.0, 0.0, 0.0, 1.0);
+            if (node->rotation.size() == 4)
+            {
+                rotation.x = node->rotation[0];
+                rotation.y = node->rotation[1];
+                rotation.z = node->rotation[2];
+                rotation.w = node->rotation[3];
+            }
+            vsg::dmat4 scale;
+            if (node->scale.size() == 3)
+            {
+                scale = vsg::scale(node->scale[0], node->scale[1], node->scale[2]);
+            }
+            transformMatrix = translation * rotate(rotation) * scale;
+        }
+        return transformMatrix;
+    }
+
+    // A smaller version of an image, for a quick first look at a model: the first mip level that
+    // fits in maxSize, or an uncompressed 8-bit image averaged down by powers of two. Other images
+    // are returned as they are.
+    CesiumUtility::IntrusivePointer<ImageAsset>
+    reduceImage(const CesiumUtility::IntrusivePointer<ImageAsset>& image, uint32_t maxSize)
+    {
+        const auto maxDim = static_cast<int32_t>(maxSize);
+        if (!image || (image->width <= maxDim && image->height <= maxDim))
+        {
+            return image;
+        }
+        CesiumUtility::IntrusivePointer<ImageAsset> reduced(new ImageAsset());
+        reduced->channels = image->channels;
+        reduced->bytesPerChannel = image->bytesPerChannel;
+        reduced->compressedPixelFormat = image->compressedPixelFormat;
+        if (image->mipPositions.size() > 1)
+        {
+            size_t level = 0;
+            int32_t width = image->width;
+            int32_t height = image->height;
+            while (level + 1 < image->mipPositions.size() && (width > maxDim || height > maxDim))
+            {
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+                ++level;
+            }
+            reduced->width = width;
+            reduced->height = height;
+            const size_t base = image->mipPositions[level].byteOffset;
+            for (size_t i = level; i < image->mipPositions.size(); ++i)
+            {
+                reduced->mipPositions.push_back({image->mipPositions[i].byteOffset - base,
+                                                 image->mipPositions[i].byteSize});
+            }
+            const auto& last = image->mipPositions.back();
+            reduced->pixelData.assign(image->pixelData.begin() + static_cast<std::ptrdiff_t>(base),
+                                      image->pixelData.begin() + static_cast<std::ptrdiff_t>(last.byteOffset + last.byteSize));
+            return reduced;
+        }
+        if (image->compressedPixelFormat != GpuCompressedPixelFormat::NONE || image->bytesPerChannel != 1
+            || !image->mipPositions.empty())
+        {
+            return image;
+        }
+        const int32_t channels = image->channels;
+        std::vector<std::byte> pixels = image->pixelData;
+        int32_t width = image->width;
+        int32_t height = image->height;
+        while (width > maxDim || height > maxDim)
+        {
+            const int32_t newWidth = std::max(width / 2, 1);
+            const int32_t newHeight = std::max(height / 2, 1);
+            std::vector<std::byte> newPixels(static_cast<size_t>(newWidth) * newHeight * channels);
+            for (int32_t y = 0; y < newHeight; ++y)
+            {
+                const int32_t y0 = std::min(y * 2, height - 1);
+                const int32_t y1 = std::min(y * 2 + 1, height - 1);
+                for (int32_t x = 0; x < newWidth; ++x)
+                {
+                    const int32_t x0 = std::min(x * 2, width - 1);
+                    const int32_t x1 = std::min(x * 2 + 1, width - 1);
+                    for (int32_t c = 0; c < channels; ++c)
+                    {
+                        auto texel = [&](int32_t tx, int32_t ty)
+                        {
+                            return std::to_integer<uint32_t>(pixels[(static_cast<size_t>(ty) * width + tx) * channels + c]);
+                        };
+                        const uint32_t sum = texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1);
+                        newPixels[(static_cast<size_t>(y) * newWidth + x) * channels + c]
+                            = static_cast<std::byte>((sum + 2) / 4);
+                    }
+                }
+            }
+            pixels = std::move(newPixels);
+            width = newWidth;
+            height = newHeight;
+        }
+        reduced->width = width;
+        reduced->height = height;
+        reduced->pixelData = std::move(pixels);
+        return reduced;
+    }
 }
 
 CreateModelOptions::CreateModelOptions(bool in_renderOverlays, const vsg::ref_ptr<Styling>& in_styling)
-    : renderOverlays(in_renderOverlays), lodFade(true), styling(in_styling)
+    : renderOverlays(in_renderOverlays), lodFade(true), optimizeGraph(false), depthPrepass(false), keepGeometry(false), buildBVH(false),
+      maxTextureSize(0), styling(in_styling)
 {
 }
 
@@ -210,6 +332,22 @@ ModelBuilder::ModelBuilder(const vsg::ref_ptr<GraphicsEnvironment>& genv, Cesium
     {
         _stylist = options.styling->getStylist(this);
     }
+    if (options.instances && !options.instances->empty())
+    {
+        _instanceBindings = InstanceBindings::create();
+        if (options.lods.size() > 1)
+        {
+            for (const auto& lod : options.lods)
+            {
+                _instanceBindings->minimumScreenHeightRatios.push_back(lod.minimumScreenHeightRatio);
+            }
+        }
+    }
+    if (options.lods.size() > 1)
+    {
+        _lodStatistics = LodStatistics::create();
+        _lodStatistics->triangles.resize(options.lods.size(), 0);
+    }
 }
 
 // The default constructor is defined in order to avoid circular dependencies in the header file
@@ -220,36 +358,11 @@ ModelBuilder::~ModelBuilder()   // NOLINT
 vsg::ref_ptr<vsg::Group>
 ModelBuilder::loadNode(const CesiumGltf::Node* node)
 {
-    const std::vector<double>& matrix = node->matrix;
     vsg::ref_ptr<vsg::Group> result;
-    vsg::dmat4 transformMatrix;
-    if (matrix.size() == 16 && !isGltfIdentity(matrix))
-    {
-        std::copy(matrix.begin(), matrix.end(), transformMatrix.data());
-    }
-    else
-    {
-        vsg::dmat4 translation;
-        if (node->translation.size() == 3)
-        {
-            translation = vsg::translate(node->translation[0], node->translation[1], node->translation[2]);
-        }
-        vsg::dquat rotation(0.0, 0.0, 0.0, 1.0);
-        if (node->rotation.size() == 4)
-        {
-            rotation.x = node->rotation[0];
-            rotation.y = node->rotation[1];
-            rotation.z = node->rotation[2];
-            rotation.w = node->rotation[3];
-        }
-        vsg::dmat4 scale;
-        if (node->scale.size() == 3)
-        {
-            scale = vsg::scale(node->scale[0], node->scale[1], node->scale[2]);
-        }
-        transformMatrix = translation * rotate(rotation) * scale;
-    }
+    const vsg::dmat4 transformMatrix = getNodeMatrix(node);
     result = vsg::MatrixTransform::create(transformMatrix);
+    const vsg::dmat4 parentTransform = _nodeTransform;
+    _nodeTransform = parentTransform * transformMatrix;
 
     if (safeIndex(_model->meshes, node->mesh))
     {
@@ -258,11 +371,11 @@ ModelBuilder::loadNode(const CesiumGltf::Node* node)
             node->getExtension<ExtensionExtMeshGpuInstancing>())
         {
             instanceData = makeInstanceData(*_model, pGpuInstancingExtension);
-            result->addChild(loadMesh(&_model->meshes[node->mesh], &instanceData));
+            result->addChild(loadNodeMesh(&_model->meshes[node->mesh], &instanceData));
         }
         else
         {
-            result->addChild(loadMesh(&_model->meshes[node->mesh]));
+            result->addChild(loadNodeMesh(&_model->meshes[node->mesh], nullptr));
         }
     }
     for (int childNodeId : node->children)
@@ -272,9 +385,144 @@ ModelBuilder::loadNode(const CesiumGltf::Node* node)
             result->addChild(loadNode(&_model->nodes[childNodeId]));
         }
     }
+    _nodeTransform = parentTransform;
+    return result;
+}
+
+std::vector<ModelBuilder::MeshNode> ModelBuilder::getMeshNodes(const CesiumGltf::Model& model)
+{
+    std::vector<MeshNode> result;
+    std::function<void(int32_t, const vsg::dmat4&)> addNode = [&](int32_t nodeId, const vsg::dmat4& parentTransform)
+    {
+        if (!safeIndex(model.nodes, nodeId))
+        {
+            return;
+        }
+        const CesiumGltf::Node& node = model.nodes[nodeId];
+        const vsg::dmat4 transform = parentTransform * getNodeMatrix(&node);
+        if (safeIndex(model.meshes, node.mesh))
+        {
+            result.push_back({&node, node.mesh, transform});
+        }
+        for (int32_t childId : node.children)
+        {
+            addNode(childId, transform);
+        }
+    };
+    // The same choice of root nodes as operator()
+    if (!model.scenes.empty())
+    {
+        const int32_t scene = safeIndex(model.scenes, model.scene) ? model.scene : 0;
+        for (int32_t nodeId : model.scenes[scene].nodes)
+        {
+            addNode(nodeId, vsg::dmat4());
+        }
+    }
+    else if (!model.nodes.empty())
+    {
+        addNode(0, vsg::dmat4());
+    }
+    else
+    {
+        for (size_t i = 0; i < model.meshes.size(); ++i)
+        {
+            result.push_back({nullptr, static_cast<int32_t>(i), vsg::dmat4()});
+        }
+    }
+    return result;
+}
+
+vsg::ref_ptr<vsg::Node> ModelBuilder::loadMeshNode(const MeshNode& meshNode)
+{
+    auto result = vsg::MatrixTransform::create(meshNode.transform);
+    _nodeTransform = meshNode.transform;
+    const CesiumGltf::Mesh* mesh = &_model->meshes[meshNode.mesh];
+    const auto* pGpuInstancingExtension
+        = meshNode.node ? meshNode.node->getExtension<ExtensionExtMeshGpuInstancing>() : nullptr;
+    if (pGpuInstancingExtension)
+    {
+        InstanceData instanceData = makeInstanceData(*_model, pGpuInstancingExtension);
+        result->addChild(loadNodeMesh(mesh, &instanceData));
+    }
+    else
+    {
+        result->addChild(loadNodeMesh(mesh, nullptr));
+    }
+    _nodeTransform = vsg::dmat4();
     return result;
 }
 
+vsg::ref_ptr<vsg::Group>
+ModelBuilder::loadNodeMesh(const CesiumGltf::Mesh* mesh, const InstanceData* nodeInstances)
+{
+    if (!_instanceBindings)
+    {
+        return loadMesh(mesh, nodeInstances);
+    }
+    InstanceData instanceData = bindModelInstances(nodeInstances);
+    _nodeInstances = nodeInstances;
+    auto result = loadMesh(mesh, &instanceData);
+    _nodeInstances = nullptr;
+    return result;
+}
+
+// The instance matrices are applied before the transforms of the glTF nodes, so the model
+// instances must be expressed in the node's coordinate system. They are combined with any
+// EXT_mesh_gpu_instancing instances of the node.
+ModelBuilder::InstanceData ModelBuilder::bindModelInstances(const InstanceData* nodeInstances)
+{
+    const vsg::dmat4Array& instances = *_options.instances;
+    const vsg::dmat4 toNode = vsg::inverse(_nodeTransform);
+    const bool hasNodeInstances = nodeInstances && (*nodeInstances)[0];
+    const size_t perModel = hasNodeInstances ? (*nodeInstances)[0]->size() : 1;
+    const size_t count = instances.size() * perModel;
+    InstanceBinding binding;
+    binding.instancesPerModel = static_cast<uint32_t>(perModel);
+    for (auto& array : binding.source)
+    {
+        array = vsg::vec4Array::create(count);
+    }
+    for (size_t k = 0; k < instances.size(); ++k)
+    {
+        const vsg::dmat4 instance = toNode * instances.at(k) * _nodeTransform;
+        for (size_t i = 0; i < perModel; ++i)
+        {
+            vsg::dmat4 m = instance;
+            if (hasNodeInstances)
+            {
+                vsg::dmat4 nodeInstance;
+                for (int r = 0; r < 3; ++r)
+                {
+                    const vsg::vec4& row = (*nodeInstances)[r]->at(i);
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        nodeInstance(c, r) = row[c];
+                    }
+                }
+                m = instance * nodeInstance;
+            }
+            for (int j = 0; j < 3; ++j)
+            {
+                binding.source[j]->at(k * perModel + i) = vsg::vec4(vsg::dvec4(m(0, j), m(1, j), m(2, j), m(3, j)));
+            }
+        }
+    }
+    // Each level of detail draws its instances from its own arrays.
+    binding.levels.resize(std::max<size_t>(_options.lods.size(), 1));
+    for (auto& level : binding.levels)
+    {
+        for (size_t j = 0; j < 3; ++j)
+        {
+            level.live[j] = vsg::vec4Array::create(count);
+            std::copy_n(binding.source[j]->data(), count, level.live[j]->data());
+            // InstancedModel copies the visible instances to the front while recording.
+            level.live[j]->properties.dataVariance = vsg::DYNAMIC_DATA_TRANSFER_AFTER_RECORD;
+        }
+    }
+    _instanceBindings->bindings.push_back(binding);
+    return binding.levels[0].live;
+}
+
 vsg::ref_ptr<vsg::Group>
 ModelBuilder::loadMesh(const CesiumGltf::Mesh* mesh, const InstanceData* instanceData)
 {
@@ -556,11 +804,12 @@ std::string ModelBuilder::makeName(const CesiumGltf::Mesh *mesh,
 
 namespace
 {
-    vsg::ref_ptr<vsg::vec4Array> expandArray(const Model *model,
-                                             const vsg::ref_ptr<vsg::Data>& srcData,
-                                             const Accessor* indexAccessor)
+    template <typename TArray>
+    vsg::ref_ptr<TArray> expandArray(const Model *model,
+                                     const vsg::ref_ptr<vsg::Data>& srcData,
+                                     const Accessor* indexAccessor)
     {
-        auto src = ref_ptr_cast<vsg::vec4Array>(srcData);
+        auto src = ref_ptr_cast<TArray>(srcData);
         if (!indexAccessor || !src)
         {
             return src;
@@ -572,14 +821,15 @@ namespace
              {
                  if constexpr(is_index_view<decltype(indexView)>::value)
                  {
-                     auto result = vsg::vec4Array::create(indexView.size());
+                     auto result = TArray::create(indexView.size());
                      for (int i = 0; i < indexView.size(); ++i)
                      {
                          (*result)[i] = (*src)[indexView[i].value[0]];
                      }
+                     result->properties.format = src->properties.format;
                      return result;
                  }
-                 return vsg::vec4Array::create();
+                 return TArray::create();
              });
     }
 }
@@ -625,6 +875,54 @@ namespace
             cbs.configureAttachments(blending);
         }
     };
+
+    // Make a variant of a primitive's pipeline for the depth pre-pass. The depth-only pipeline has
+    // no fragment shader and doesn't write color; the other variant tests for equal depth and
+    // doesn't write depth. The vertex input state is untouched, so the variants can share the
+    // primitive's draw command.
+    vsg::ref_ptr<vsg::BindGraphicsPipeline>
+    makeDepthPassPipeline(const vsg::ref_ptr<vsg::GraphicsPipelineConfigurator>& pipelineConf, bool depthOnly)
+    {
+        const auto& original = pipelineConf->graphicsPipeline;
+        vsg::GraphicsPipelineStates states;
+        for (const auto& state : original->pipelineStates)
+        {
+            if (auto depthState = state.cast<vsg::DepthStencilState>())
+            {
+                auto newState = vsg::DepthStencilState::create(*depthState);
+                if (!depthOnly)
+                {
+                    newState->depthWriteEnable = VK_FALSE;
+                    newState->depthCompareOp = VK_COMPARE_OP_EQUAL;
+                }
+                states.push_back(newState);
+            }
+            else if (auto blendState = state.cast<vsg::ColorBlendState>(); blendState && depthOnly)
+            {
+                auto newState = vsg::ColorBlendState::create(*blendState);
+                for (auto& attachment : newState->attachments)
+                {
+                    attachment.blendEnable = VK_FALSE;
+                    attachment.colorWriteMask = 0;
+                }
+                states.push_back(newState);
+            }
+            else
+            {
+                states.push_back(state);
+            }
+        }
+        vsg::ShaderStages stages;
+        for (const auto& stage : original->stages)
+        {
+            if (!depthOnly || stage->stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+            {
+                stages.push_back(stage);
+            }
+        }
+        auto pipeline = vsg::GraphicsPipeline::create(original->layout, stages, states, original->subpass);
+        return vsg::BindGraphicsPipeline::create(pipeline);
+    }
 }
 
 // Helpers for different instancing rotation formats
@@ -818,6 +1116,86 @@ namespace
     }
 }
 
+namespace
+{
+    uint64_t triangleCount(VkPrimitiveTopology topology, uint32_t count)
+    {
+        switch (topology)
+        {
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+            return count / 3;
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+            return count > 2 ? count - 2 : 0;
+        default:
+            return 0;
+        }
+    }
+
+    // The indices of each level of detail of a triangle list. A level is simplified from the one
+    // before it; if that doesn't remove any triangles, the level shares the indices of the previous
+    // one.
+    std::vector<vsg::ref_ptr<vsg::Data>> simplifyLevels(const vsg::ref_ptr<vsg::Data>& positions,
+                                                        const vsg::ref_ptr<vsg::vec3Array>& normals,
+                                                        const vsg::ref_ptr<vsg::Data>& indices,
+                                                        const std::vector<LodLevel>& lods)
+    {
+        std::vector<vsg::ref_ptr<vsg::Data>> result(lods.size(), indices);
+        auto posArray = ref_ptr_cast<vsg::vec3Array>(positions);
+        std::vector<uint32_t> levelIndices;
+        if (auto ushortIndices = ref_ptr_cast<vsg::ushortArray>(indices))
+        {
+            levelIndices.assign(ushortIndices->begin(), ushortIndices->end());
+        }
+        else if (auto uintIndices = ref_ptr_cast<vsg::uintArray>(indices))
+        {
+            levelIndices.assign(uintIndices->begin(), uintIndices->end());
+        }
+        if (!posArray || levelIndices.empty())
+        {
+            return result;
+        }
+        // The arrays may be strided views of the glTF buffers.
+        const std::vector<vsg::vec3> vertices(posArray->begin(), posArray->end());
+        std::vector<vsg::vec3> vertexNormals;
+        if (normals && normals->size() == vertices.size())
+        {
+            vertexNormals.assign(normals->begin(), normals->end());
+        }
+        const size_t numTriangles = levelIndices.size() / 3;
+        for (size_t level = 1; level < lods.size(); ++level)
+        {
+            const auto target = static_cast<size_t>(std::max(lods[level].triangleRatio, 0.0) * numTriangles);
+            if (target >= levelIndices.size() / 3)
+            {
+                result[level] = result[level - 1];
+                continue;
+            }
+            auto simplified = simplifyTriangles(vertices, vertexNormals, levelIndices, target);
+            if (simplified.size() >= levelIndices.size())
+            {
+                result[level] = result[level - 1];
+                continue;
+            }
+            levelIndices = std::move(simplified);
+            if (vertices.size() <= std::numeric_limits<uint16_t>::max() + size_t(1))
+            {
+                auto ushortIndices = vsg::ushortArray::create(static_cast<uint32_t>(levelIndices.size()));
+                std::transform(levelIndices.begin(), levelIndices.end(), ushortIndices->begin(),
+                               [](uint32_t index) { return static_cast<uint16_t>(index); });
+                result[level] = ushortIndices;
+            }
+            else
+            {
+                auto uintIndices = vsg::uintArray::create(static_cast<uint32_t>(levelIndices.size()));
+                std::copy(levelIndices.begin(), levelIndices.end(), uintIndices->begin());
+                result[level] = uintIndices;
+            }
+        }
+        return result;
+    }
+}
+
 vsg::ref_ptr<vsg::Node>
 ModelBuilder::loadPrimitive(const CesiumGltf::MeshPrimitive* primitive,
                             const CesiumGltf::Mesh* mesh,
@@ -868,10 +1246,12 @@ ModelBuilder::loadPrimitive(const CesiumGltf::MeshPrimitive* primitive,
     vsg::DataList vertexArrays;
     auto positions = createData(_model, pPositionAccessor, expansionIndices);
     pipelineConf->assignArray(vertexArrays, "vsg_Vertex", VK_VERTEX_INPUT_RATE_VERTEX, positions);
+    // Kept for simplifying the mesh
+    vsg::ref_ptr<vsg::vec3Array> normalArray;
     if (normalAccessor)
     {
-        pipelineConf->assignArray(vertexArrays, "vsg_Normal", VK_VERTEX_INPUT_RATE_VERTEX,
-                            ref_ptr_cast<vsg::vec3Array>(createData(_model, normalAccessor, expansionIndices)));
+        normalArray = ref_ptr_cast<vsg::vec3Array>(createData(_model, normalAccessor, expansionIndices));
+        pipelineConf->assignArray(vertexArrays, "vsg_Normal", VK_VERTEX_INPUT_RATE_VERTEX, normalArray);
     }
     else if (!isTriangleTopology(topology)) // Can not make normals
     {
@@ -887,6 +1267,7 @@ ModelBuilder::loadPrimitive(const CesiumGltf::MeshPrimitive* primitive,
         auto posArray = ref_ptr_cast<vsg::vec3Array>(positions);
         auto normals = vsg::vec3Array::create(posArray->size());
         generateNormals(posArray, normals, topology);
+        normalArray = normals;
         pipelineConf->shaderHints->defines.insert("VSGCS_FLAT_SHADING");
         pipelineConf->assignArray(vertexArrays, "vsg_Normal", VK_VERTEX_INPUT_RATE_VERTEX, normals);
     }
@@ -902,12 +1283,32 @@ ModelBuilder::loadPrimitive(const CesiumGltf::MeshPrimitive* primitive,
     // Bounding volumes aren't stored in most nodes in VSG and are computed when needed. Should we
     // store the the position min / max, or just not bother?
 
-    if (primStyling.colors.valid())
+    if (primStyling.featureIds.valid())
+    {
+        // The style colors are looked up in the tile's feature palette.
+        vsg::ref_ptr<vsg::Data> featureIds = primStyling.featureIds;
+        if (expansionIndices)
+        {
+            if (ref_ptr_cast<vsg::ushortArray>(featureIds))
+            {
+                featureIds = expandArray<vsg::ushortArray>(_model, featureIds, expansionIndices);
+            }
+            else
+            {
+                featureIds = expandArray<vsg::uintArray>(_model, featureIds, expansionIndices);
+            }
+        }
+        pipelineConf->shaderHints->defines.insert("VSGCS_FEATURE_PALETTE");
+        pipelineConf->assignArray(vertexArrays, "vsgcs_FeatureId", VK_VERTEX_INPUT_RATE_VERTEX, featureIds);
+        auto color = vsg::vec4Value::create(colorWhite);
+        pipelineConf->assignArray(vertexArrays, "vsg_Color", VK_VERTEX_INPUT_RATE_INSTANCE, color);
+    }
+    else if (primStyling.colors.valid())
     {
         auto styledColors = primStyling.colors;
         if (expansionIndices)
         {
-            styledColors = expandArray(_model, primStyling.colors, expansionIndices);
+            styledColors = expandArray<vsg::vec4Array>(_model, primStyling.colors, expansionIndices);
         }
         pipelineConf->assignArray(vertexArrays, "vsg_Color", primStyling.vertexRate, styledColors);
     }
@@ -973,26 +1374,126 @@ ModelBuilder::loadPrimitive(const CesiumGltf::MeshPrimitive* primitive,
         pipelineConf->assignArray(vertexArrays, "vsg_instance2", VK_VERTEX_INPUT_RATE_INSTANCE,
                                   (*instanceData)[2]);
     }
-    vsg::ref_ptr<vsg::Command> drawCommand;
+    InstanceBinding* binding = nullptr;
+    if (_instanceBindings && instanceData)
+    {
+        for (auto& modelBinding : _instanceBindings->bindings)
+        {
+            if (modelBinding.levels[0].live[0] == (*instanceData)[0])
+            {
+                binding = &modelBinding;
+            }
+        }
+    }
+    vsg::ref_ptr<vsg::Data> indices;
     if (indicesAccessor && !expansionIndices)
     {
-        vsg::ref_ptr<vsg::Data> indices = createAccessorView(*_model, *indicesAccessor, IndexVisitor());
-        auto vid = vsg::VertexIndexDraw::create();
-        vid->assignArrays(vertexArrays);
-        vid->assignIndices(indices);
-        vid->indexCount = static_cast<uint32_t>(indices->valueCount());
-        vid->instanceCount = instanceCount;
-        drawCommand = vid;
+        indices = createAccessorView(*_model, *indicesAccessor, IndexVisitor());
     }
-    else
+    const size_t numLevels = _options.lods.size() > 1 ? _options.lods.size() : 1;
+    std::vector<vsg::ref_ptr<vsg::Data>> levelIndices(numLevels, indices);
+    if (numLevels > 1 && indices && topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+    {
+        levelIndices = simplifyLevels(positions, normalArray, indices, _options.lods);
+    }
+    std::vector<vsg::ref_ptr<vsg::Command>> drawCommands;
+    for (size_t level = 0; level < numLevels; ++level)
     {
-        auto vd = vsg::VertexDraw::create();
-        vd->assignArrays(vertexArrays);
-        vd->vertexCount = static_cast<uint32_t>(positions->valueCount());
-        vd->instanceCount = instanceCount;
-        drawCommand = vd;
+        // Without instances, levels with the same triangles can share the draw command.
+        if (level > 0 && !binding && levelIndices[level] == levelIndices[level - 1])
+        {
+            drawCommands.push_back(drawCommands.back());
+        }
+        else
+        {
+            vsg::DataList levelArrays = vertexArrays;
+            if (level > 0 && binding)
+            {
+                std::replace(levelArrays.begin(), levelArrays.end(), (*instanceData)[0], binding->levels[level].live[0]);
+                std::replace(levelArrays.begin(), levelArrays.end(), (*instanceData)[1], binding->levels[level].live[1]);
+                std::replace(levelArrays.begin(), levelArrays.end(), (*instanceData)[2], binding->levels[level].live[2]);
+            }
+            vsg::ref_ptr<vsg::Command> drawCommand;
+            if (levelIndices[level])
+            {
+                auto vid = vsg::VertexIndexDraw::create();
+                vid->assignArrays(levelArrays);
+                vid->assignIndices(levelIndices[level]);
+                vid->indexCount = static_cast<uint32_t>(levelIndices[level]->valueCount());
+                vid->instanceCount = instanceCount;
+                drawCommand = vid;
+            }
+            else
+            {
+                auto vd = vsg::VertexDraw::create();
+                vd->assignArrays(levelArrays);
+                vd->vertexCount = static_cast<uint32_t>(positions->valueCount());
+                vd->instanceCount = instanceCount;
+                drawCommand = vd;
+            }
+            drawCommand->setValue("name", name);
+            if (instanceData)
+            {
+                // GraphOptimizer can't bake transforms into instanced geometry.
+                drawCommand->setValue("vsgCs_instanced", true);
+            }
+            if (binding)
+            {
+                if (auto vid = drawCommand.cast<vsg::VertexIndexDraw>())
+                {
+                    binding->levels[level].indexedDraws.push_back(vid);
+                }
+                else if (auto vd = drawCommand.cast<vsg::VertexDraw>())
+                {
+                    binding->levels[level].draws.push_back(vd);
+                }
+            }
+            drawCommands.push_back(drawCommand);
+        }
+        if (_lodStatistics)
+        {
+            const uint32_t count = levelIndices[level] ? static_cast<uint32_t>(levelIndices[level]->valueCount())
+                : static_cast<uint32_t>(positions->valueCount());
+            _lodStatistics->triangles[level] += triangleCount(topology, count);
+        }
+    }
+    if (binding)
+    {
+        // Grow the bound of one model instance
+        const InstanceData* nodeInstances = _nodeInstances && (*_nodeInstances)[0] ? _nodeInstances : nullptr;
+        const vsg::dsphere primBound = computeBoundsFromGltf(pPositionAccessor, nodeInstances);
+        if (primBound.valid())
+        {
+            const double r = primBound.radius;
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                const vsg::dvec3 offset((corner & 1) ? r : -r, (corner & 2) ? r : -r, (corner & 4) ? r : -r);
+                _instanceBox.add(_nodeTransform * (primBound.center + offset));
+            }
+        }
+    }
+    vsg::dsphere boundingSphere = computeBoundsFromGltf(pPositionAccessor, instanceData);
+    vsg::ref_ptr<vsg::Node> drawNode = drawCommands[0];
+    if (numLevels > 1 && binding)
+    {
+        // InstancedModel sets the instance count of each level, so all the levels are drawn.
+        auto levelGroup = vsg::Group::create();
+        for (const auto& drawCommand : drawCommands)
+        {
+            levelGroup->addChild(drawCommand);
+        }
+        drawNode = levelGroup;
+    }
+    else if (numLevels > 1 && boundingSphere.valid())
+    {
+        auto lod = vsg::LOD::create();
+        lod->bound = boundingSphere;
+        for (size_t level = 0; level < numLevels; ++level)
+        {
+            lod->addChild(vsg::LOD::Child{_options.lods[level].minimumScreenHeightRatio, drawCommands[level]});
+        }
+        drawNode = lod;
     }
-    drawCommand->setValue("name", name);
     pipelineConf->init();
     _genv->sharedObjects->share(pipelineConf->bindGraphicsPipeline);
 
@@ -1011,19 +1512,52 @@ ModelBuilder::loadPrimitive(const CesiumGltf::MeshPrimitive* primitive,
     stateGroup->prototypeArrayState
         = pipelineConf->shaderSet->getSuitableArrayState(pipelineConf->shaderHints->defines);
 
-    stateGroup->addChild(drawCommand);
-    vsg::dsphere boundingSphere = computeBoundsFromGltf(pPositionAccessor, instanceData);
-    if (descConf->blending)
+    stateGroup->addChild(drawNode);
+    auto cullPrimitive = [&](const vsg::ref_ptr<vsg::StateGroup>& primStateGroup) -> vsg::ref_ptr<vsg::Node>
+    {
+        if (descConf->blending)
+        {
+            // XXX Not sure what to do if the boundingSphere isn't valid; emit a warning?
+            return vsg::DepthSorted::create(10, boundingSphere, primStateGroup);
+        }
+        if (boundingSphere.valid())
+        {
+            return vsg::CullNode::create(boundingSphere, primStateGroup);
+        }
+        return primStateGroup;
+    };
+    if (!_options.depthPrepass)
     {
-        // XXX Not sure what to do if the boundingSphere isn't valid; emit a warning?
-        return vsg::DepthSorted::create(10, boundingSphere, stateGroup);
+        return cullPrimitive(stateGroup);
     }
+    // TilesetNode chooses the pass with the traversal mask.
+    auto passSwitch = vsg::Switch::create();
+    if (csMaterial->opaque && !descConf->blending && isTriangleTopology(topology))
+    {
+        auto depthPipeline = makeDepthPassPipeline(pipelineConf, true);
+        _genv->sharedObjects->share(depthPipeline);
+        auto depthStateGroup = vsg::StateGroup::create();
+        depthStateGroup->add(depthPipeline);
+        depthStateGroup->prototypeArrayState = stateGroup->prototypeArrayState;
+        depthStateGroup->addChild(drawNode);
 
-    if (boundingSphere.valid())
+        auto equalPipeline = makeDepthPassPipeline(pipelineConf, false);
+        _genv->sharedObjects->share(equalPipeline);
+        auto equalStateGroup = vsg::StateGroup::create();
+        equalStateGroup->stateCommands = stateGroup->stateCommands;
+        equalStateGroup->stateCommands[0] = equalPipeline;
+        equalStateGroup->prototypeArrayState = stateGroup->prototypeArrayState;
+        equalStateGroup->addChild(drawNode);
+
+        passSwitch->addChild(pbr::DEPTH_PREPASS_MASK, cullPrimitive(depthStateGroup));
+        passSwitch->addChild(pbr::DEPTH_EQUAL_MASK, cullPrimitive(equalStateGroup));
+        passSwitch->addChild(pbr::DEPTH_STANDARD_MASK, cullPrimitive(stateGroup));
+    }
+    else
     {
-        return vsg::CullNode::create(boundingSphere, stateGroup);
+        passSwitch->addChild(pbr::DEPTH_EQUAL_MASK | pbr::DEPTH_STANDARD_MASK, cullPrimitive(stateGroup));
     }
-    return stateGroup;
+    return passSwitch;
 }
 
 vsg::ref_ptr<ModelBuilder::CsMaterial>
@@ -1049,6 +1583,7 @@ ModelBuilder::loadMaterial(const CesiumGltf::Material* material, VkPrimitiveTopo
         csMat->descriptorConfig->defines.insert("VSGCS_TILE");
     }
     vsg::PbrMaterial pbr;
+    csMat->opaque = material->alphaMode == CesiumGltf::Material::AlphaMode::OPAQUE;
     if (material->alphaMode == CesiumGltf::Material::AlphaMode::BLEND)
     {
         csMat->descriptorConfig->blending = true;
@@ -1136,9 +1671,27 @@ ModelBuilder::operator()()
         // No nodes either, show all the meshes.
         transform_append(_model->meshes, resultNode->children, [this](auto&& mesh)
         {
-            return loadMesh(&mesh);
+            return loadNodeMesh(&mesh, nullptr);
         });
     }
+    if (_stylist && _stylist->featureTable)
+    {
+        _stylist->finish();
+        resultNode->setObject("vsgCs_featureTable", _stylist->featureTable);
+    }
+    if (_instanceBindings && !_instanceBindings->bindings.empty())
+    {
+        if (_instanceBox.valid())
+        {
+            _instanceBindings->modelBound = vsg::dsphere((_instanceBox.min + _instanceBox.max) * 0.5,
+                                                         vsg::length(_instanceBox.max - _instanceBox.min) * 0.5);
+        }
+        resultNode->setObject("vsgCs_instanceBindings", _instanceBindings);
+    }
+    if (_lodStatistics)
+    {
+        resultNode->setObject("vsgCs_lodStatistics", _lodStatistics);
+    }
     return resultNode;
 }
 
@@ -1159,6 +1712,10 @@ vsg::ref_ptr<vsg::Data> ModelBuilder::loadImage(int i, bool useMipMaps, bool sRG
     {
         return imageData.image;
     }
+    if (_options.maxTextureSize > 0)
+    {
+        image = reduceImage(image, _options.maxTextureSize);
+    }
     auto data = vsgCs::loadImage(image, useMipMaps, sRGB);
     imageData.sRGB = sRGB;
     if (useMipMaps)
@@ -26,16 +26,20 @@ SOFTWARE.
 
 #include "vsgCs/Export.h"
 #include "GraphicsEnvironment.h"
+#include "MeshSimplifier.h"
 #include "runtimeSupport.h"
 
+#include <vsg/core/Array.h>
 #include <vsg/core/Inherit.h>
 #include <vsg/io/Logger.h>
+#include <vsg/maths/box.h>
 #include <vsg/utils/GraphicsPipelineConfigurator.h>
 
 #include <array>
 
 namespace vsgCs
 {
+    class InstanceBindings;
     class Styling;
     class Stylist;
 
@@ -91,6 +95,22 @@ namespace vsgCs
         ~CreateModelOptions();
         bool renderOverlays;
         bool lodFade;
+        // Run GraphOptimizer on the result
+        bool optimizeGraph;
+        // Build depth-only and equal-depth versions of opaque primitives. See pbr.h.
+        bool depthPrepass;
+        // Keep the triangles of a tile in memory for intersection tests. See TileGeometry.h.
+        bool keepGeometry;
+        // Build a BVH over the kept triangles
+        bool buildBVH;
+        // Draw the whole model once per matrix with GPU instancing. The matrices are in the
+        // model's coordinate system. See InstancedModel.h.
+        vsg::ref_ptr<const vsg::dmat4Array> instances;
+        // Levels of detail to build by simplifying the triangles, from the most detailed. See
+        // MeshSimplifier.h.
+        std::vector<LodLevel> lods;
+        // If not 0, textures are reduced to at most this size. See ProgressiveModel.h.
+        uint32_t maxTextureSize;
         vsg::ref_ptr<Styling> styling;
     };
 
@@ -105,6 +125,18 @@ namespace vsgCs
         ~ModelBuilder();
         vsg::ref_ptr<vsg::Group> operator()();
         vsg::ref_ptr<vsg::Group> loadNode(const CesiumGltf::Node* node);
+        // A node with a mesh, and its transform to the model's root
+        struct MeshNode
+        {
+            // nullptr for a mesh in a model without nodes
+            const CesiumGltf::Node* node;
+            int32_t mesh;
+            vsg::dmat4 transform;
+        };
+        /// @brief The nodes with meshes in the scene that operator() would load, in order.
+        static std::vector<MeshNode> getMeshNodes(const CesiumGltf::Model& model);
+        /// @brief Load the mesh of one node, under its transform to the model's root.
+        vsg::ref_ptr<vsg::Node> loadMeshNode(const MeshNode& meshNode);
         using InstanceData = std::array<vsg::ref_ptr<vsg::vec4Array>, 3>;
         vsg::ref_ptr<vsg::Group> loadMesh(const CesiumGltf::Mesh* mesh,
                                           const InstanceData* instanceData = nullptr);
@@ -144,6 +176,8 @@ namespace vsgCs
             return false;
         }
         std::string makeName(const CesiumGltf::Mesh* mesh, const CesiumGltf::MeshPrimitive* primitive) const;
+        vsg::ref_ptr<vsg::Group> loadNodeMesh(const CesiumGltf::Mesh* mesh, const InstanceData* nodeInstances);
+        InstanceData bindModelInstances(const InstanceData* nodeInstances);
 
         vsg::ref_ptr<GraphicsEnvironment>_genv;
         CesiumGltf::Model* _model;
@@ -160,6 +194,8 @@ namespace vsgCs
         {
             vsg::ref_ptr<vsg::DescriptorConfigurator> descriptorConfig;
             std::map<std::string, TexInfo> texInfo;
+            // glTF alpha mode is OPAQUE
+            bool opaque = true;
         };
         std::vector<std::array<vsg::ref_ptr<CsMaterial>, 2>> _csMaterials;
         struct ImageData
@@ -181,6 +217,12 @@ namespace vsgCs
         }
         ExtensionList _activeExtensions;
         vsg::ref_ptr<Stylist> _stylist;
+        // Transform from the node being loaded to the model's root
+        vsg::dmat4 _nodeTransform;
+        vsg::ref_ptr<InstanceBindings> _instanceBindings;
+        const InstanceData* _nodeInstances = nullptr;
+        vsg::dbox _instanceBox;
+        vsg::ref_ptr<LodStatistics> _lodStatistics;
     };
     // Helper function for getting an attribute accessor by name.
     const CesiumGltf::Accessor* getAccessor(const CesiumGltf::Model* model,
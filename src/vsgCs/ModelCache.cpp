@@ -0,0 +1,277 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "ModelCache.h"
+
+#include "OpThreadTaskProcessor.h"
+
+#include <CesiumAsync/Promise.h>
+
+#include <vsg/commands/BindDescriptorSet.h>
+#include <vsg/commands/VertexDraw.h>
+#include <vsg/commands/VertexIndexDraw.h>
+#include <vsg/core/ConstVisitor.h>
+#include <vsg/nodes/StateGroup.h>
+#include <vsg/state/DescriptorBuffer.h>
+#include <vsg/state/DescriptorImage.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace vsgCs;
+
+namespace
+{
+    class CollectModelData : public vsg::Inherit<vsg::ConstVisitor, CollectModelData>
+    {
+    public:
+        void apply(const vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(const vsg::StateGroup& stateGroup) override
+        {
+            for (const auto& command : stateGroup.stateCommands)
+            {
+                command->accept(*this);
+            }
+            stateGroup.traverse(*this);
+        }
+
+        void apply(const vsg::BindDescriptorSet& bind) override
+        {
+            if (bind.descriptorSet)
+            {
+                addDescriptors(*bind.descriptorSet);
+            }
+        }
+
+        void apply(const vsg::BindDescriptorSets& bind) override
+        {
+            for (const auto& descriptorSet : bind.descriptorSets)
+            {
+                addDescriptors(*descriptorSet);
+            }
+        }
+
+        void apply(const vsg::VertexIndexDraw& draw) override
+        {
+            addBuffers(draw.arrays);
+            if (draw.indices)
+            {
+                add(draw.indices->data);
+            }
+        }
+
+        void apply(const vsg::VertexDraw& draw) override
+        {
+            addBuffers(draw.arrays);
+        }
+
+        uint64_t bytes = 0;
+    protected:
+        void add(const vsg::ref_ptr<vsg::Data>& data)
+        {
+            if (data && _data.insert(data.get()).second)
+            {
+                bytes += data->dataSize();
+            }
+        }
+
+        void addBuffers(const vsg::BufferInfoList& buffers)
+        {
+            for (const auto& bufferInfo : buffers)
+            {
+                if (bufferInfo)
+                {
+                    add(bufferInfo->data);
+                }
+            }
+        }
+
+        void addDescriptors(const vsg::DescriptorSet& descriptorSet)
+        {
+            for (const auto& descriptor : descriptorSet.descriptors)
+            {
+                if (auto descriptorImage = descriptor.cast<vsg::DescriptorImage>())
+                {
+                    for (const auto& imageInfo : descriptorImage->imageInfoList)
+                    {
+                        if (imageInfo && imageInfo->imageView && imageInfo->imageView->image)
+                        {
+                            add(imageInfo->imageView->image->data);
+                        }
+                    }
+                }
+                else if (auto descriptorBuffer = descriptor.cast<vsg::DescriptorBuffer>())
+                {
+                    addBuffers(descriptorBuffer->bufferInfoList);
+                }
+            }
+        }
+
+        std::set<const vsg::Data*> _data;
+    };
+}
+
+ModelCache::ModelCache(uint64_t in_maximumBytes)
+    : maximumBytes(in_maximumBytes)
+{
+}
+
+CesiumAsync::SharedFuture<vsg::ref_ptr<vsg::Node>>
+ModelCache::getOrLoad(const std::string& key, const LoadFunction& load)
+{
+    auto& asyncSystem = getAsyncSystem();
+    std::optional<CesiumAsync::Promise<vsg::ref_ptr<vsg::Node>>> promise;
+    std::optional<CesiumAsync::SharedFuture<vsg::ref_ptr<vsg::Node>>> result;
+    {
+        std::scoped_lock lock(_mutex);
+        auto& entry = _entries[key];
+        entry.lastUsed = ++_useCount;
+        if (entry.node)
+        {
+            ++_stats.hits;
+            return asyncSystem.createResolvedFuture(vsg::ref_ptr<vsg::Node>(entry.node)).share();
+        }
+        if (entry.loading)
+        {
+            ++_stats.inFlightHits;
+            return *entry.loading;
+        }
+        ++_stats.misses;
+        promise = asyncSystem.createPromise<vsg::ref_ptr<vsg::Node>>();
+        entry.loading = promise->getFuture().share();
+        result = entry.loading;
+    }
+    // The load can finish immediately, so it is started without holding the lock.
+    vsg::ref_ptr<ModelCache> cache(this);
+    load()
+        .catchImmediately([key](std::exception&& e)
+        {
+            vsg::warn("Loading model ", key, " failed: ", e.what());
+            return vsg::ref_ptr<vsg::Node>();
+        })
+        .thenImmediately([cache, key, promise = std::move(*promise)](vsg::ref_ptr<vsg::Node>&& node)
+        {
+            cache->finishLoad(key, node);
+            promise.resolve(std::move(node));
+        });
+    return *result;
+}
+
+void ModelCache::finishLoad(const std::string& key, const vsg::ref_ptr<vsg::Node>& node)
+{
+    const uint64_t bytes = node ? computeModelBytes(*node) : 0;
+    std::scoped_lock lock(_mutex);
+    auto itr = _entries.find(key);
+    // The entry is gone, or was replaced by another load, if the cache was cleared.
+    if (itr == _entries.end() || itr->second.node)
+    {
+        return;
+    }
+    if (!node)
+    {
+        _entries.erase(itr);
+        return;
+    }
+    itr->second.loading.reset();
+    itr->second.node = node;
+    itr->second.bytes = bytes;
+    _totalBytes += bytes;
+    evictLocked();
+}
+
+size_t ModelCache::evict()
+{
+    std::scoped_lock lock(_mutex);
+    return evictLocked();
+}
+
+size_t ModelCache::evictLocked()
+{
+    if (_totalBytes <= maximumBytes)
+    {
+        return 0;
+    }
+    // Models that nobody else holds, least recently used first
+    std::vector<std::pair<uint64_t, std::map<std::string, Entry>::iterator>> unused;
+    for (auto itr = _entries.begin(); itr != _entries.end(); ++itr)
+    {
+        if (itr->second.node && itr->second.node->referenceCount() == 1)
+        {
+            unused.emplace_back(itr->second.lastUsed, itr);
+        }
+    }
+    std::sort(unused.begin(), unused.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    size_t numEvicted = 0;
+    for (auto& [lastUsed, itr] : unused)
+    {
+        if (_totalBytes <= maximumBytes)
+        {
+            break;
+        }
+        _totalBytes -= itr->second.bytes;
+        _entries.erase(itr);
+        ++numEvicted;
+    }
+    _stats.evictions += numEvicted;
+    return numEvicted;
+}
+
+void ModelCache::clear()
+{
+    std::scoped_lock lock(_mutex);
+    // Loads in flight will find that their entry is gone.
+    _entries.clear();
+    _totalBytes = 0;
+}
+
+uint64_t ModelCache::getTotalBytes() const
+{
+    std::scoped_lock lock(_mutex);
+    return _totalBytes;
+}
+
+size_t ModelCache::getNumModels() const
+{
+    std::scoped_lock lock(_mutex);
+    return _entries.size();
+}
+
+ModelCache::Stats ModelCache::getStats() const
+{
+    std::scoped_lock lock(_mutex);
+    return _stats;
+}
+
+uint64_t ModelCache::computeModelBytes(const vsg::Node& node)
+{
+    auto collector = CollectModelData::create();
+    node.accept(*collector);
+    return collector->bytes;
+}
@@ -0,0 +1,100 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <CesiumAsync/Future.h>
+#include <CesiumAsync/SharedFuture.h>
+
+#include <vsg/core/Inherit.h>
+#include <vsg/nodes/Node.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace vsgCs
+{
+    /**
+     * @brief Cache of built model subgraphs, keyed by the model's URL and load options.
+     *
+     * Requests for a model that is being loaded share the load in flight. A cached subgraph is
+     * shared by everyone who asks for it, so it must not be modified. The memory of the vertex,
+     * index and image data of each model is counted, and when the total exceeds maximumBytes the
+     * least recently used models that aren't referenced outside of the cache are evicted. Models
+     * that are in use are never evicted.
+     */
+    class VSGCS_EXPORT ModelCache : public vsg::Inherit<vsg::Object, ModelCache>
+    {
+    public:
+        explicit ModelCache(uint64_t maximumBytes = 512 * 1024 * 1024);
+        using LoadFunction = std::function<CesiumAsync::Future<vsg::ref_ptr<vsg::Node>>()>;
+        /**
+         * @brief Get a model from the cache, or start loading it with load().
+         *
+         * A null model isn't cached, so a failed load is tried again the next time.
+         */
+        CesiumAsync::SharedFuture<vsg::ref_ptr<vsg::Node>> getOrLoad(const std::string& key, const LoadFunction& load);
+        /// @brief Evict unused models until the total size is below maximumBytes.
+        /// @return the number of models evicted
+        size_t evict();
+        void clear();
+        uint64_t getTotalBytes() const;
+        size_t getNumModels() const;
+        struct Stats
+        {
+            uint64_t hits = 0;
+            // Requests that joined a load in flight
+            uint64_t inFlightHits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+        };
+        Stats getStats() const;
+        /// @brief Bytes of the vertex, index and image data of a model, counting shared data once.
+        static uint64_t computeModelBytes(const vsg::Node& node);
+        uint64_t maximumBytes;
+    protected:
+        struct Entry
+        {
+            // Only set while the model is loading; a finished future would hold a reference to
+            // the model.
+            std::optional<CesiumAsync::SharedFuture<vsg::ref_ptr<vsg::Node>>> loading;
+            vsg::ref_ptr<vsg::Node> node;
+            uint64_t bytes = 0;
+            uint64_t lastUsed = 0;
+        };
+        void finishLoad(const std::string& key, const vsg::ref_ptr<vsg::Node>& node);
+        size_t evictLocked();
+        mutable std::mutex _mutex;
+        std::map<std::string, Entry> _entries;
+        uint64_t _totalBytes = 0;
+        uint64_t _useCount = 0;
+        Stats _stats;
+    };
+}
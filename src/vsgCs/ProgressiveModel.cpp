@@ -0,0 +1,372 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "ProgressiveModel.h"
+
+#include "ModelBuilder.h"
+#include "runtimeSupport.h"
+
+#include <CesiumGltf/AccessorSpec.h>
+#include <CesiumGltfContent/GltfUtilities.h>
+
+#include <vsg/app/Viewer.h>
+#include <vsg/nodes/MatrixTransform.h>
+
+#include <array>
+#include <cstring>
+
+using namespace vsgCs;
+using namespace CesiumGltf;
+
+namespace
+{
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::array<vsg::dvec3, 8> corners(const vsg::dbox& box)
+    {
+        return {vsg::dvec3(box.min.x, box.min.y, box.min.z), vsg::dvec3(box.max.x, box.min.y, box.min.z),
+                vsg::dvec3(box.min.x, box.max.y, box.min.z), vsg::dvec3(box.max.x, box.max.y, box.min.z),
+                vsg::dvec3(box.min.x, box.min.y, box.max.z), vsg::dvec3(box.max.x, box.min.y, box.max.z),
+                vsg::dvec3(box.min.x, box.max.y, box.max.z), vsg::dvec3(box.max.x, box.max.y, box.max.z)};
+    }
+
+    vsg::dbox transformBox(const vsg::dmat4& matrix, const vsg::dbox& box)
+    {
+        vsg::dbox result;
+        if (box.valid())
+        {
+            for (const auto& corner : corners(box))
+            {
+                result.add(matrix * corner);
+            }
+        }
+        return result;
+    }
+
+    // The bounds of a mesh come from the min and max of its POSITION accessors, which glTF
+    // requires, so the vertices don't need to be read.
+    vsg::dbox meshBounds(const Model& model, const ModelBuilder::MeshNode& meshNode)
+    {
+        vsg::dbox bounds;
+        for (const auto& primitive : model.meshes[meshNode.mesh].primitives)
+        {
+            auto positionItr = primitive.attributes.find("POSITION");
+            if (positionItr == primitive.attributes.end())
+            {
+                continue;
+            }
+            const Accessor* accessor = Model::getSafe(&model.accessors, positionItr->second);
+            if (accessor && accessor->min.size() >= 3 && accessor->max.size() >= 3)
+            {
+                bounds.add(vsg::dvec3(accessor->min[0], accessor->min[1], accessor->min[2]));
+                bounds.add(vsg::dvec3(accessor->max[0], accessor->max[1], accessor->max[2]));
+            }
+        }
+        return transformBox(meshNode.transform, bounds);
+    }
+
+    bool meshHasTextures(const Model& model, int32_t meshId)
+    {
+        for (const auto& primitive : model.meshes[meshId].primitives)
+        {
+            const Material* material = Model::getSafe(&model.materials, primitive.material);
+            if (!material)
+            {
+                continue;
+            }
+            if (material->normalTexture || material->occlusionTexture || material->emissiveTexture)
+            {
+                return true;
+            }
+            if (material->pbrMetallicRoughness
+                && (material->pbrMetallicRoughness->baseColorTexture
+                    || material->pbrMetallicRoughness->metallicRoughnessTexture))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+ProgressiveModel::ProgressiveModel()
+    : _startTime(std::chrono::steady_clock::now())
+{
+}
+
+void ProgressiveModel::post(Message&& message)
+{
+    std::scoped_lock lock(_mutex);
+    if (message.kind == Message::PART && message.isFinal)
+    {
+        ++_numFinal;
+    }
+    else if (message.kind == Message::DONE || message.kind == Message::FAILED)
+    {
+        _done = true;
+    }
+    _messages.push_back(std::move(message));
+}
+
+void ProgressiveModel::fail()
+{
+    post(Message{Message::FAILED});
+}
+
+vsg::ref_ptr<vsg::Node> ProgressiveModel::buildPlaceholder(const vsg::ref_ptr<GraphicsEnvironment>& genv,
+                                                           const std::vector<vsg::dbox>& partBounds)
+{
+    // The boxes are a glTF model of their own, so that ModelBuilder makes their pipelines.
+    static const std::array<uint16_t, 36> boxIndices = {
+        0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    const size_t indexBytes = boxIndices.size() * sizeof(uint16_t);
+    const size_t boxBytes = 8 * 3 * sizeof(float);
+    Model boxes;
+    Material& material = boxes.materials.emplace_back();
+    material.alphaMode = Material::AlphaMode::BLEND;
+    material.doubleSided = true;
+    auto& pbr = material.pbrMetallicRoughness.emplace();
+    pbr.baseColorFactor = {0.6, 0.6, 0.6, 0.35};
+    pbr.metallicFactor = 0.0;
+    pbr.roughnessFactor = 1.0;
+    Buffer& buffer = boxes.buffers.emplace_back();
+    buffer.cesium.data.resize(indexBytes + boxBytes * partBounds.size());
+    std::memcpy(buffer.cesium.data.data(), boxIndices.data(), indexBytes);
+    BufferView& indexView = boxes.bufferViews.emplace_back();
+    indexView.buffer = 0;
+    indexView.byteLength = static_cast<int64_t>(indexBytes);
+    indexView.target = BufferView::Target::ELEMENT_ARRAY_BUFFER;
+    BufferView& positionView = boxes.bufferViews.emplace_back();
+    positionView.buffer = 0;
+    positionView.byteOffset = static_cast<int64_t>(indexBytes);
+    positionView.byteLength = static_cast<int64_t>(boxBytes * partBounds.size());
+    positionView.target = BufferView::Target::ARRAY_BUFFER;
+    Accessor& indexAccessor = boxes.accessors.emplace_back();
+    indexAccessor.bufferView = 0;
+    indexAccessor.componentType = Accessor::ComponentType::UNSIGNED_SHORT;
+    indexAccessor.type = Accessor::Type::SCALAR;
+    indexAccessor.count = static_cast<int64_t>(boxIndices.size());
+    buffer.byteLength = static_cast<int64_t>(buffer.cesium.data.size());
+
+    auto parts = vsg::Group::create();
+    std::vector<int32_t> partMeshes;
+    for (size_t i = 0; i < partBounds.size(); ++i)
+    {
+        const auto& bounds = partBounds[i];
+        if (!bounds.valid())
+        {
+            partMeshes.push_back(-1);
+            continue;
+        }
+        auto* positions = reinterpret_cast<float*>(buffer.cesium.data.data() + indexBytes + boxBytes * i);
+        for (const auto& corner : corners(bounds))
+        {
+            *positions++ = static_cast<float>(corner.x);
+            *positions++ = static_cast<float>(corner.y);
+            *positions++ = static_cast<float>(corner.z);
+        }
+        Accessor& positionAccessor = boxes.accessors.emplace_back();
+        positionAccessor.bufferView = 1;
+        positionAccessor.byteOffset = static_cast<int64_t>(boxBytes * i);
+        positionAccessor.componentType = Accessor::ComponentType::FLOAT;
+        positionAccessor.type = Accessor::Type::VEC3;
+        positionAccessor.count = 8;
+        positionAccessor.min = {bounds.min.x, bounds.min.y, bounds.min.z};
+        positionAccessor.max = {bounds.max.x, bounds.max.y, bounds.max.z};
+        Mesh& mesh = boxes.meshes.emplace_back();
+        MeshPrimitive& primitive = mesh.primitives.emplace_back();
+        primitive.attributes["POSITION"] = static_cast<int32_t>(boxes.accessors.size() - 1);
+        primitive.indices = 0;
+        primitive.material = 0;
+        primitive.mode = MeshPrimitive::Mode::TRIANGLES;
+        partMeshes.push_back(static_cast<int32_t>(boxes.meshes.size() - 1));
+    }
+    ModelBuilder builder(genv, &boxes, CreateModelOptions());
+    for (int32_t meshId : partMeshes)
+    {
+        if (meshId < 0)
+        {
+            parts->addChild(vsg::Group::create());
+        }
+        else
+        {
+            parts->addChild(builder.loadMeshNode({nullptr, meshId, vsg::dmat4()}));
+        }
+    }
+    return parts;
+}
+
+void ProgressiveModel::build(const vsg::ref_ptr<GraphicsEnvironment>& genv, Model& model)
+{
+    auto compile = [this](const vsg::ref_ptr<vsg::Node>& node) -> std::optional<vsg::CompileResult>
+    {
+        vsg::ref_ptr<vsg::Viewer> viewer;
+        {
+            std::scoped_lock lock(_mutex);
+            viewer = _viewer.ref_ptr();
+        }
+        if (node && viewer && viewer->compileManager)
+        {
+            return viewer->compileManager->compile(node);
+        }
+        return {};
+    };
+    glm::dmat4 yUp(1.0);
+    yUp = CesiumGltfContent::GltfUtilities::applyGltfUpAxisTransform(model, yUp);
+    const vsg::dmat4 upTransform = glm2vsg(yUp);
+    const auto meshNodes = ModelBuilder::getMeshNodes(model);
+    std::vector<vsg::dbox> partBounds;
+    vsg::dbox bounds;
+    for (const auto& meshNode : meshNodes)
+    {
+        partBounds.push_back(meshBounds(model, meshNode));
+        bounds.add(transformBox(upTransform, partBounds.back()));
+    }
+    {
+        std::scoped_lock lock(_mutex);
+        _bounds = bounds;
+        _numParts = meshNodes.size();
+    }
+    auto root = vsg::MatrixTransform::create(upTransform);
+    root->addChild(buildPlaceholder(genv, partBounds));
+    post(Message{Message::PLACEHOLDER, 0, false, root, compile(root)});
+
+    // First pass: every part, with small textures
+    std::vector<size_t> texturedParts;
+    {
+        CreateModelOptions lowOptions;
+        lowOptions.maxTextureSize = lowTextureSize;
+        ModelBuilder builder(genv, &model, lowOptions);
+        for (size_t i = 0; i < meshNodes.size(); ++i)
+        {
+            const bool isFinal = !meshHasTextures(model, meshNodes[i].mesh);
+            if (!isFinal)
+            {
+                texturedParts.push_back(i);
+            }
+            auto node = builder.loadMeshNode(meshNodes[i]);
+            post(Message{Message::PART, i, isFinal, node, compile(node)});
+        }
+    }
+    // Second pass: the textured parts again, with their full textures
+    {
+        ModelBuilder builder(genv, &model, CreateModelOptions());
+        for (size_t i : texturedParts)
+        {
+            auto node = builder.loadMeshNode(meshNodes[i]);
+            post(Message{Message::PART, i, true, node, compile(node)});
+        }
+    }
+    post(Message{Message::DONE});
+}
+
+bool ProgressiveModel::update(vsg::Viewer& viewer, double budgetMs)
+{
+    const auto start = std::chrono::steady_clock::now();
+    bool changed = false;
+    {
+        std::scoped_lock lock(_mutex);
+        _viewer = vsg::ref_ptr<vsg::Viewer>(&viewer);
+    }
+    while (millisecondsSince(start) < budgetMs)
+    {
+        Message message;
+        {
+            std::scoped_lock lock(_mutex);
+            if (_messages.empty())
+            {
+                break;
+            }
+            message = std::move(_messages.front());
+            _messages.pop_front();
+        }
+        if (message.node)
+        {
+            // Parts that arrive before the viewer was known are compiled here.
+            if (!message.compileResult && viewer.compileManager)
+            {
+                message.compileResult = viewer.compileManager->compile(message.node);
+            }
+            if (message.compileResult)
+            {
+                vsg::updateViewer(viewer, *message.compileResult);
+            }
+        }
+        switch (message.kind)
+        {
+        case Message::PLACEHOLDER:
+            addChild(message.node);
+            _parts = ref_ptr_cast<vsg::Group>(ref_ptr_cast<vsg::Group>(message.node)->children[0]);
+            _partShown.assign(_parts->children.size(), false);
+            vsg::info("ProgressiveModel: placeholder shown after ", millisecondsSince(_startTime), " ms");
+            changed = true;
+            break;
+        case Message::PART:
+            _parts->children[message.index] = message.node;
+            if (!_partShown[message.index])
+            {
+                _partShown[message.index] = true;
+                if (++_numShown == _partShown.size())
+                {
+                    vsg::info("ProgressiveModel: all ", _numShown, " parts shown after ",
+                              millisecondsSince(_startTime), " ms");
+                }
+            }
+            changed = true;
+            break;
+        case Message::DONE:
+            vsg::info("ProgressiveModel: full detail after ", millisecondsSince(_startTime), " ms");
+            break;
+        case Message::FAILED:
+            break;
+        }
+    }
+    return changed;
+}
+
+vsg::dbox ProgressiveModel::getBounds() const
+{
+    std::scoped_lock lock(_mutex);
+    return _bounds;
+}
+
+double ProgressiveModel::getProgress() const
+{
+    std::scoped_lock lock(_mutex);
+    if (_numParts == 0)
+    {
+        return _done ? 1.0 : 0.0;
+    }
+    return static_cast<double>(_numFinal) / static_cast<double>(_numParts);
+}
+
+bool ProgressiveModel::isDone() const
+{
+    std::scoped_lock lock(_mutex);
+    return _done;
+}
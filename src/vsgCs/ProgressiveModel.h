@@ -0,0 +1,116 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+#include "GraphicsEnvironment.h"
+
+#include <CesiumGltf/Model.h>
+
+#include <vsg/app/CompileManager.h>
+#include <vsg/core/observer_ptr.h>
+#include <vsg/maths/box.h>
+#include <vsg/nodes/Group.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace vsg
+{
+    class Viewer;
+}
+
+namespace vsgCs
+{
+    /**
+     * @brief A glTF model that appears a piece at a time while it is being built.
+     *
+     * A large model is first shown as a translucent box for each of its meshes. The boxes are
+     * replaced by the meshes, with their textures reduced to lowTextureSize, as soon as each one
+     * is built, and the meshes with textures are then rebuilt with the full textures. The parts
+     * are built and compiled in worker threads; update() attaches them to the scene graph in the
+     * main thread, spending at most a time budget per frame.
+     *
+     * The bounds of the model are known once the placeholder has arrived; see getBounds().
+     */
+    class VSGCS_EXPORT ProgressiveModel : public vsg::Inherit<vsg::Group, ProgressiveModel>
+    {
+    public:
+        ProgressiveModel();
+        /**
+         * @brief Build the parts of a model. Call from a worker thread.
+         *
+         * The model must stay alive until build() returns.
+         */
+        void build(const vsg::ref_ptr<GraphicsEnvironment>& genv, CesiumGltf::Model& model);
+        /// @brief Report that the model couldn't be read.
+        void fail();
+        /**
+         * @brief Attach the parts that are ready. Call once per frame from the main thread.
+         * @return true if the scene graph was changed
+         */
+        bool update(vsg::Viewer& viewer, double budgetMs = 2.0);
+        /// @brief The bounding box of the model in its own coordinates; invalid until it is known.
+        vsg::dbox getBounds() const;
+        /// @brief The fraction of the parts that are shown at full detail.
+        double getProgress() const;
+        /// @brief True when the model is shown at full detail, or couldn't be read.
+        bool isDone() const;
+        uint32_t lowTextureSize = 64;
+    protected:
+        struct Message
+        {
+            enum Kind
+            {
+                PLACEHOLDER,
+                PART,
+                DONE,
+                FAILED
+            };
+            Kind kind = DONE;
+            size_t index = 0;
+            bool isFinal = false;
+            vsg::ref_ptr<vsg::Node> node;
+            std::optional<vsg::CompileResult> compileResult;
+        };
+        void post(Message&& message);
+        vsg::ref_ptr<vsg::Node> buildPlaceholder(const vsg::ref_ptr<GraphicsEnvironment>& genv,
+                                                 const std::vector<vsg::dbox>& partBounds);
+        mutable std::mutex _mutex;
+        std::deque<Message> _messages;
+        vsg::observer_ptr<vsg::Viewer> _viewer;
+        vsg::dbox _bounds;
+        size_t _numParts = 0;
+        size_t _numFinal = 0;
+        bool _done = false;
+        // Touched only in the main thread
+        vsg::ref_ptr<vsg::Group> _parts;
+        std::vector<bool> _partShown;
+        size_t _numShown = 0;
+        std::chrono::steady_clock::time_point _startTime;
+    };
+}
@@ -61,7 +61,7 @@ namespace
 }
 
 RuntimeEnvironment::RuntimeEnvironment()
-    : tracyContext(TracyContextValue::create())
+    : modelCache(ModelCache::create()), tracyContext(TracyContextValue::create())
 {
 #ifdef VSGCS_USE_PROJ
     hasProj = true;
@@ -166,6 +166,16 @@ void RuntimeEnvironment::initializeCs(vsg::CommandLine& arguments)
     }
     generateShaderDebugInfo = arguments.read("--shader-debug-info");
     enableLodTransitionPeriod = arguments.read("--lod-transition");
+    optimizeTileGraphs = readBooleanArgument(arguments, "optimize-tiles", true);
+    depthPrepass = arguments.read("--depth-prepass");
+    keepTileGeometry = readBooleanArgument(arguments, "tile-geometry", false);
+    buildTileBVH = readBooleanArgument(arguments, "tile-bvh", true);
+    gpuInstancing = readBooleanArgument(arguments, "gpu-instancing", true);
+    uint64_t modelCacheMB = 0;
+    if (arguments.read("--model-cache-size", modelCacheMB))
+    {
+        modelCache->maximumBytes = modelCacheMB * 1024 * 1024;
+    }
 
     bool tracyDefault = false;
 #ifdef TRACY_ENABLE
@@ -313,6 +323,12 @@ DeviceFeatures RuntimeEnvironment::prepareFeaturesAndExtensions(const vsg::ref_p
         supportedFormats.PVRTC2_4_RGBA = true;
     }
     features.ktx2TranscodeTargets = CesiumGltf::Ktx2TranscodeTargets(supportedFormats, false);
+    // For counting fragment shader invocations
+    if (physFeatures.pipelineStatisticsQuery)
+    {
+        features.pipelineStatisticsQuery = true;
+        traits->deviceFeatures->get().pipelineStatisticsQuery = 1;
+    }
     // Large point sizes for scaling by distance
     if (physFeatures.largePoints)
     {
@@ -436,6 +452,8 @@ std::shared_ptr<Cesium3DTilesSelection::TilesetExternals> RuntimeEnvironment::ge
 
 void RuntimeEnvironment::update()
 {
+    // Models released since the last frame can now be evicted.
+    modelCache->evict();
 }
  
 vsg::ref_ptr<RuntimeEnvironment> RuntimeEnvironment::get()
@@ -473,6 +491,12 @@ std::string RuntimeEnvironment::csUsage()
         "--cesium-cache filename\t cache file for 3D Tiles remote requests\n"
         "--shader-debug-info\t generate symbols for shader source debugging\n"
         "--lod-transition\t enable noise-based LOD transition\n"
+        "--[no-]optimize-tiles\t flatten tile scene graphs and bake static transforms (default true)\n"
+        "--depth-prepass\t render a depth-only pass of opaque tiles before shading them\n"
+        "--[no-]tile-geometry\t keep tile triangles in all tilesets, not only terrain tilesets (default false)\n"
+        "--[no-]tile-bvh\t build a BVH over the kept tile triangles (default true)\n"
+        "--[no-]gpu-instancing\t draw repeated GeoNode models with GPU instancing (default true)\n"
+        "--model-cache-size MB\t memory budget of the glTF model cache (default 512)\n"
         "--[no-]proj-network\t disable / enable Proj network use (default true)\n"
     };
 }
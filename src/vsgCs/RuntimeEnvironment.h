@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include "vsgCs/Export.h"
 #include "GraphicsEnvironment.h"
+#include "ModelCache.h"
 #include <Cesium3DTilesSelection/TilesetExternals.h>
 #include <vsg/app/WindowTraits.h>
 #include <vsg/core/Inherit.h>
@@ -143,6 +144,17 @@ namespace vsgCs
         std::string ionAccessToken;
         bool generateShaderDebugInfo = false;
         bool enableLodTransitionPeriod = false;
+        bool optimizeTileGraphs = true;
+        bool depthPrepass = false;
+        // Keep tile triangles for TerrainService queries in all tilesets, not only those added to
+        // a TerrainService
+        bool keepTileGeometry = false;
+        // Build a BVH over the kept tile triangles in the load thread
+        bool buildTileBVH = true;
+        // Draw the repeated glTF models of a GeoNode with GPU instancing
+        bool gpuInstancing = true;
+        // glTF models shared by GeoNodes and world files
+        vsg::ref_ptr<ModelCache> modelCache;
         vsg::ref_ptr<GraphicsEnvironment> genv;
         vsg::ref_ptr<TracyContextValue> tracyContext;
         bool hasProj;
@@ -0,0 +1,222 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "SessionState.h"
+
+#include "TilesetNode.h"
+#include "WorldNode.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include <vsg/app/ViewMatrix.h>
+#include <vsg/io/Logger.h>
+
+#include <fstream>
+#include <sstream>
+
+using namespace vsgCs;
+
+namespace
+{
+    std::optional<vsg::dvec3> readVec3(const rapidjson::Value& json, const char* key)
+    {
+        auto itr = json.FindMember(key);
+        if (itr == json.MemberEnd() || !itr->value.IsArray() || itr->value.Size() != 3)
+        {
+            return {};
+        }
+        vsg::dvec3 result;
+        for (rapidjson::SizeType i = 0; i < 3; ++i)
+        {
+            if (!itr->value[i].IsNumber())
+            {
+                return {};
+            }
+            result[i] = itr->value[i].GetDouble();
+        }
+        return result;
+    }
+
+    template <typename TWriter>
+    void writeVec3(TWriter& writer, const char* key, const vsg::dvec3& vec)
+    {
+        writer.Key(key);
+        writer.StartArray();
+        for (int i = 0; i < 3; ++i)
+        {
+            writer.Double(vec[i]);
+        }
+        writer.EndArray();
+    }
+}
+
+std::string SessionState::describeSource(const TilesetNode& tilesetNode)
+{
+    const auto& source = tilesetNode.getSource();
+    if (source.url)
+    {
+        return *source.url;
+    }
+    if (source.ionAssetID)
+    {
+        return "ion:" + std::to_string(*source.ionAssetID);
+    }
+    return {};
+}
+
+void SessionState::capture(WorldNode& worldNode, const vsg::LookAt& lookAt)
+{
+    camera = Camera{lookAt.eye, lookAt.center, lookAt.up};
+    tilesets.clear();
+    for (const auto& node : worldNode.tilesetNodes())
+    {
+        if (auto tilesetNode = ref_ptr_cast<TilesetNode>(node))
+        {
+            tilesets.push_back({describeSource(*tilesetNode), tilesetNode->getRenderedTileIds()});
+        }
+    }
+}
+
+void SessionState::prefetch(WorldNode& worldNode) const
+{
+    size_t i = 0;
+    for (const auto& node : worldNode.tilesetNodes())
+    {
+        auto tilesetNode = ref_ptr_cast<TilesetNode>(node);
+        if (!tilesetNode)
+        {
+            continue;
+        }
+        if (i < tilesets.size() && tilesets[i].source == describeSource(*tilesetNode))
+        {
+            tilesetNode->prefetchTiles(tilesets[i].tileIds);
+        }
+        ++i;
+    }
+}
+
+bool SessionState::read(const std::string& fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string source = buffer.str();
+    rapidjson::Document document;
+    document.Parse(source.data(), source.size());
+    if (document.HasParseError() || !document.IsObject())
+    {
+        vsg::warn("Can't parse session file ", fileName);
+        return false;
+    }
+    camera.reset();
+    tilesets.clear();
+    auto cameraItr = document.FindMember("camera");
+    if (cameraItr != document.MemberEnd() && cameraItr->value.IsObject())
+    {
+        auto eye = readVec3(cameraItr->value, "eye");
+        auto center = readVec3(cameraItr->value, "center");
+        auto up = readVec3(cameraItr->value, "up");
+        if (eye && center && up)
+        {
+            camera = Camera{*eye, *center, *up};
+        }
+    }
+    auto tilesetsItr = document.FindMember("tilesets");
+    if (tilesetsItr != document.MemberEnd() && tilesetsItr->value.IsArray())
+    {
+        for (const auto& tilesetJson : tilesetsItr->value.GetArray())
+        {
+            Tileset& tileset = tilesets.emplace_back();
+            if (!tilesetJson.IsObject())
+            {
+                continue;
+            }
+            auto sourceItr = tilesetJson.FindMember("source");
+            if (sourceItr != tilesetJson.MemberEnd() && sourceItr->value.IsString())
+            {
+                tileset.source = sourceItr->value.GetString();
+            }
+            auto tilesItr = tilesetJson.FindMember("tiles");
+            if (tilesItr != tilesetJson.MemberEnd() && tilesItr->value.IsArray())
+            {
+                for (const auto& tileId : tilesItr->value.GetArray())
+                {
+                    if (tileId.IsString())
+                    {
+                        tileset.tileIds.emplace_back(tileId.GetString());
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool SessionState::write(const std::string& fileName) const
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    if (camera)
+    {
+        writer.Key("camera");
+        writer.StartObject();
+        writeVec3(writer, "eye", camera->eye);
+        writeVec3(writer, "center", camera->center);
+        writeVec3(writer, "up", camera->up);
+        writer.EndObject();
+    }
+    writer.Key("tilesets");
+    writer.StartArray();
+    for (const auto& tileset : tilesets)
+    {
+        writer.StartObject();
+        writer.Key("source");
+        writer.String(tileset.source.c_str());
+        writer.Key("tiles");
+        writer.StartArray();
+        for (const auto& tileId : tileset.tileIds)
+        {
+            writer.String(tileId.c_str());
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    std::ofstream file(fileName);
+    if (!file)
+    {
+        vsg::warn("Can't write session file ", fileName);
+        return false;
+    }
+    file.write(buffer.GetString(), static_cast<std::streamsize>(buffer.GetSize()));
+    return static_cast<bool>(file);
+}
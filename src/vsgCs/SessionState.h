@@ -0,0 +1,76 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/maths/vec3.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vsg
+{
+    class LookAt;
+}
+
+namespace vsgCs
+{
+    class TilesetNode;
+    class WorldNode;
+
+    /**
+     * @brief The camera and drawn tiles of a viewer session, saved for a warm start of the next.
+     *
+     * The tile IDs are stored per tileset, in the order of WorldNode::tilesetNodes(), with a
+     * description of each tileset's source so that a changed world isn't given the wrong tiles.
+     */
+    struct VSGCS_EXPORT SessionState
+    {
+        struct Camera
+        {
+            vsg::dvec3 eye;
+            vsg::dvec3 center;
+            vsg::dvec3 up;
+        };
+        struct Tileset
+        {
+            std::string source;
+            std::vector<std::string> tileIds;
+        };
+        std::optional<Camera> camera;
+        std::vector<Tileset> tilesets;
+
+        /// @brief Record the camera and the tiles drawn in the last frame.
+        void capture(WorldNode& worldNode, const vsg::LookAt& lookAt);
+        /// @brief Prefetch the saved tiles of the tilesets that are still in the world.
+        void prefetch(WorldNode& worldNode) const;
+        /// @brief Read a session file; false if there is none or it can't be parsed.
+        bool read(const std::string& fileName);
+        bool write(const std::string& fileName) const;
+        static std::string describeSource(const TilesetNode& tilesetNode);
+    };
+}
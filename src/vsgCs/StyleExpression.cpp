@@ -0,0 +1,1153 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "StyleExpression.h"
+#include "Styling.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+using namespace vsgCs;
+
+const StyleColumn* StyleColumns::find(const std::string& name) const
+{
+    auto itr = columns.find(name);
+    return itr == columns.end() ? nullptr : &itr->second;
+}
+
+struct StyleExpression::Node
+{
+    enum Kind
+    {
+        NUMBER,
+        BOOLEAN,
+        STRING,
+        PROPERTY,
+        UNARY,
+        BINARY,
+        TERNARY,
+        CALL,
+        DEFAULT                 // The result of a "conditions" expression when nothing matches
+    };
+    Kind kind = NUMBER;
+    double number = 0.0;
+    bool boolean = false;
+    std::string text;           // string literal, property name, operator or function name
+    std::vector<std::shared_ptr<Node>> args;
+};
+
+namespace
+{
+    using Node = StyleExpression::Node;
+    using NodePtr = std::shared_ptr<Node>;
+
+    NodePtr makeNode(Node::Kind kind, std::string text = {}, std::vector<NodePtr> args = {})
+    {
+        auto node = std::make_shared<Node>();
+        node->kind = kind;
+        node->text = std::move(text);
+        node->args = std::move(args);
+        return node;
+    }
+
+    [[noreturn]] void expressionError(const std::string& source, const std::string& message)
+    {
+        throw std::runtime_error("style expression \"" + source + "\": " + message);
+    }
+
+    // Recursive descent parser for the expression grammar, using JavaScript's precedence.
+    class Parser
+    {
+    public:
+        Parser(const std::string& source, std::vector<std::string>& propertyNames)
+            : _source(source), _propertyNames(propertyNames)
+        {
+        }
+
+        NodePtr parse()
+        {
+            auto result = ternary();
+            skipSpace();
+            if (_pos != _source.size())
+            {
+                error("unexpected character");
+            }
+            return result;
+        }
+
+    private:
+        [[noreturn]] void error(const std::string& message)
+        {
+            expressionError(_source, message + " at position " + std::to_string(_pos));
+        }
+
+        void skipSpace()
+        {
+            while (_pos < _source.size() && std::isspace(static_cast<unsigned char>(_source[_pos])))
+            {
+                ++_pos;
+            }
+        }
+
+        bool match(std::string_view token)
+        {
+            skipSpace();
+            if (_source.compare(_pos, token.size(), token) == 0)
+            {
+                _pos += token.size();
+                return true;
+            }
+            return false;
+        }
+
+        void expect(std::string_view token)
+        {
+            if (!match(token))
+            {
+                error("expected '" + std::string(token) + "'");
+            }
+        }
+
+        NodePtr ternary()
+        {
+            auto condition = logicalOr();
+            if (match("?"))
+            {
+                auto ifTrue = ternary();
+                expect(":");
+                auto ifFalse = ternary();
+                return makeNode(Node::TERNARY, "?", {condition, ifTrue, ifFalse});
+            }
+            return condition;
+        }
+
+        NodePtr logicalOr()
+        {
+            auto lhs = logicalAnd();
+            while (match("||"))
+            {
+                auto rhs = logicalAnd();
+                lhs = makeNode(Node::BINARY, "||", {lhs, rhs});
+            }
+            return lhs;
+        }
+
+        NodePtr logicalAnd()
+        {
+            auto lhs = equality();
+            while (match("&&"))
+            {
+                auto rhs = equality();
+                lhs = makeNode(Node::BINARY, "&&", {lhs, rhs});
+            }
+            return lhs;
+        }
+
+        NodePtr equality()
+        {
+            auto lhs = relational();
+            for (;;)
+            {
+                std::string op;
+                if (match("===") || match("=="))
+                {
+                    op = "===";
+                }
+                else if (match("!==") || match("!="))
+                {
+                    op = "!==";
+                }
+                else
+                {
+                    return lhs;
+                }
+                auto rhs = relational();
+                lhs = makeNode(Node::BINARY, op, {lhs, rhs});
+            }
+        }
+
+        NodePtr relational()
+        {
+            auto lhs = additive();
+            for (;;)
+            {
+                std::string op;
+                for (const char* candidate : {"<=", ">=", "<", ">"})
+                {
+                    if (match(candidate))
+                    {
+                        op = candidate;
+                        break;
+                    }
+                }
+                if (op.empty())
+                {
+                    return lhs;
+                }
+                auto rhs = additive();
+                lhs = makeNode(Node::BINARY, op, {lhs, rhs});
+            }
+        }
+
+        NodePtr additive()
+        {
+            auto lhs = multiplicative();
+            for (;;)
+            {
+                std::string op;
+                if (match("+"))
+                {
+                    op = "+";
+                }
+                else if (match("-"))
+                {
+                    op = "-";
+                }
+                else
+                {
+                    return lhs;
+                }
+                auto rhs = multiplicative();
+                lhs = makeNode(Node::BINARY, op, {lhs, rhs});
+            }
+        }
+
+        NodePtr multiplicative()
+        {
+            auto lhs = unary();
+            for (;;)
+            {
+                std::string op;
+                for (const char* candidate : {"*", "/", "%"})
+                {
+                    if (match(candidate))
+                    {
+                        op = candidate;
+                        break;
+                    }
+                }
+                if (op.empty())
+                {
+                    return lhs;
+                }
+                auto rhs = unary();
+                lhs = makeNode(Node::BINARY, op, {lhs, rhs});
+            }
+        }
+
+        NodePtr unary()
+        {
+            if (match("!"))
+            {
+                return makeNode(Node::UNARY, "!", {unary()});
+            }
+            if (match("-"))
+            {
+                return makeNode(Node::UNARY, "-", {unary()});
+            }
+            if (match("+"))
+            {
+                return unary();
+            }
+            return primary();
+        }
+
+        NodePtr primary()
+        {
+            skipSpace();
+            if (_pos >= _source.size())
+            {
+                error("unexpected end of expression");
+            }
+            if (match("("))
+            {
+                auto result = ternary();
+                expect(")");
+                return result;
+            }
+            if (match("${"))
+            {
+                auto end = _source.find('}', _pos);
+                if (end == std::string::npos)
+                {
+                    error("unterminated property reference");
+                }
+                auto name = propertyName(_source.substr(_pos, end - _pos));
+                _pos = end + 1;
+                if (std::find(_propertyNames.begin(), _propertyNames.end(), name) == _propertyNames.end())
+                {
+                    _propertyNames.push_back(name);
+                }
+                return makeNode(Node::PROPERTY, name);
+            }
+            const char c = _source[_pos];
+            if (std::isdigit(static_cast<unsigned char>(c)) || c == '.')
+            {
+                const char* start = _source.c_str() + _pos;
+                char* end = nullptr;
+                double value = std::strtod(start, &end);
+                if (end == start)
+                {
+                    error("invalid number");
+                }
+                _pos += end - start;
+                auto result = makeNode(Node::NUMBER);
+                result->number = value;
+                return result;
+            }
+            if (c == '\'' || c == '"')
+            {
+                auto end = _source.find(c, _pos + 1);
+                if (end == std::string::npos)
+                {
+                    error("unterminated string");
+                }
+                auto result = makeNode(Node::STRING, _source.substr(_pos + 1, end - _pos - 1));
+                _pos = end + 1;
+                return result;
+            }
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                size_t end = _pos;
+                while (end < _source.size()
+                       && (std::isalnum(static_cast<unsigned char>(_source[end])) || _source[end] == '_'))
+                {
+                    ++end;
+                }
+                std::string identifier = _source.substr(_pos, end - _pos);
+                _pos = end;
+                if (identifier == "true" || identifier == "false")
+                {
+                    auto result = makeNode(Node::BOOLEAN);
+                    result->boolean = identifier == "true";
+                    return result;
+                }
+                if (!match("("))
+                {
+                    error("unknown identifier " + identifier);
+                }
+                auto call = makeNode(Node::CALL, identifier);
+                if (!match(")"))
+                {
+                    do
+                    {
+                        call->args.push_back(ternary());
+                    } while (match(","));
+                    expect(")");
+                }
+                return call;
+            }
+            error("unexpected character");
+        }
+
+        // ${name}, ${feature.name} and ${feature['name']} all refer to the property "name".
+        static std::string propertyName(std::string name)
+        {
+            const std::string featurePrefix("feature");
+            if (name.compare(0, featurePrefix.size(), featurePrefix) == 0 && name.size() > featurePrefix.size())
+            {
+                std::string rest = name.substr(featurePrefix.size());
+                if (rest[0] == '.')
+                {
+                    return rest.substr(1);
+                }
+                if (rest.size() > 4 && rest[0] == '[' && rest.back() == ']')
+                {
+                    return rest.substr(2, rest.size() - 4);
+                }
+            }
+            return name;
+        }
+
+        const std::string& _source;
+        std::vector<std::string>& _propertyNames;
+        size_t _pos = 0;
+    };
+
+    // The bytecode
+
+    enum class ValueType : uint8_t
+    {
+        NUMBER,
+        BOOLEAN,
+        STRING,
+        COLOR
+    };
+
+    const char* typeName(ValueType type)
+    {
+        static const char* names[] = {"number", "boolean", "string", "color"};
+        return names[static_cast<int>(type)];
+    }
+
+    enum class Op : uint8_t
+    {
+        LOAD_NUMBER,
+        LOAD_BOOLEAN,
+        LOAD_STRING,
+        CONST_NUMBER,
+        CONST_BOOLEAN,
+        CONST_STRING,
+        CONST_COLOR,
+        NEGATE,
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        MOD,
+        LESS,
+        LESS_EQUAL,
+        GREATER,
+        GREATER_EQUAL,
+        EQUAL_NUMBER,
+        EQUAL_BOOLEAN,
+        EQUAL_STRING,
+        EQUAL_COLOR,
+        NOT,
+        AND,
+        OR,
+        SELECT_NUMBER,
+        SELECT_BOOLEAN,
+        SELECT_STRING,
+        SELECT_COLOR,
+        ABS,
+        FLOOR,
+        CEIL,
+        ROUND,
+        SQRT,
+        POW,
+        MIN,
+        MAX,
+        CLAMP,
+        RGBA,
+        COLOR_FROM_STRING,
+        COLOR_ALPHA
+    };
+
+    // Operands are register numbers in the register bank of their type; imm indexes constants or
+    // columns.
+    struct Instruction
+    {
+        Op op;
+        uint16_t dst;
+        uint16_t a, b, c, d;
+        uint32_t imm;
+    };
+
+    struct Program
+    {
+        std::vector<Instruction> code;
+        uint16_t registerCounts[4] = {0, 0, 0, 0};
+        std::vector<double> numbers;
+        std::vector<vsg::vec4> colors;
+        std::vector<const StyleColumn*> columns;
+        // For each string column, the mapping from its dictionary to the program's string IDs
+        std::vector<std::vector<int32_t>> stringRemaps;
+        std::vector<std::string> strings;
+        std::unordered_map<std::string, int32_t> stringIDs;
+        // The color() of each string, if the program converts strings to colors
+        std::vector<vsg::vec4> stringColors;
+        bool needsStringColors = false;
+        uint16_t result = 0;
+
+        int32_t intern(const std::string& str)
+        {
+            auto [itr, inserted] = stringIDs.try_emplace(str, static_cast<int32_t>(strings.size()));
+            if (inserted)
+            {
+                strings.push_back(str);
+            }
+            return itr->second;
+        }
+    };
+
+    const vsg::vec4 white(1.0f, 1.0f, 1.0f, 1.0f);
+
+    struct Value
+    {
+        ValueType type;
+        uint16_t reg;
+    };
+
+    class Compiler
+    {
+    public:
+        Compiler(Program& program, const StyleColumns& columns, const std::string& source)
+            : _program(program), _columns(columns), _source(source)
+        {
+        }
+
+        Value compile(const Node& node, ValueType hint)
+        {
+            switch (node.kind)
+            {
+            case Node::NUMBER:
+                return constant(node.number);
+            case Node::BOOLEAN:
+                return emit(Op::CONST_BOOLEAN, ValueType::BOOLEAN, 0, 0, 0, 0, node.boolean ? 1 : 0);
+            case Node::STRING:
+                return emit(Op::CONST_STRING, ValueType::STRING, 0, 0, 0, 0,
+                            static_cast<uint32_t>(_program.intern(node.text)));
+            case Node::DEFAULT:
+                return defaultValue(hint);
+            case Node::PROPERTY:
+                return property(node.text);
+            case Node::UNARY:
+            {
+                if (node.text == "!")
+                {
+                    auto arg = compile(*node.args[0], ValueType::BOOLEAN);
+                    check(arg, ValueType::BOOLEAN, "!");
+                    return emit(Op::NOT, ValueType::BOOLEAN, arg.reg);
+                }
+                auto arg = compile(*node.args[0], ValueType::NUMBER);
+                check(arg, ValueType::NUMBER, "-");
+                return emit(Op::NEGATE, ValueType::NUMBER, arg.reg);
+            }
+            case Node::BINARY:
+                return binary(node);
+            case Node::TERNARY:
+                return ternary(node, hint);
+            case Node::CALL:
+                return call(node);
+            }
+            expressionError(_source, "invalid expression");
+        }
+
+    private:
+        Value emit(Op op, ValueType type,
+                   uint16_t a = 0, uint16_t b = 0, uint16_t c = 0, uint16_t d = 0, uint32_t imm = 0)
+        {
+            Value result{type, _program.registerCounts[static_cast<int>(type)]++};
+            _program.code.push_back({op, result.reg, a, b, c, d, imm});
+            return result;
+        }
+
+        void check(const Value& value, ValueType type, const std::string& what)
+        {
+            if (value.type != type)
+            {
+                expressionError(_source, what + " expects a " + typeName(type) + ", not a "
+                                + typeName(value.type));
+            }
+        }
+
+        Value constant(double number)
+        {
+            _program.numbers.push_back(number);
+            return emit(Op::CONST_NUMBER, ValueType::NUMBER, 0, 0, 0, 0,
+                        static_cast<uint32_t>(_program.numbers.size() - 1));
+        }
+
+        Value constant(const vsg::vec4& color)
+        {
+            _program.colors.push_back(color);
+            return emit(Op::CONST_COLOR, ValueType::COLOR, 0, 0, 0, 0,
+                        static_cast<uint32_t>(_program.colors.size() - 1));
+        }
+
+        Value defaultValue(ValueType type)
+        {
+            switch (type)
+            {
+            case ValueType::NUMBER:
+                return constant(0.0);
+            case ValueType::BOOLEAN:
+                return emit(Op::CONST_BOOLEAN, ValueType::BOOLEAN, 0, 0, 0, 0, 1);
+            case ValueType::STRING:
+                return emit(Op::CONST_STRING, ValueType::STRING, 0, 0, 0, 0,
+                            static_cast<uint32_t>(_program.intern("")));
+            case ValueType::COLOR:
+                return constant(white);
+            }
+            return constant(0.0);
+        }
+
+        Value property(const std::string& name)
+        {
+            const StyleColumn* column = _columns.find(name);
+            if (!column)
+            {
+                // An undefined property doesn't compare equal to anything.
+                return constant(std::numeric_limits<double>::quiet_NaN());
+            }
+            auto itr = std::find(_program.columns.begin(), _program.columns.end(), column);
+            auto index = static_cast<uint32_t>(itr - _program.columns.begin());
+            if (itr == _program.columns.end())
+            {
+                _program.columns.push_back(column);
+                _program.stringRemaps.emplace_back();
+                if (column->type == StyleColumn::STRING)
+                {
+                    auto& remap = _program.stringRemaps.back();
+                    remap.reserve(column->dictionary.size());
+                    for (const auto& str : column->dictionary)
+                    {
+                        remap.push_back(_program.intern(str));
+                    }
+                }
+            }
+            switch (column->type)
+            {
+            case StyleColumn::NUMBER:
+                checkSize(column->numbers.size(), name);
+                return emit(Op::LOAD_NUMBER, ValueType::NUMBER, 0, 0, 0, 0, index);
+            case StyleColumn::BOOLEAN:
+                checkSize(column->booleans.size(), name);
+                return emit(Op::LOAD_BOOLEAN, ValueType::BOOLEAN, 0, 0, 0, 0, index);
+            case StyleColumn::STRING:
+                checkSize(column->stringIDs.size(), name);
+                return emit(Op::LOAD_STRING, ValueType::STRING, 0, 0, 0, 0, index);
+            }
+            expressionError(_source, "invalid column " + name);
+        }
+
+        void checkSize(size_t size, const std::string& name)
+        {
+            if (size < _columns.size)
+            {
+                expressionError(_source, "column " + name + " is too short");
+            }
+        }
+
+        Value binary(const Node& node)
+        {
+            const std::string& op = node.text;
+            if (op == "&&" || op == "||")
+            {
+                auto lhs = compile(*node.args[0], ValueType::BOOLEAN);
+                auto rhs = compile(*node.args[1], ValueType::BOOLEAN);
+                check(lhs, ValueType::BOOLEAN, op);
+                check(rhs, ValueType::BOOLEAN, op);
+                return emit(op == "&&" ? Op::AND : Op::OR, ValueType::BOOLEAN, lhs.reg, rhs.reg);
+            }
+            if (op == "===" || op == "!==")
+            {
+                auto lhs = compile(*node.args[0], ValueType::NUMBER);
+                auto rhs = compile(*node.args[1], lhs.type);
+                Value result;
+                if (lhs.type != rhs.type)
+                {
+                    // Strict equality of different types is always false.
+                    return emit(Op::CONST_BOOLEAN, ValueType::BOOLEAN, 0, 0, 0, 0, op == "!==" ? 1 : 0);
+                }
+                static const Op equalOps[] = {Op::EQUAL_NUMBER, Op::EQUAL_BOOLEAN, Op::EQUAL_STRING, Op::EQUAL_COLOR};
+                result = emit(equalOps[static_cast<int>(lhs.type)], ValueType::BOOLEAN, lhs.reg, rhs.reg);
+                if (op == "!==")
+                {
+                    result = emit(Op::NOT, ValueType::BOOLEAN, result.reg);
+                }
+                return result;
+            }
+            auto lhs = compile(*node.args[0], ValueType::NUMBER);
+            auto rhs = compile(*node.args[1], ValueType::NUMBER);
+            if (op == "+" && (lhs.type == ValueType::STRING || rhs.type == ValueType::STRING))
+            {
+                expressionError(_source, "string concatenation is not supported");
+            }
+            check(lhs, ValueType::NUMBER, op);
+            check(rhs, ValueType::NUMBER, op);
+            static const std::map<std::string, std::pair<Op, ValueType>> ops = {
+                {"+", {Op::ADD, ValueType::NUMBER}},
+                {"-", {Op::SUBTRACT, ValueType::NUMBER}},
+                {"*", {Op::MULTIPLY, ValueType::NUMBER}},
+                {"/", {Op::DIVIDE, ValueType::NUMBER}},
+                {"%", {Op::MOD, ValueType::NUMBER}},
+                {"<", {Op::LESS, ValueType::BOOLEAN}},
+                {"<=", {Op::LESS_EQUAL, ValueType::BOOLEAN}},
+                {">", {Op::GREATER, ValueType::BOOLEAN}},
+                {">=", {Op::GREATER_EQUAL, ValueType::BOOLEAN}}};
+            auto itr = ops.find(op);
+            if (itr == ops.end())
+            {
+                expressionError(_source, "unknown operator " + op);
+            }
+            return emit(itr->second.first, itr->second.second, lhs.reg, rhs.reg);
+        }
+
+        Value ternary(const Node& node, ValueType hint)
+        {
+            auto condition = compile(*node.args[0], ValueType::BOOLEAN);
+            check(condition, ValueType::BOOLEAN, "?:");
+            Value ifTrue, ifFalse;
+            // The default of a "conditions" expression takes the type of the other branch.
+            if (node.args[1]->kind == Node::DEFAULT)
+            {
+                ifFalse = compile(*node.args[2], hint);
+                ifTrue = compile(*node.args[1], ifFalse.type);
+            }
+            else
+            {
+                ifTrue = compile(*node.args[1], hint);
+                ifFalse = compile(*node.args[2], ifTrue.type);
+            }
+            check(ifFalse, ifTrue.type, "?:");
+            static const Op selectOps[] = {Op::SELECT_NUMBER, Op::SELECT_BOOLEAN, Op::SELECT_STRING, Op::SELECT_COLOR};
+            return emit(selectOps[static_cast<int>(ifTrue.type)], ifTrue.type,
+                        condition.reg, ifTrue.reg, ifFalse.reg);
+        }
+
+        Value call(const Node& node)
+        {
+            const std::string& name = node.text;
+            const auto numArgs = node.args.size();
+            auto arity = [&](size_t expected)
+            {
+                if (numArgs != expected)
+                {
+                    expressionError(_source, name + "() expects " + std::to_string(expected) + " arguments");
+                }
+            };
+            auto numberArg = [&](size_t i)
+            {
+                auto arg = compile(*node.args[i], ValueType::NUMBER);
+                check(arg, ValueType::NUMBER, name + "()");
+                return arg.reg;
+            };
+            if (name == "color")
+            {
+                if (numArgs == 0)
+                {
+                    return constant(white);
+                }
+                if (numArgs > 2)
+                {
+                    arity(2);
+                }
+                Value color;
+                if (node.args[0]->kind == Node::STRING)
+                {
+                    auto value = parseColorString(node.args[0]->text);
+                    if (!value)
+                    {
+                        expressionError(_source, "invalid color " + node.args[0]->text);
+                    }
+                    color = constant(*value);
+                }
+                else if (node.args[0]->kind == Node::PROPERTY && !_columns.find(node.args[0]->text))
+                {
+                    // An undefined property, like an unknown color string, gives the default color.
+                    color = constant(white);
+                }
+                else
+                {
+                    auto arg = compile(*node.args[0], ValueType::STRING);
+                    check(arg, ValueType::STRING, "color()");
+                    _program.needsStringColors = true;
+                    color = emit(Op::COLOR_FROM_STRING, ValueType::COLOR, arg.reg);
+                }
+                if (numArgs == 2)
+                {
+                    auto alpha = numberArg(1);
+                    color = emit(Op::COLOR_ALPHA, ValueType::COLOR, color.reg, alpha);
+                }
+                return color;
+            }
+            if (name == "rgb" || name == "rgba")
+            {
+                arity(name == "rgb" ? 3 : 4);
+                auto r = numberArg(0);
+                auto g = numberArg(1);
+                auto b = numberArg(2);
+                auto a = name == "rgb" ? constant(1.0).reg : numberArg(3);
+                return emit(Op::RGBA, ValueType::COLOR, r, g, b, a);
+            }
+            static const std::map<std::string, std::pair<Op, size_t>> functions = {
+                {"abs", {Op::ABS, 1}},
+                {"floor", {Op::FLOOR, 1}},
+                {"ceil", {Op::CEIL, 1}},
+                {"round", {Op::ROUND, 1}},
+                {"sqrt", {Op::SQRT, 1}},
+                {"pow", {Op::POW, 2}},
+                {"min", {Op::MIN, 2}},
+                {"max", {Op::MAX, 2}},
+                {"clamp", {Op::CLAMP, 3}}};
+            auto itr = functions.find(name);
+            if (itr == functions.end())
+            {
+                expressionError(_source, "unknown function " + name);
+            }
+            arity(itr->second.second);
+            uint16_t args[3] = {0, 0, 0};
+            for (size_t i = 0; i < numArgs; ++i)
+            {
+                args[i] = numberArg(i);
+            }
+            return emit(itr->second.first, ValueType::NUMBER, args[0], args[1], args[2]);
+        }
+
+        Program& _program;
+        const StyleColumns& _columns;
+        const std::string& _source;
+    };
+
+    Program compileProgram(const Node& root, const StyleColumns& columns, ValueType type,
+                           const std::string& source)
+    {
+        Program program;
+        Compiler compiler(program, columns, source);
+        auto result = compiler.compile(root, type);
+        if (result.type != type)
+        {
+            expressionError(source, std::string("expression is a ") + typeName(result.type) + ", not a "
+                            + typeName(type));
+        }
+        program.result = result.reg;
+        if (program.needsStringColors)
+        {
+            program.stringColors.reserve(program.strings.size());
+            for (const auto& str : program.strings)
+            {
+                program.stringColors.push_back(parseColorString(str).value_or(white));
+            }
+        }
+        return program;
+    }
+
+    // The interpreter runs each instruction over a block of features, so the loops are long enough
+    // to vectorize while the registers stay in cache.
+    constexpr size_t blockSize = 1024;
+
+    struct Registers
+    {
+        explicit Registers(const Program& program)
+            : numbers(program.registerCounts[0], std::vector<double>(blockSize)),
+              booleans(program.registerCounts[1], std::vector<uint8_t>(blockSize)),
+              strings(program.registerCounts[2], std::vector<int32_t>(blockSize)),
+              colors(program.registerCounts[3], std::vector<vsg::vec4>(blockSize))
+        {
+        }
+        std::vector<std::vector<double>> numbers;
+        std::vector<std::vector<uint8_t>> booleans;
+        std::vector<std::vector<int32_t>> strings;
+        std::vector<std::vector<vsg::vec4>> colors;
+    };
+
+    template <typename TOut, typename TIn, typename F>
+    inline void apply(TOut* out, const TIn* a, size_t n, F f)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = f(a[i]);
+        }
+    }
+
+    template <typename TOut, typename TIn, typename F>
+    inline void apply(TOut* out, const TIn* a, const TIn* b, size_t n, F f)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = f(a[i], b[i]);
+        }
+    }
+
+    template <typename T>
+    inline void select(T* out, const uint8_t* condition, const T* a, const T* b, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = condition[i] ? a[i] : b[i];
+        }
+    }
+
+    // Each register is written by only one instruction, so constants are only filled in for the
+    // first block.
+    bool isConstant(Op op)
+    {
+        return op == Op::CONST_NUMBER || op == Op::CONST_BOOLEAN || op == Op::CONST_STRING
+            || op == Op::CONST_COLOR;
+    }
+
+    void execute(const Program& program, Registers& regs, size_t begin, size_t n)
+    {
+        auto num = [&regs](uint16_t reg) { return regs.numbers[reg].data(); };
+        auto boolean = [&regs](uint16_t reg) { return regs.booleans[reg].data(); };
+        auto str = [&regs](uint16_t reg) { return regs.strings[reg].data(); };
+        auto color = [&regs](uint16_t reg) { return regs.colors[reg].data(); };
+        for (const auto& inst : program.code)
+        {
+            if (begin != 0 && isConstant(inst.op))
+            {
+                continue;
+            }
+            switch (inst.op)
+            {
+            case Op::LOAD_NUMBER:
+            {
+                const double* src = program.columns[inst.imm]->numbers.data() + begin;
+                std::copy(src, src + n, num(inst.dst));
+                break;
+            }
+            case Op::LOAD_BOOLEAN:
+            {
+                const uint8_t* src = program.columns[inst.imm]->booleans.data() + begin;
+                std::copy(src, src + n, boolean(inst.dst));
+                break;
+            }
+            case Op::LOAD_STRING:
+            {
+                const int32_t* remap = program.stringRemaps[inst.imm].data();
+                apply(str(inst.dst), program.columns[inst.imm]->stringIDs.data() + begin, n,
+                      [remap](int32_t id) { return id < 0 ? -1 : remap[id]; });
+                break;
+            }
+            case Op::CONST_NUMBER:
+                std::fill_n(num(inst.dst), blockSize, program.numbers[inst.imm]);
+                break;
+            case Op::CONST_BOOLEAN:
+                std::fill_n(boolean(inst.dst), blockSize, static_cast<uint8_t>(inst.imm));
+                break;
+            case Op::CONST_STRING:
+                std::fill_n(str(inst.dst), blockSize, static_cast<int32_t>(inst.imm));
+                break;
+            case Op::CONST_COLOR:
+                std::fill_n(color(inst.dst), blockSize, program.colors[inst.imm]);
+                break;
+            case Op::NEGATE:
+                apply(num(inst.dst), num(inst.a), n, [](double a) { return -a; });
+                break;
+            case Op::ADD:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return a + b; });
+                break;
+            case Op::SUBTRACT:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return a - b; });
+                break;
+            case Op::MULTIPLY:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return a * b; });
+                break;
+            case Op::DIVIDE:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return a / b; });
+                break;
+            case Op::MOD:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n,
+                      [](double a, double b) { return std::fmod(a, b); });
+                break;
+            case Op::LESS:
+                apply(boolean(inst.dst), num(inst.a), num(inst.b), n,
+                      [](double a, double b) { return static_cast<uint8_t>(a < b); });
+                break;
+            case Op::LESS_EQUAL:
+                apply(boolean(inst.dst), num(inst.a), num(inst.b), n,
+                      [](double a, double b) { return static_cast<uint8_t>(a <= b); });
+                break;
+            case Op::GREATER:
+                apply(boolean(inst.dst), num(inst.a), num(inst.b), n,
+                      [](double a, double b) { return static_cast<uint8_t>(a > b); });
+                break;
+            case Op::GREATER_EQUAL:
+                apply(boolean(inst.dst), num(inst.a), num(inst.b), n,
+                      [](double a, double b) { return static_cast<uint8_t>(a >= b); });
+                break;
+            case Op::EQUAL_NUMBER:
+                apply(boolean(inst.dst), num(inst.a), num(inst.b), n,
+                      [](double a, double b) { return static_cast<uint8_t>(a == b); });
+                break;
+            case Op::EQUAL_BOOLEAN:
+                apply(boolean(inst.dst), boolean(inst.a), boolean(inst.b), n,
+                      [](uint8_t a, uint8_t b) { return static_cast<uint8_t>(a == b); });
+                break;
+            case Op::EQUAL_STRING:
+                // An undefined string (-1) isn't equal to anything.
+                apply(boolean(inst.dst), str(inst.a), str(inst.b), n,
+                      [](int32_t a, int32_t b) { return static_cast<uint8_t>(a == b && a >= 0); });
+                break;
+            case Op::EQUAL_COLOR:
+                apply(boolean(inst.dst), color(inst.a), color(inst.b), n,
+                      [](const vsg::vec4& a, const vsg::vec4& b) { return static_cast<uint8_t>(a == b); });
+                break;
+            case Op::NOT:
+                apply(boolean(inst.dst), boolean(inst.a), n, [](uint8_t a) { return static_cast<uint8_t>(a ^ 1); });
+                break;
+            case Op::AND:
+                apply(boolean(inst.dst), boolean(inst.a), boolean(inst.b), n,
+                      [](uint8_t a, uint8_t b) { return static_cast<uint8_t>(a & b); });
+                break;
+            case Op::OR:
+                apply(boolean(inst.dst), boolean(inst.a), boolean(inst.b), n,
+                      [](uint8_t a, uint8_t b) { return static_cast<uint8_t>(a | b); });
+                break;
+            case Op::SELECT_NUMBER:
+                select(num(inst.dst), boolean(inst.a), num(inst.b), num(inst.c), n);
+                break;
+            case Op::SELECT_BOOLEAN:
+                select(boolean(inst.dst), boolean(inst.a), boolean(inst.b), boolean(inst.c), n);
+                break;
+            case Op::SELECT_STRING:
+                select(str(inst.dst), boolean(inst.a), str(inst.b), str(inst.c), n);
+                break;
+            case Op::SELECT_COLOR:
+                select(color(inst.dst), boolean(inst.a), color(inst.b), color(inst.c), n);
+                break;
+            case Op::ABS:
+                apply(num(inst.dst), num(inst.a), n, [](double a) { return std::abs(a); });
+                break;
+            case Op::FLOOR:
+                apply(num(inst.dst), num(inst.a), n, [](double a) { return std::floor(a); });
+                break;
+            case Op::CEIL:
+                apply(num(inst.dst), num(inst.a), n, [](double a) { return std::ceil(a); });
+                break;
+            case Op::ROUND:
+                apply(num(inst.dst), num(inst.a), n, [](double a) { return std::floor(a + 0.5); });
+                break;
+            case Op::SQRT:
+                apply(num(inst.dst), num(inst.a), n, [](double a) { return std::sqrt(a); });
+                break;
+            case Op::POW:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return std::pow(a, b); });
+                break;
+            case Op::MIN:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return std::min(a, b); });
+                break;
+            case Op::MAX:
+                apply(num(inst.dst), num(inst.a), num(inst.b), n, [](double a, double b) { return std::max(a, b); });
+                break;
+            case Op::CLAMP:
+            {
+                double* out = num(inst.dst);
+                const double* a = num(inst.a);
+                const double* lo = num(inst.b);
+                const double* hi = num(inst.c);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = std::min(std::max(a[i], lo[i]), hi[i]);
+                }
+                break;
+            }
+            case Op::RGBA:
+            {
+                vsg::vec4* out = color(inst.dst);
+                const double* r = num(inst.a);
+                const double* g = num(inst.b);
+                const double* b = num(inst.c);
+                const double* a = num(inst.d);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    // NaN, e.g. from an undefined property, gives the default color.
+                    out[i] = std::isnan(r[i] + g[i] + b[i] + a[i])
+                        ? white
+                        : vsg::vec4(static_cast<float>(r[i] / 255.0), static_cast<float>(g[i] / 255.0),
+                                    static_cast<float>(b[i] / 255.0), static_cast<float>(a[i]));
+                }
+                break;
+            }
+            case Op::COLOR_FROM_STRING:
+            {
+                const vsg::vec4* stringColors = program.stringColors.data();
+                apply(color(inst.dst), str(inst.a), n,
+                      [stringColors](int32_t id) { return id < 0 ? white : stringColors[id]; });
+                break;
+            }
+            case Op::COLOR_ALPHA:
+            {
+                vsg::vec4* out = color(inst.dst);
+                const vsg::vec4* c = color(inst.a);
+                const double* a = num(inst.b);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    out[i] = std::isnan(a[i]) ? white : vsg::vec4(c[i].r, c[i].g, c[i].b, static_cast<float>(a[i]));
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    template <typename T, typename TBank>
+    void run(const Program& program, size_t size, TBank Registers::*bank, std::vector<T>& result)
+    {
+        result.resize(size);
+        Registers regs(program);
+        for (size_t begin = 0; begin < size; begin += blockSize)
+        {
+            const size_t n = std::min(blockSize, size - begin);
+            execute(program, regs, begin, n);
+            const T* src = (regs.*bank)[program.result].data();
+            std::copy(src, src + n, result.data() + begin);
+        }
+    }
+}
+
+StyleExpression::StyleExpression(const std::string& source)
+    : _source(source)
+{
+    Parser parser(_source, _propertyNames);
+    _root = parser.parse();
+}
+
+StyleExpression::StyleExpression(const std::vector<std::pair<std::string, std::string>>& conditions)
+{
+    // Build a chain of ternary expressions, ending in the default value.
+    _root = makeNode(Node::DEFAULT);
+    for (auto itr = conditions.rbegin(); itr != conditions.rend(); ++itr)
+    {
+        auto condition = Parser(itr->first, _propertyNames).parse();
+        auto value = Parser(itr->second, _propertyNames).parse();
+        _root = makeNode(Node::TERNARY, "?", {condition, value, _root});
+    }
+    for (const auto& condition : conditions)
+    {
+        if (!_source.empty())
+        {
+            _source += ", ";
+        }
+        _source += "[" + condition.first + ", " + condition.second + "]";
+    }
+}
+
+void StyleExpression::evaluate(const StyleColumns& columns, std::vector<uint8_t>& result) const
+{
+    auto program = compileProgram(*_root, columns, ValueType::BOOLEAN, _source);
+    run(program, columns.size, &Registers::booleans, result);
+}
+
+void StyleExpression::evaluate(const StyleColumns& columns, std::vector<vsg::vec4>& result) const
+{
+    auto program = compileProgram(*_root, columns, ValueType::COLOR, _source);
+    run(program, columns.size, &Registers::colors, result);
+}
+
+bool StyleExpression::evaluateBoolean() const
+{
+    StyleColumns columns;
+    columns.size = 1;
+    std::vector<uint8_t> result;
+    evaluate(columns, result);
+    return result[0] != 0;
+}
+
+vsg::vec4 StyleExpression::evaluateColor() const
+{
+    StyleColumns columns;
+    columns.size = 1;
+    std::vector<vsg::vec4> result;
+    evaluate(columns, result);
+    return result[0];
+}
@@ -0,0 +1,128 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+#include <vsg/maths/vec4.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vsgCs
+{
+    /**
+     * @brief A column of feature property values, usually read from a glTF property table.
+     *
+     * Strings are dictionary encoded: each feature holds an index into the column's dictionary,
+     * or -1 if the feature has no value. A missing number is NaN. A missing boolean evaluates as
+     * false and is marked in booleanPresent, which is empty if every feature has a value.
+     */
+    struct VSGCS_EXPORT StyleColumn
+    {
+        enum Type
+        {
+            NUMBER,
+            BOOLEAN,
+            STRING
+        };
+        Type type = NUMBER;
+        std::vector<double> numbers;
+        std::vector<uint8_t> booleans;
+        std::vector<uint8_t> booleanPresent;
+        std::vector<int32_t> stringIDs;
+        std::vector<std::string> dictionary;
+    };
+
+    /**
+     * @brief The feature property columns over which a style expression is evaluated.
+     */
+    struct VSGCS_EXPORT StyleColumns
+    {
+        size_t size = 0;
+        std::map<std::string, StyleColumn> columns;
+        const StyleColumn* find(const std::string& name) const;
+    };
+
+    /**
+     * @brief An expression in the 3D Tiles styling language.
+     *
+     * The expression is parsed once. When it is evaluated for a tile, it is compiled to a compact
+     * register bytecode against the tile's columns -- which fixes the type of each ${property}
+     * and turns string comparisons into integer comparisons -- and then run over the columns in
+     * blocks of features, one tight loop per instruction.
+     *
+     * Supported: number, string and boolean literals; ${property} (or ${feature.property});
+     * unary ! - +; * / % + -; < <= > >=; === !== == !=; && ||; ?:; and the functions color(),
+     * rgb(), rgba(), abs(), floor(), ceil(), round(), sqrt(), pow(), min(), max() and clamp().
+     * The alpha of rgba() is from 0 to 1. Colors made from undefined properties or NaN are white.
+     * Errors in the syntax or in the types of an expression throw std::runtime_error.
+     */
+    class VSGCS_EXPORT StyleExpression : public vsg::Inherit<vsg::Object, StyleExpression>
+    {
+    public:
+        explicit StyleExpression(const std::string& source);
+        /**
+         * @brief Build a "conditions" expression from pairs of (condition, result)
+         * expressions. The result of the first true condition is used; if none is true, the
+         * default value for the evaluated type (white or true) is used.
+         */
+        explicit StyleExpression(const std::vector<std::pair<std::string, std::string>>& conditions);
+
+        const std::string& getSource() const
+        {
+            return _source;
+        }
+        /// @brief Names of the feature properties used by the expression.
+        const std::vector<std::string>& getPropertyNames() const
+        {
+            return _propertyNames;
+        }
+        /// @brief True if the expression doesn't use any feature properties.
+        bool isConstant() const
+        {
+            return _propertyNames.empty();
+        }
+        /// @brief Evaluate a boolean expression, such as "show", for every feature.
+        void evaluate(const StyleColumns& columns, std::vector<uint8_t>& result) const;
+        /// @brief Evaluate a color expression for every feature.
+        void evaluate(const StyleColumns& columns, std::vector<vsg::vec4>& result) const;
+        /// @brief Evaluate an expression that doesn't use any feature properties.
+        bool evaluateBoolean() const;
+        vsg::vec4 evaluateColor() const;
+
+        struct Node;
+    protected:
+        std::string _source;
+        std::shared_ptr<Node> _root;
+        std::vector<std::string> _propertyNames;
+    };
+}
@@ -27,6 +27,7 @@ SOFTWARE.
 #include "accessorUtils.h"
 #include "jsonUtils.h"
 #include "runtimeSupport.h"
+#include "Tracing.h"
 
 #include <vsg/maths/vec4.h>
 
@@ -37,9 +38,18 @@ SOFTWARE.
 
 #include <algorithm>
 #include <charconv>
+#include <chrono>
+#include <cmath>
+#include <limits>
 #include <stdexcept>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 
 using namespace vsgCs;
 
@@ -268,17 +278,26 @@ void colorError(const std::string_view &colorSpec)
 
 std::optional<vsg::vec4> hexColor(const std::string_view &color)
 {
-    if (color.size() != 6)
+    if (color.size() != 6 && color.size() != 3)
     {
         return {};
     }
+    if (!std::all_of(color.begin(), color.end(),
+                     [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); }))
+    {
+        return {};
+    }
+    // #rgb is short for #rrggbb
+    const size_t digits = color.size() / 3;
     unsigned long vals[3];
-    for (int i = 0; i < 3; ++i)
+    for (size_t i = 0; i < 3; ++i)
     {
-        vals[i] = std::stoul(std::string(color.begin() + 2 * i,
-                                         color.begin() + 2 * (i + 1)),
-                             nullptr,
-                             16);
+        std::string hex(color.begin() + digits * i, color.begin() + digits * (i + 1));
+        if (digits == 1)
+        {
+            hex += hex;
+        }
+        vals[i] = std::stoul(hex, nullptr, 16);
     }
     return vsg::vec4(vals[0] / 255.0f, vals[1] / 255.0f, vals[2] / 255.0f, 1.0f);
 }
@@ -289,18 +308,75 @@ std::string_view makeStringView(Titr begin, Titr end)
     return std::string_view(&*begin, end - begin);
 }
 
-std::optional<vsg::vec4> parseColorString(const std::string_view &color)
+namespace
 {
-    if (color[0] == '#')
+    // A process-wide cache of parsed style values. Tilesets repeat a small set of distinct color
+    // strings across many tiles and features, so each string is parsed once. Lookups take a
+    // string_view and don't allocate.
+    class InternedParseCache
+    {
+    public:
+        template<typename F>
+        std::optional<vsg::vec4> get(const std::string_view& key, const F& parse)
+        {
+            {
+                std::shared_lock lock(_mutex);
+                auto itr = _values.find(key);
+                if (itr != _values.end())
+                {
+                    return itr->second;
+                }
+            }
+            auto value = parse(key);
+            std::unique_lock lock(_mutex);
+            // Don't let unique values, e.g. a distinct rgb() for every feature, grow the cache
+            // without limit.
+            if (_values.size() < maxEntries)
+            {
+                _values.emplace(std::string(key), value);
+            }
+            return value;
+        }
+        static constexpr size_t maxEntries = 1 << 16;
+    private:
+        struct Hash
+        {
+            using is_transparent = void;
+            size_t operator()(const std::string_view& str) const noexcept
+            {
+                return std::hash<std::string_view>()(str);
+            }
+        };
+        std::shared_mutex _mutex;
+        std::unordered_map<std::string, std::optional<vsg::vec4>, Hash, std::equal_to<>> _values;
+    };
+
+    std::optional<vsg::vec4> parseColorStringUncached(const std::string_view &color)
     {
-        return hexColor(makeStringView(color.begin() + 1, color.end()));
+        if (color.empty())
+        {
+            return {};
+        }
+        if (color[0] == '#')
+        {
+            return hexColor(color.substr(1));
+        }
+        auto w3cColor = colors.find(std::string(color));
+        if (w3cColor == colors.end())
+        {
+            return {};
+        }
+        return w3cColor->second;
     }
-    auto w3cColor = colors.find(std::string(color));
-    if (w3cColor == colors.end())
+}
+
+namespace vsgCs
+{
+    std::optional<vsg::vec4> parseColorString(const std::string_view &color)
     {
-        return {};
+        static InternedParseCache cache;
+        return cache.get(color, parseColorStringUncached);
     }
-    return w3cColor->second;
 }
 
 std::optional<vsg::vec4> parseColorSpec(const std::string_view expr)
@@ -358,7 +434,8 @@ std::optional<vsg::vec4> parseRGBSpec(const std::string_view expr)
     {
         return {};
     }
-    unsigned long vals[4] = {0, 0, 0, 255};
+    // As in style expressions, the alpha is from 0 to 1.
+    double vals[4] = {0.0, 0.0, 0.0, 1.0};
 
     if (match.second + 1 >= expr.end())
     {
@@ -369,7 +446,7 @@ std::optional<vsg::vec4> parseRGBSpec(const std::string_view expr)
     for (int i = 0; i < numVals; ++i)
     {
         char* numEnd = nullptr;
-        vals[i] = std::strtoul(valStart, &numEnd, 10);
+        vals[i] = std::strtod(valStart, &numEnd);
         // Should this check for the closing ')'?
         if (i < numVals - 1)
         {
@@ -380,11 +457,16 @@ std::optional<vsg::vec4> parseRGBSpec(const std::string_view expr)
             }
         }
     }
-    return vsg::vec4(vals[0], vals[1], vals[2], vals[3]) * (1.0f / 255.0f);
+    if (std::isnan(vals[0] + vals[1] + vals[2] + vals[3]))
+    {
+        return {};
+    }
+    return vsg::vec4(static_cast<float>(vals[0] / 255.0), static_cast<float>(vals[1] / 255.0),
+                     static_cast<float>(vals[2] / 255.0), static_cast<float>(vals[3]));
 }
 
 // Parse color expression from styling language
-std::optional<vsg::vec4> parseColorExpr(const std::string_view& expr)
+std::optional<vsg::vec4> parseColorExprUncached(const std::string_view& expr)
 {
     auto colorFuncResult = parseColorSpec(expr);
     if (colorFuncResult)
@@ -399,67 +481,384 @@ std::optional<vsg::vec4> parseColorExpr(const std::string_view& expr)
     return {};
 }
 
+std::optional<vsg::vec4> parseColorExpr(const std::string_view& expr)
+{
+    static InternedParseCache cache;
+    return cache.get(expr, parseColorExprUncached);
+}
+
 vsg::ref_ptr<Stylist> Styling::getStylist(ModelBuilder* in_modelBuilder)
 {
     return Stylist::create(this, in_modelBuilder);
 }
 
+namespace
+{
+    // An expression is a string, a boolean, or an object with a "conditions" array of
+    // [condition, expression] pairs.
+    vsg::ref_ptr<StyleExpression> readExpression(const rapidjson::Value& json, const char* name)
+    {
+        const auto itr = json.FindMember(name);
+        if (itr == json.MemberEnd())
+        {
+            return {};
+        }
+        const auto& value = itr->value;
+        try
+        {
+            if (value.IsString())
+            {
+                return StyleExpression::create(value.GetString());
+            }
+            if (value.IsBool())
+            {
+                return StyleExpression::create(value.GetBool() ? "true" : "false");
+            }
+            if (value.IsObject())
+            {
+                const auto conditionsItr = value.FindMember("conditions");
+                if (conditionsItr != value.MemberEnd() && conditionsItr->value.IsArray())
+                {
+                    std::vector<std::pair<std::string, std::string>> conditions;
+                    for (const auto& condition : conditionsItr->value.GetArray())
+                    {
+                        if (!condition.IsArray() || condition.Size() != 2
+                            || !condition[0].IsString() || !condition[1].IsString())
+                        {
+                            vsg::warn("Styling: ", name, " conditions must be pairs of strings");
+                            return {};
+                        }
+                        conditions.emplace_back(condition[0].GetString(), condition[1].GetString());
+                    }
+                    return StyleExpression::create(conditions);
+                }
+            }
+            vsg::warn("Styling: can't read ", name);
+        }
+        catch (const std::runtime_error& e)
+        {
+            vsg::warn("Styling: ", e.what());
+        }
+        return {};
+    }
+}
+
 namespace vsgCs
 {
     vsg::ref_ptr<vsg::Object> buildStyling(const rapidjson::Value& json,
                                            JSONObjectFactory*,
                                            const vsg::ref_ptr<vsg::Object>&)
     {
-        auto showStr = CesiumUtility::JsonHelpers::getStringOrDefault(json, "show", "true");
-        bool show = showStr == "true";
-        const auto colorItr = json.FindMember("color");
-        if (colorItr != json.MemberEnd() && colorItr->value.IsString())
+        auto styling = Styling::create();
+        try
         {
-            auto colorVal = parseColorExpr(colorItr->value.GetString());
-            if (colorVal)
+            if (auto show = readExpression(json, "show"))
             {
-                return Styling::create(show, *colorVal);
+                if (show->isConstant())
+                {
+                    styling->show = show->evaluateBoolean();
+                }
+                else
+                {
+                    styling->showExpression = show;
+                }
+            }
+            if (auto color = readExpression(json, "color"))
+            {
+                if (color->isConstant())
+                {
+                    styling->color = color->evaluateColor();
+                }
+                else
+                {
+                    styling->colorExpression = color;
+                }
             }
-            vsg::info("Couldn't parse color ", colorItr->value.IsString());
         }
-        return Styling::create(show);
+        catch (const std::runtime_error& e)
+        {
+            vsg::warn("Styling: ", e.what());
+        }
+        return styling;
     }
 }
 
-Stylist::Stylist(Styling* in_styling, ModelBuilder* builder)
-    : styling(in_styling), modelBuilder(builder), propertyTableID(0)
+namespace
+{
+    // Read a column used by style expressions from a property table. Strings are dictionary
+    // encoded and missing values become NaN, false or the undefined string.
+    void readStyleColumn(CesiumGltf::PropertyTableView& view, const std::string& name,
+                         const std::vector<uint8_t>& referenced, StyleColumns& columns)
+    {
+        // Features that no primitive refers to are treated as missing values.
+        auto isReferenced = [&referenced](int64_t i)
+        {
+            return referenced.empty() || referenced[i];
+        };
+        view.getPropertyView(
+            name,
+            [&columns, &name, &isReferenced](auto&&, auto propertyView)
+            {
+                if (propertyView.status() != CesiumGltf::PropertyTablePropertyViewStatus::Valid)
+                {
+                    return;
+                }
+                using ValueType = typename decltype(propertyView.get(0))::value_type;
+                const int64_t size = std::min(propertyView.size(), static_cast<int64_t>(columns.size));
+                if constexpr (std::is_same_v<ValueType, bool>)
+                {
+                    auto& column = columns.columns[name];
+                    column.type = StyleColumn::BOOLEAN;
+                    column.booleans.resize(columns.size);
+                    column.booleanPresent.resize(columns.size);
+                    for (int64_t i = 0; i < size; ++i)
+                    {
+                        auto value = isReferenced(i) ? propertyView.get(i) : std::nullopt;
+                        column.booleans[i] = value && *value;
+                        column.booleanPresent[i] = value.has_value();
+                    }
+                }
+                else if constexpr (std::is_arithmetic_v<ValueType>)
+                {
+                    auto& column = columns.columns[name];
+                    column.type = StyleColumn::NUMBER;
+                    column.numbers.resize(columns.size, std::numeric_limits<double>::quiet_NaN());
+                    for (int64_t i = 0; i < size; ++i)
+                    {
+                        auto value = isReferenced(i) ? propertyView.get(i) : std::nullopt;
+                        column.numbers[i] = value ? static_cast<double>(*value)
+                            : std::numeric_limits<double>::quiet_NaN();
+                    }
+                }
+                else if constexpr (std::is_same_v<ValueType, std::string_view>)
+                {
+                    auto& column = columns.columns[name];
+                    column.type = StyleColumn::STRING;
+                    column.stringIDs.resize(columns.size, -1);
+                    std::unordered_map<std::string_view, int32_t> ids;
+                    for (int64_t i = 0; i < size; ++i)
+                    {
+                        auto value = isReferenced(i) ? propertyView.get(i) : std::nullopt;
+                        if (!value)
+                        {
+                            column.stringIDs[i] = -1;
+                            continue;
+                        }
+                        auto [itr, inserted]
+                            = ids.try_emplace(*value, static_cast<int32_t>(column.dictionary.size()));
+                        if (inserted)
+                        {
+                            column.dictionary.emplace_back(*value);
+                        }
+                        column.stringIDs[i] = itr->second;
+                    }
+                }
+            });
+    }
+
+    // The per-feature colors of the CS_3DTiles_styling extension
+    const std::string cesiumColorProperty("cesium#color");
+}
+
+FeatureTable::FeatureTable(int64_t in_propertyTableID, size_t in_numFeatures)
+    : propertyTableID(in_propertyTableID), numFeatures(in_numFeatures)
+{
+    columns.size = numFeatures;
+    palette = vsg::vec4Array::create(numFeatures + 1);
+    palette->properties.dataVariance = vsg::DYNAMIC_DATA;
+    std::fill(palette->begin(), palette->end(), colorWhite);
+}
+
+void FeatureTable::readColumns(const CesiumGltf::Model& model, const std::vector<std::string>& names)
 {
     using namespace CesiumGltf;
-    auto* metadata =
-        builder->_model->getExtension<ExtensionModelExtStructuralMetadata>();
-    if (!metadata)
+    const auto* metadata = model.getExtension<ExtensionModelExtStructuralMetadata>();
+    if (!metadata || !Model::getSafe(&metadata->propertyTables, static_cast<int32_t>(propertyTableID)))
     {
         return;
     }
-    auto schema = metadata->schema;
-    if (!schema)
+    std::optional<PropertyTableView> view;
+    std::unique_lock lock(columnsMutex);
+    for (const auto& name : names)
     {
-        return;
+        if (!readNames.insert(name).second)
+        {
+            continue;
+        }
+        if (!view)
+        {
+            view.emplace(model, metadata->propertyTables[propertyTableID]);
+        }
+        readStyleColumn(*view, name, referenced, columns);
     }
-    const std::unordered_map<std::string, Class>& classes = schema->classes;
-    auto classItr = classes.find("default");
-    if (classItr == classes.end())
+}
+
+std::vector<std::string> FeatureTable::getPropertyNames(const Styling& styling)
+{
+    std::vector<std::string> names;
+    for (const auto& expression : {styling.showExpression, styling.colorExpression})
     {
-        return;
+        if (expression)
+        {
+            const auto& expressionNames = expression->getPropertyNames();
+            names.insert(names.end(), expressionNames.begin(), expressionNames.end());
+        }
     }
-    const Class& defaultClass = classItr->second;
-    const std::unordered_map<std::string, ClassProperty>& properties = defaultClass.properties;
-    auto classPropertyItr = properties.find("cesium#color");
-    if (classPropertyItr == properties.end())
+    // A style color overrides the per-feature colors.
+    if (!styling.colorExpression && !styling.color)
     {
-        return;
+        names.push_back(cesiumColorProperty);
     }
-    const ClassProperty& property = classPropertyItr->second;
-    if (property.type != "STRING")
+    return names;
+}
+
+void FeatureTable::evaluate(const Styling& styling, std::vector<vsg::vec4>& colors) const
+{
+    std::shared_lock lock(columnsMutex);
+    const vsg::vec4 defaultColor = styling.color ? *styling.color : colorWhite;
+    std::vector<uint8_t> show;
+    if (styling.colorExpression)
     {
-        return;
+        styling.colorExpression->evaluate(columns, colors);
+    }
+    else if (styling.color)
+    {
+        colors.assign(numFeatures, defaultColor);
+    }
+    else if (const auto* cesiumColors = columns.find(cesiumColorProperty);
+             cesiumColors && cesiumColors->type == StyleColumn::STRING)
+    {
+        // Only the distinct strings need to be parsed.
+        std::vector<vsg::vec4> dictionaryColors;
+        dictionaryColors.reserve(cesiumColors->dictionary.size());
+        for (const auto& colorString : cesiumColors->dictionary)
+        {
+            auto color = colorString == "null" ? std::optional<vsg::vec4>() : parseColorExpr(colorString);
+            if (!color && colorString != "null")
+            {
+                vsg::warn("invalid color string ", colorString);
+            }
+            dictionaryColors.push_back(color.value_or(colorWhite));
+        }
+        colors.resize(numFeatures);
+        for (size_t i = 0; i < numFeatures; ++i)
+        {
+            const int32_t id = cesiumColors->stringIDs[i];
+            colors[i] = id < 0 ? colorWhite : dictionaryColors[id];
+        }
+    }
+    else
+    {
+        colors.assign(numFeatures, defaultColor);
+    }
+    if (styling.showExpression)
+    {
+        styling.showExpression->evaluate(columns, show);
+    }
+    colors.resize(numFeatures + 1);
+    for (size_t i = 0; i < numFeatures; ++i)
+    {
+        if (!(show.empty() ? styling.show : show[i] != 0))
+        {
+            colors[i].a = -1.0f;
+        }
+    }
+    colors[numFeatures] = defaultColor;
+}
+
+vsg::ref_ptr<FeatureIndex> FeatureTable::getIndex(const CesiumGltf::Model& model, const std::string& name)
+{
+    auto itr = indexes.find(name);
+    if (itr != indexes.end())
+    {
+        return itr->second;
+    }
+    readColumns(model, {name});
+    vsg::ref_ptr<FeatureIndex> index;
+    if (const auto* column = columns.find(name))
+    {
+        index = FeatureIndex::create(*column, numFeatures);
+    }
+    indexes[name] = index;
+    return index;
+}
+
+void FeatureTable::select(const CesiumGltf::Model& model, const StyleExpression& predicate,
+                          std::vector<uint32_t>& featureIds)
+{
+    readColumns(model, predicate.getPropertyNames());
+    std::vector<uint8_t> selected;
+    {
+        std::shared_lock lock(columnsMutex);
+        predicate.evaluate(columns, selected);
+    }
+    featureIds.clear();
+    for (size_t i = 0; i < selected.size(); ++i)
+    {
+        if (selected[i] && (referenced.empty() || referenced[i]))
+        {
+            featureIds.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+std::map<std::string, std::string> FeatureTable::getFeatureProperties(const CesiumGltf::Model& model,
+                                                                      int64_t propertyTableID,
+                                                                      int64_t featureId)
+{
+    using namespace CesiumGltf;
+    std::map<std::string, std::string> result;
+    const auto* metadata = model.getExtension<ExtensionModelExtStructuralMetadata>();
+    const auto* propertyTable = metadata
+        ? Model::getSafe(&metadata->propertyTables, static_cast<int32_t>(propertyTableID))
+        : nullptr;
+    if (!propertyTable || featureId < 0 || featureId >= propertyTable->count)
+    {
+        return result;
     }
+    PropertyTableView view(model, *propertyTable);
+    view.forEachProperty(
+        [&result, featureId](const std::string& name, auto propertyView)
+        {
+            if (propertyView.status() != PropertyTablePropertyViewStatus::Valid)
+            {
+                return;
+            }
+            using ValueType = typename decltype(propertyView.get(0))::value_type;
+            auto value = propertyView.get(featureId);
+            if (!value)
+            {
+                return;
+            }
+            if constexpr (std::is_same_v<ValueType, bool>)
+            {
+                result[name] = *value ? "true" : "false";
+            }
+            else if constexpr (std::is_arithmetic_v<ValueType>)
+            {
+                std::ostringstream stream;
+                stream << +*value;
+                result[name] = stream.str();
+            }
+            else if constexpr (std::is_same_v<ValueType, std::string_view>)
+            {
+                result[name] = std::string(*value);
+            }
+        });
+    return result;
+}
 
+Stylist::Stylist(Styling* in_styling, ModelBuilder* builder)
+    : styling(in_styling), modelBuilder(builder)
+{
+    using namespace CesiumGltf;
+    auto* metadata =
+        builder->_model->getExtension<ExtensionModelExtStructuralMetadata>();
+    if (!metadata || metadata->propertyTables.empty())
+    {
+        return;
+    }
+    // Use the property table of the "default" class if there is one.
     auto propertyTableItr = std::find_if(metadata->propertyTables.begin(), metadata->propertyTables.end(),
                                          [](const PropertyTable& propTable)
                                          {
@@ -467,32 +866,38 @@ Stylist::Stylist(Styling* in_styling, ModelBuilder* builder)
                                          });
     if (propertyTableItr == metadata->propertyTables.end())
     {
-        return;
+        propertyTableItr = metadata->propertyTables.begin();
     }
-    PropertyTableView view(*builder->_model, *propertyTableItr);
+    featureTable = FeatureTable::create(propertyTableItr - metadata->propertyTables.begin(),
+                                        static_cast<size_t>(std::max(propertyTableItr->count, int64_t(0))));
+    featureTable->referenced.resize(featureTable->numFeatures, 0);
+}
 
-    auto propertyView = view.getPropertyView<std::string_view>("cesium#color");
-    if (propertyView.status() != PropertyTablePropertyViewStatus::Valid)
+void Stylist::finish()
+{
+    if (!featureTable)
     {
-        vsg::debug("empty cesium#color property view ", propertyView.status());
         return;
     }
-    for (int64_t i = 0; i < propertyView.size(); ++i)
+    VSGCS_ZONESCOPEDN("Stylist finish");
+    const auto startTime = vsg::clock::now();
+    // Only the features used by the primitives, now known, are read and styled.
+    featureTable->readColumns(*modelBuilder->_model, FeatureTable::getPropertyNames(*styling));
+    std::vector<vsg::vec4> colors;
+    try
     {
-        auto val = propertyView.get(i);
-        if (val && *val != "null")
-        {
-            if (featureColors.empty())
-            {
-                featureColors.resize(propertyView.size());
-            }
-            featureColors[i] = parseColorExpr(*val);
-            if (!featureColors[i])
-            {
-                vsg::warn("invalid color string ", *val);
-            }
-        }
+        featureTable->evaluate(*styling, colors);
+        std::copy(colors.begin(), colors.end(), featureTable->palette->begin());
+    }
+    catch (const std::runtime_error& e)
+    {
+        vsg::warn("Styling: ", e.what());
     }
+    featureTable->styling = styling;
+    const auto numReferenced = std::count(featureTable->referenced.begin(), featureTable->referenced.end(), 1);
+    vsg::debug("Styling ", modelBuilder->_name, ": ", numReferenced, " of ", featureTable->numFeatures,
+               " features in ",
+               std::chrono::duration<double, std::milli>(vsg::clock::now() - startTime).count(), " ms");
 }
 
 Stylist::PrimitiveStyling Stylist::getStyling(const CesiumGltf::MeshPrimitive *prim)
@@ -503,12 +908,11 @@ Stylist::PrimitiveStyling Stylist::getStyling(const CesiumGltf::MeshPrimitive *p
     {
         result.colors = vsg::vec4Value::create(*styling->color);
         result.vertexRate = VK_VERTEX_INPUT_RATE_INSTANCE;
-        return result;
     }
     const auto* primExtFeatureMetadata
         = prim->getExtension<CesiumGltf::ExtensionExtMeshFeatures>();
     if (!primExtFeatureMetadata
-        || featureColors.empty()
+        || !featureTable
         || primExtFeatureMetadata->featureIds.empty())
     {
         return result;
@@ -517,7 +921,8 @@ Stylist::PrimitiveStyling Stylist::getStyling(const CesiumGltf::MeshPrimitive *p
     auto fIDIter = std::find_if(primExtFeatureMetadata->featureIds.begin(),
                                 primExtFeatureMetadata->featureIds.end(),
                                 [this](auto&& fid) {
-                                    return fid.propertyTable >= 0 && fid.propertyTable == propertyTableID;
+                                    return fid.propertyTable >= 0
+                                        && fid.propertyTable == featureTable->propertyTableID;
                                     });
     if (fIDIter == primExtFeatureMetadata->featureIds.end())
     {
@@ -536,28 +941,45 @@ Stylist::PrimitiveStyling Stylist::getStyling(const CesiumGltf::MeshPrimitive *p
         vsg::info("No feature accessor: ", *featureID.attribute);
         return result;
     }
-    auto colorResult = CesiumGltf::createAccessorView(
+    const auto& palette = featureTable->palette;
+    // Vertices without a valid feature ID use the last entry of the palette.
+    const size_t defaultIndex = palette->size() - 1;
+    auto makeFeatureIds = [&](auto featureIds, auto&& featureView)
+    {
+        for (int i = 0; i < featureView.size(); ++i)
+        {
+            const auto featureIDNum = static_cast<int64_t>(featureView[i].value[0]);
+            size_t index = defaultIndex;
+            if (!(featureID.nullFeatureId && featureIDNum == *featureID.nullFeatureId)
+                && featureIDNum >= 0 && static_cast<size_t>(featureIDNum) < defaultIndex)
+            {
+                index = static_cast<size_t>(featureIDNum);
+                featureTable->referenced[index] = 1;
+            }
+            (*featureIds)[i] = static_cast<std::decay_t<decltype((*featureIds)[i])>>(index);
+        }
+        return vsg::ref_ptr<vsg::Data>(featureIds);
+    };
+    result.featureIds = CesiumGltf::createAccessorView(
         *modelBuilder->_model,
         *featureAccessor,
-        [this, &featureID](auto&& featureView)
+        [&](auto&& featureView)
         {
-            auto result = vsg::vec4Array::create(featureView.size());
-            for (int i = 0; i < featureView.size(); ++i)
+            const auto size = static_cast<size_t>(std::max(featureView.size(), int64_t(0)));
+            if (palette->size() <= std::numeric_limits<uint16_t>::max())
             {
-                auto featureIDNum = featureView[i].value[0];
-                if ((featureID.nullFeatureId && static_cast<int64_t>(featureIDNum)
-                     == *featureID.nullFeatureId)
-                    || !featureColors.at(static_cast<size_t>(featureIDNum)))
-                {
-                    (*result)[i] = colorWhite;
-                }
-                else
-                {
-                    (*result)[i] = *featureColors.at(static_cast<size_t>(featureIDNum));
-                }
+                auto featureIds = vsg::ushortArray::create(size);
+                featureIds->properties.format = VK_FORMAT_R16_UINT;
+                return makeFeatureIds(featureIds, featureView);
             }
-            return result;
+            auto featureIds = vsg::uintArray::create(size);
+            featureIds->properties.format = VK_FORMAT_R32_UINT;
+            return makeFeatureIds(featureIds, featureView);
         });
-    result.colors = colorResult;
+    // Only the palette colors the primitive, and hidden features are discarded in the vertex
+    // shader, so the primitive is kept for later restyling.
+    result.show = true;
+    result.colors = {};
+    result.vertexRate = VK_VERTEX_INPUT_RATE_VERTEX;
     return result;
 }
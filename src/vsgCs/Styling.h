@@ -23,17 +23,32 @@ SOFTWARE.
 </editor-fold> */
 #pragma once
 
-// A very preliminary implementation of 3D Tiles styling. No JavaScript
-// expressions yet.
+// A preliminary implementation of 3D Tiles styling. "show" and "color" can be expressions in the
+// styling language; see StyleExpression.h.
 
+#include "FeatureIndex.h"
 #include "ModelBuilder.h"
+#include "StyleExpression.h"
+
+#include <CesiumGltf/Model.h>
 
 #include <vsg/core/Object.h>
 #include <vsg/core/Inherit.h>
 
+#include <map>
 #include <optional>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace vsgCs
 {
+    /**
+     * @brief Parse a CSS color: a name or #rgb / #rrggbb.
+     */
+    std::optional<vsg::vec4> parseColorString(const std::string_view& color);
 
     class Stylist;
 
@@ -50,6 +65,60 @@ namespace vsgCs
         virtual vsg::ref_ptr<Stylist> getStylist(ModelBuilder* in_modelBuilder);
         bool show;
         std::optional<vsg::vec4> color;
+        // Expressions that depend on feature properties. Constant expressions are evaluated into
+        // show and color instead.
+        vsg::ref_ptr<StyleExpression> showExpression;
+        vsg::ref_ptr<StyleExpression> colorExpression;
+    };
+
+    /**
+     * @brief The feature properties of a model (tile) and the palette of styled feature colors.
+     *
+     * The palette has an entry for each feature and a final entry for vertices without a
+     * feature. Hidden features have a negative alpha. Primitives get a compact feature ID vertex
+     * attribute that indexes the palette in the vertex shader, so a tile can be restyled by
+     * rewriting its palette.
+     *
+     * The property columns used by styles and queries are kept, with the tile, so that restyling
+     * and querying don't need to read them again. Feature IDs are rows of the property table. The
+     * table is created in a load thread; afterwards it belongs to the main thread, except that
+     * evaluate() may run in a worker thread.
+     */
+    class VSGCS_EXPORT FeatureTable : public vsg::Inherit<vsg::Object, FeatureTable>
+    {
+    public:
+        FeatureTable(int64_t in_propertyTableID, size_t in_numFeatures);
+        /// @brief Read the named properties that haven't been read yet.
+        void readColumns(const CesiumGltf::Model& model, const std::vector<std::string>& names);
+        /// @brief The properties that a styling needs.
+        static std::vector<std::string> getPropertyNames(const Styling& styling);
+        /// @brief Evaluate a styling into palette colors. Throws std::runtime_error.
+        void evaluate(const Styling& styling, std::vector<vsg::vec4>& colors) const;
+        /// @brief The index of a property, built when first needed. Returns null if the
+        /// property doesn't exist.
+        vsg::ref_ptr<FeatureIndex> getIndex(const CesiumGltf::Model& model, const std::string& name);
+        /// @brief Select the features for which a boolean expression is true. Throws
+        /// std::runtime_error.
+        void select(const CesiumGltf::Model& model, const StyleExpression& predicate,
+                    std::vector<uint32_t>& featureIds);
+        /// @brief All the scalar, boolean and string properties of a feature, as strings.
+        static std::map<std::string, std::string> getFeatureProperties(const CesiumGltf::Model& model,
+                                                                       int64_t propertyTableID,
+                                                                       int64_t featureId);
+        int64_t propertyTableID;
+        size_t numFeatures;
+        StyleColumns columns;
+        std::set<std::string> readNames;
+        // Nonzero for the features used by the model's primitives; only they are read. Empty
+        // means all features are used.
+        std::vector<uint8_t> referenced;
+        std::map<std::string, vsg::ref_ptr<FeatureIndex>> indexes;
+        // Guards columns against reading while evaluate() runs in a worker thread
+        mutable std::shared_mutex columnsMutex;
+        vsg::ref_ptr<vsg::vec4Array> palette;
+        // The styling that the palette holds, and the styling being evaluated for it, if any
+        vsg::ref_ptr<Styling> styling;
+        vsg::ref_ptr<Styling> pendingStyling;
     };
 
     /**
@@ -66,12 +135,18 @@ namespace vsgCs
         {
             bool show = true;
             vsg::ref_ptr<vsg::Data> colors;
+            // Per-vertex indices into the palette, a ushortArray or uintArray
+            vsg::ref_ptr<vsg::Data> featureIds;
             VkVertexInputRate vertexRate = VK_VERTEX_INPUT_RATE_VERTEX;
         };
         PrimitiveStyling getStyling(const CesiumGltf::MeshPrimitive* primitive);
+        /**
+         * @brief Read the feature properties used by the styling and fill in the palette. Call
+         * after getStyling() has been called for all the model's primitives.
+         */
+        void finish();
 
         ModelBuilder* modelBuilder;
-        int64_t propertyTableID;
-        std::vector<std::optional<vsg::vec4>> featureColors;
+        vsg::ref_ptr<FeatureTable> featureTable;
     };
 }
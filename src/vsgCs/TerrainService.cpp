@@ -0,0 +1,290 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "TerrainService.h"
+
+#include "CesiumGltfBuilder.h"
+#include "Geodetic.h"
+#include "LoadGltfResult.h"
+#include "OpThreadTaskProcessor.h"
+#include "RuntimeEnvironment.h"
+#include "TilesetNode.h"
+#include "Tracing.h"
+
+#include <algorithm>
+
+using namespace vsgCs;
+
+namespace
+{
+    struct UpdateTerrainService : public vsg::Inherit<vsg::Operation, UpdateTerrainService>
+    {
+        explicit UpdateTerrainService(const vsg::ref_ptr<TerrainService>& in_service)
+            : service(in_service)
+        {}
+        void run() override
+        {
+            if (vsg::ref_ptr<TerrainService> ref = service)
+            {
+                ref->update();
+            }
+        }
+        vsg::observer_ptr<TerrainService> service;
+    };
+}
+
+void TerrainService::addTileset(const vsg::ref_ptr<TilesetNode>& tilesetNode)
+{
+    tilesetNode->setKeepTileGeometry(true, RuntimeEnvironment::get()->buildTileBVH);
+    _tilesets.emplace_back(tilesetNode);
+}
+
+void TerrainService::removeTileset(const vsg::ref_ptr<TilesetNode>& tilesetNode)
+{
+    std::erase_if(_tilesets,
+                  [&tilesetNode](const vsg::observer_ptr<TilesetNode>& observer)
+                  {
+                      return vsg::ref_ptr<TilesetNode>(observer) == tilesetNode;
+                  });
+    tilesetNode->setKeepTileGeometry(RuntimeEnvironment::get()->keepTileGeometry,
+                                     RuntimeEnvironment::get()->buildTileBVH);
+}
+
+void TerrainService::attach(const vsg::ref_ptr<vsg::Viewer>& viewer)
+{
+    vsg::ref_ptr<TerrainService> ref(this);
+    viewer->addUpdateOperation(UpdateTerrainService::create(ref), vsg::UpdateOperations::ALL_FRAMES);
+}
+
+void TerrainService::update()
+{
+    VSGCS_ZONESCOPED;
+    auto snapshot = std::make_shared<Snapshot>();
+    std::erase_if(_tilesets,
+                  [](const vsg::observer_ptr<TilesetNode>& observer)
+                  {
+                      return !vsg::ref_ptr<TilesetNode>(observer);
+                  });
+    for (const auto& observer : _tilesets)
+    {
+        vsg::ref_ptr<TilesetNode> tilesetNode = observer;
+        auto* tileset = tilesetNode->getTileset();
+        if (!tileset)
+        {
+            continue;
+        }
+        tileset->forEachLoadedTile(
+            [&snapshot](Cesium3DTilesSelection::Tile& tile)
+            {
+                const auto& content = tile.getContent();
+                if (!content.isRenderContent() || !content.getRenderContent()->getRenderResources())
+                {
+                    return;
+                }
+                const auto* renderResources
+                    = reinterpret_cast<const RenderResources*>(content.getRenderContent()->getRenderResources());
+                if (auto geometry = CesiumGltfBuilder::getTileGeometry(renderResources->model))
+                {
+                    snapshot->push_back({geometry, tile.getGeometricError()});
+                }
+            });
+    }
+    // The loaded tiles rarely change from one frame to the next; keep the old snapshot then.
+    std::sort(snapshot->begin(), snapshot->end(),
+              [](const TerrainTile& lhs, const TerrainTile& rhs)
+              {
+                  return lhs.geometry.get() < rhs.geometry.get();
+              });
+    auto current = getSnapshot();
+    if (current
+        && std::equal(current->begin(), current->end(), snapshot->begin(), snapshot->end(),
+                      [](const TerrainTile& lhs, const TerrainTile& rhs)
+                      {
+                          return lhs.geometry == rhs.geometry;
+                      }))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_snapshotMutex);
+    _snapshot = std::move(snapshot);
+}
+
+std::shared_ptr<const TerrainService::Snapshot> TerrainService::getSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(_snapshotMutex);
+    return _snapshot;
+}
+
+size_t TerrainService::getNumTiles() const
+{
+    auto snapshot = getSnapshot();
+    return snapshot ? snapshot->size() : 0;
+}
+
+std::optional<TerrainService::Hit>
+TerrainService::intersect(const Snapshot& snapshot, const vsg::dvec3& start, const vsg::dvec3& end)
+{
+    std::vector<std::pair<double, Hit>> hits;
+    for (const auto& tile : snapshot)
+    {
+        if (auto hit = tile.geometry->intersect(start, end))
+        {
+            hits.emplace_back(hit->ratio, Hit{hit->position, hit->normal, tile.geometricError});
+        }
+    }
+    if (hits.empty())
+    {
+        return {};
+    }
+    std::sort(hits.begin(), hits.end(),
+              [](const auto& lhs, const auto& rhs)
+              {
+                  return lhs.first < rhs.first;
+              });
+    // A tile's surface is within its geometric error of the real surface, so a hit on a finer
+    // tile near the closest hit is a better answer for the same spot. Finer hits further away
+    // are on some other surface that the coarse tile hides.
+    Hit best = hits[0].second;
+    for (size_t i = 1; i < hits.size(); ++i)
+    {
+        const Hit& hit = hits[i].second;
+        if (hit.geometricError < best.geometricError
+            && vsg::length(hit.position - best.position) <= best.geometricError)
+        {
+            best = hit;
+        }
+    }
+    return best;
+}
+
+std::optional<TerrainService::Hit> TerrainService::intersect(const vsg::dvec3& start, const vsg::dvec3& end) const
+{
+    auto snapshot = getSnapshot();
+    if (!snapshot)
+    {
+        return {};
+    }
+    return intersect(*snapshot, start, end);
+}
+
+void TerrainService::intersect(std::span<const Segment> segments, std::span<std::optional<Hit>> hits) const
+{
+    VSGCS_ZONESCOPED;
+    auto snapshot = getSnapshot();
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        hits[i] = snapshot ? intersect(*snapshot, segments[i].start, segments[i].end) : std::optional<Hit>();
+    }
+}
+
+std::optional<double> TerrainService::getHeight(double longitude, double latitude) const
+{
+    std::optional<double> height;
+    vsg::dvec2 lonLat(longitude, latitude);
+    getHeights({&lonLat, 1}, {&height, 1});
+    return height;
+}
+
+void TerrainService::getHeights(std::span<const vsg::dvec2> lonLats, std::span<std::optional<double>> heights) const
+{
+    auto snapshot = getSnapshot();
+    getHeights(snapshot.get(), minHeight, maxHeight, lonLats, heights);
+}
+
+void TerrainService::getHeights(const Snapshot* snapshot, double lowest, double highest,
+                                std::span<const vsg::dvec2> lonLats, std::span<std::optional<double>> heights)
+{
+    VSGCS_ZONESCOPED;
+    // Intersect vertical segments through the range of heights.
+    std::vector<vsg::dvec3> tops(lonLats.size());
+    std::vector<vsg::dvec3> bottoms(lonLats.size());
+    for (size_t i = 0; i < lonLats.size(); ++i)
+    {
+        tops[i] = vsg::dvec3(lonLats[i].x, lonLats[i].y, highest);
+        bottoms[i] = vsg::dvec3(lonLats[i].x, lonLats[i].y, lowest);
+    }
+    geodeticToECEF(tops, tops);
+    geodeticToECEF(bottoms, bottoms);
+    std::vector<size_t> hitIndices;
+    std::vector<vsg::dvec3> hitPositions;
+    for (size_t i = 0; i < lonLats.size(); ++i)
+    {
+        heights[i].reset();
+        if (!snapshot)
+        {
+            continue;
+        }
+        if (auto hit = intersect(*snapshot, tops[i], bottoms[i]))
+        {
+            hitIndices.push_back(i);
+            hitPositions.push_back(hit->position);
+        }
+    }
+    ecefToGeodetic(hitPositions, hitPositions);
+    for (size_t i = 0; i < hitIndices.size(); ++i)
+    {
+        heights[hitIndices[i]] = hitPositions[i].z;
+    }
+}
+
+CesiumAsync::Future<std::optional<TerrainService::Hit>>
+TerrainService::intersectAsync(const vsg::dvec3& start, const vsg::dvec3& end) const
+{
+    return getAsyncSystem().runInWorkerThread(
+        [snapshot = getSnapshot(), start, end]()
+        {
+            return snapshot ? intersect(*snapshot, start, end) : std::optional<Hit>();
+        });
+}
+
+CesiumAsync::Future<std::vector<std::optional<TerrainService::Hit>>>
+TerrainService::intersectAsync(std::vector<Segment> segments) const
+{
+    return getAsyncSystem().runInWorkerThread(
+        [snapshot = getSnapshot(), segments = std::move(segments)]()
+        {
+            VSGCS_ZONESCOPEDN("intersect async");
+            std::vector<std::optional<Hit>> hits(segments.size());
+            if (snapshot)
+            {
+                for (size_t i = 0; i < segments.size(); ++i)
+                {
+                    hits[i] = intersect(*snapshot, segments[i].start, segments[i].end);
+                }
+            }
+            return hits;
+        });
+}
+
+CesiumAsync::Future<std::vector<std::optional<double>>>
+TerrainService::getHeightsAsync(std::vector<vsg::dvec2> lonLats) const
+{
+    return getAsyncSystem().runInWorkerThread(
+        [snapshot = getSnapshot(), lonLats = std::move(lonLats), lowest = minHeight, highest = maxHeight]()
+        {
+            std::vector<std::optional<double>> heights(lonLats.size());
+            getHeights(snapshot.get(), lowest, highest, lonLats, heights);
+            return heights;
+        });
+}
@@ -0,0 +1,121 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+#include "TileGeometry.h"
+
+#include <CesiumAsync/Future.h>
+#include <vsg/app/Viewer.h>
+#include <vsg/core/Inherit.h>
+#include <vsg/core/observer_ptr.h>
+#include <vsg/maths/vec2.h>
+#include <vsg/maths/vec3.h>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace vsgCs
+{
+    class TilesetNode;
+
+    /**
+     * @brief Height and intersection queries against the tiles currently loaded by some
+     * tilesets, without traversing the scene graph.
+     *
+     * addTileset() has the tileset's tiles keep their triangles when they are built in the load
+     * threads (see TilesetNode::setKeepTileGeometry), so add tilesets before their tiles are
+     * loaded. Other tilesets don't keep them. Once per frame, in the main thread, update() takes a
+     * snapshot of the loaded tiles of the tilesets; queries run against the latest snapshot and
+     * may be made from any thread. Coordinates are those of the tilesets, ECEF for georeferenced
+     * tilesets. Cesium-native keeps the ancestors of the rendered tiles loaded, so a query can hit
+     * the same surface at several levels of detail; the answer is from the finest one.
+     */
+    class VSGCS_EXPORT TerrainService : public vsg::Inherit<vsg::Object, TerrainService>
+    {
+    public:
+        struct Segment
+        {
+            vsg::dvec3 start;
+            vsg::dvec3 end;
+        };
+        struct Hit
+        {
+            vsg::dvec3 position;
+            vsg::dvec3 normal;
+            /// Geometric error of the tile that was hit
+            double geometricError;
+        };
+        void addTileset(const vsg::ref_ptr<TilesetNode>& tilesetNode);
+        void removeTileset(const vsg::ref_ptr<TilesetNode>& tilesetNode);
+        /// @brief Call update() each frame from a viewer update operation.
+        void attach(const vsg::ref_ptr<vsg::Viewer>& viewer);
+        /// @brief Take a snapshot of the loaded tiles. Call in the main thread.
+        void update();
+        /// @brief The hit closest to start of the segment from start to end.
+        std::optional<Hit> intersect(const vsg::dvec3& start, const vsg::dvec3& end) const;
+        void intersect(std::span<const Segment> segments, std::span<std::optional<Hit>> hits) const;
+        /**
+         * @brief Height of the terrain above the WGS84 ellipsoid.
+         * @param longitude in radians
+         * @param latitude in radians
+         */
+        std::optional<double> getHeight(double longitude, double latitude) const;
+        /// @brief Batch version of getHeight(); lonLats are (longitude, latitude) in radians.
+        void getHeights(std::span<const vsg::dvec2> lonLats, std::span<std::optional<double>> heights) const;
+        /**
+         * @name Asynchronous queries
+         * Run queries in a worker thread against the snapshot that is current when they are
+         * called. Use thenInMainThread() on the result to consume it in the main thread.
+         */
+        ///@{
+        CesiumAsync::Future<std::optional<Hit>> intersectAsync(const vsg::dvec3& start, const vsg::dvec3& end) const;
+        CesiumAsync::Future<std::vector<std::optional<Hit>>> intersectAsync(std::vector<Segment> segments) const;
+        CesiumAsync::Future<std::vector<std::optional<double>>> getHeightsAsync(std::vector<vsg::dvec2> lonLats) const;
+        ///@}
+        size_t getNumTiles() const;
+        /// Range of ellipsoid heights searched by getHeight()
+        double minHeight = -500.0;
+        double maxHeight = 9000.0;
+
+    protected:
+        struct TerrainTile
+        {
+            vsg::ref_ptr<const TileGeometry> geometry;
+            double geometricError;
+        };
+        using Snapshot = std::vector<TerrainTile>;
+        std::shared_ptr<const Snapshot> getSnapshot() const;
+        static std::optional<Hit> intersect(const Snapshot& snapshot, const vsg::dvec3& start, const vsg::dvec3& end);
+        static void getHeights(const Snapshot* snapshot, double lowest, double highest,
+                               std::span<const vsg::dvec2> lonLats, std::span<std::optional<double>> heights);
+        std::vector<vsg::observer_ptr<TilesetNode>> _tilesets;
+        mutable std::mutex _snapshotMutex;
+        std::shared_ptr<const Snapshot> _snapshot;
+    };
+}
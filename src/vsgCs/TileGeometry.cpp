@@ -0,0 +1,595 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#include "TileGeometry.h"
+
+#include "accessor_traits.h"
+#include "runtimeSupport.h"
+
+#include <CesiumGltf/AccessorView.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace vsgCs;
+using namespace CesiumGltf;
+
+namespace
+{
+    // Call f with the vertex numbers of each triangle of a primitive.
+    template<typename F>
+    bool mapPrimitiveTriangles(const MeshPrimitive& primitive, uint32_t numVertices, F&& f)
+    {
+        switch (primitive.mode)
+        {
+        case MeshPrimitive::Mode::TRIANGLES:
+            mapTriangleList(numVertices, f);
+            return true;
+        case MeshPrimitive::Mode::TRIANGLE_STRIP:
+            mapTriangleStrip(numVertices, f);
+            return true;
+        case MeshPrimitive::Mode::TRIANGLE_FAN:
+            mapTriangleFan(numVertices, f);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool readIndices(const Model& model, const Accessor& accessor, std::vector<uint32_t>& indices)
+    {
+        return createAccessorView(model, accessor,
+                                  [&indices](auto&& view)
+                                  {
+                                      if constexpr (is_index_view<decltype(view)>::value)
+                                      {
+                                          if (view.status() != AccessorViewStatus::Valid)
+                                          {
+                                              return false;
+                                          }
+                                          indices.resize(view.size());
+                                          for (int64_t i = 0; i < view.size(); ++i)
+                                          {
+                                              indices[i] = static_cast<uint32_t>(view[i].value[0]);
+                                          }
+                                          return true;
+                                      }
+                                      else
+                                      {
+                                          return false;
+                                      }
+                                  });
+    }
+
+    // Moeller-Trumbore, accepting hits on either side of the triangle
+    std::optional<double> intersectTriangle(const vsg::dvec3& start, const vsg::dvec3& dir,
+                                            const vsg::dvec3& v0, const vsg::dvec3& v1, const vsg::dvec3& v2)
+    {
+        const vsg::dvec3 e1 = v1 - v0;
+        const vsg::dvec3 e2 = v2 - v0;
+        const vsg::dvec3 p = vsg::cross(dir, e2);
+        const double det = vsg::dot(e1, p);
+        if (std::abs(det) < 1e-14)
+        {
+            return {};
+        }
+        const double invDet = 1.0 / det;
+        const vsg::dvec3 s = start - v0;
+        const double u = vsg::dot(s, p) * invDet;
+        if (u < 0.0 || u > 1.0)
+        {
+            return {};
+        }
+        const vsg::dvec3 q = vsg::cross(s, e1);
+        const double v = vsg::dot(dir, q) * invDet;
+        if (v < 0.0 || u + v > 1.0)
+        {
+            return {};
+        }
+        const double t = vsg::dot(e2, q) * invDet;
+        if (t < 0.0 || t > 1.0)
+        {
+            return {};
+        }
+        return t;
+    }
+
+    constexpr uint32_t maxLeafTriangles = 4;
+    constexpr int numBins = 16;
+    // The traversal stack holds at most one entry more than the depth of the tree.
+    constexpr int maxDepth = 60;
+    constexpr size_t stackSize = maxDepth + 4;
+
+    struct Box
+    {
+        vsg::vec3 min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max()};
+        vsg::vec3 max{-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                      -std::numeric_limits<float>::max()};
+        void extend(const vsg::vec3& lo, const vsg::vec3& hi)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                min[i] = std::min(min[i], lo[i]);
+                max[i] = std::max(max[i], hi[i]);
+            }
+        }
+        void extend(const Box& box)
+        {
+            extend(box.min, box.max);
+        }
+        float area() const
+        {
+            if (max.x < min.x)
+            {
+                return 0.0f;
+            }
+            const vsg::vec3 d = max - min;
+            return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+    };
+
+    struct TriangleBox
+    {
+        Box box;
+        vsg::vec3 centroid;
+    };
+
+    // Top-down builder using a binned surface area heuristic over all three axes.
+    class BVHBuilder
+    {
+    public:
+        explicit BVHBuilder(TileGeometry& in_geometry)
+            : geometry(in_geometry)
+        {}
+        void build();
+    private:
+        uint32_t buildNode(uint32_t begin, uint32_t end, int depth);
+        uint32_t split(uint32_t begin, uint32_t end, const Box& box, const Box& centroids);
+        TileGeometry::BVHNode quantize(const Box& box) const;
+        TileGeometry& geometry;
+        std::vector<TriangleBox> triangles;
+        std::vector<uint32_t> order;
+    };
+
+    void BVHBuilder::build()
+    {
+        const auto numTriangles = static_cast<uint32_t>(geometry.indices.size() / 3);
+        geometry.bvh.clear();
+        if (numTriangles == 0)
+        {
+            return;
+        }
+        Box bounds;
+        triangles.resize(numTriangles);
+        for (uint32_t i = 0; i < numTriangles; ++i)
+        {
+            auto& triangle = triangles[i];
+            for (uint32_t j = 0; j < 3; ++j)
+            {
+                const auto& v = geometry.vertices[geometry.indices[i * 3 + j]];
+                triangle.box.extend(v, v);
+            }
+            triangle.centroid = (triangle.box.min + triangle.box.max) * 0.5f;
+            bounds.extend(triangle.box);
+        }
+        geometry.boxMin = bounds.min;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const float extent = bounds.max[i] - bounds.min[i];
+            geometry.boxScale[i] = extent > 0.0f ? extent / 65535.0f : 1.0f;
+        }
+        order.resize(numTriangles);
+        for (uint32_t i = 0; i < numTriangles; ++i)
+        {
+            order[i] = i;
+        }
+        geometry.bvh.reserve(2 * numTriangles / maxLeafTriangles + 1);
+        buildNode(0, numTriangles, 0);
+        geometry.bvh.shrink_to_fit();
+        // Put the triangles of each leaf next to each other.
+        std::vector<uint32_t> sortedIndices(geometry.indices.size());
+        for (uint32_t i = 0; i < numTriangles; ++i)
+        {
+            std::copy_n(&geometry.indices[order[i] * 3], 3, &sortedIndices[i * 3]);
+        }
+        geometry.indices = std::move(sortedIndices);
+    }
+
+    uint32_t BVHBuilder::buildNode(uint32_t begin, uint32_t end, int depth)
+    {
+        Box box;
+        Box centroids;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const auto& triangle = triangles[order[i]];
+            box.extend(triangle.box);
+            centroids.extend(triangle.centroid, triangle.centroid);
+        }
+        const auto nodeIndex = static_cast<uint32_t>(geometry.bvh.size());
+        geometry.bvh.push_back(quantize(box));
+        const uint32_t count = end - begin;
+        const uint32_t mid = count <= maxLeafTriangles || depth >= maxDepth
+            ? begin : split(begin, end, box, centroids);
+        if (mid == begin || mid == end)
+        {
+            geometry.bvh[nodeIndex].offset = begin;
+            geometry.bvh[nodeIndex].count = count;
+            return nodeIndex;
+        }
+        buildNode(begin, mid, depth + 1);
+        const uint32_t second = buildNode(mid, end, depth + 1);
+        geometry.bvh[nodeIndex].offset = second;
+        geometry.bvh[nodeIndex].count = 0;
+        return nodeIndex;
+    }
+
+    // Returns the end of the first half of the triangles, or begin to make a leaf.
+    uint32_t BVHBuilder::split(uint32_t begin, uint32_t end, const Box& box, const Box& centroids)
+    {
+        const uint32_t count = end - begin;
+        const float area = std::max(box.area(), std::numeric_limits<float>::min());
+        // Costs are relative to intersecting one triangle; visiting a node costs about as much.
+        float bestCost = static_cast<float>(count);
+        int bestAxis = -1;
+        int bestBin = 0;
+        auto binOf = [&centroids](const vsg::vec3& centroid, int axis)
+        {
+            const float extent = centroids.max[axis] - centroids.min[axis];
+            const int bin = static_cast<int>((centroid[axis] - centroids.min[axis]) * (numBins / extent));
+            return std::min(bin, numBins - 1);
+        };
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (centroids.max[axis] - centroids.min[axis] <= 0.0f)
+            {
+                continue;
+            }
+            Box bins[numBins];
+            uint32_t counts[numBins] = {};
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const auto& triangle = triangles[order[i]];
+                const int bin = binOf(triangle.centroid, axis);
+                bins[bin].extend(triangle.box);
+                ++counts[bin];
+            }
+            float rightArea[numBins];
+            uint32_t rightCount[numBins];
+            Box right;
+            uint32_t numRight = 0;
+            for (int bin = numBins - 1; bin > 0; --bin)
+            {
+                right.extend(bins[bin]);
+                numRight += counts[bin];
+                rightArea[bin] = right.area();
+                rightCount[bin] = numRight;
+            }
+            Box left;
+            uint32_t numLeft = 0;
+            for (int bin = 0; bin < numBins - 1; ++bin)
+            {
+                left.extend(bins[bin]);
+                numLeft += counts[bin];
+                if (numLeft == 0 || rightCount[bin + 1] == 0)
+                {
+                    continue;
+                }
+                const float cost = 1.0f + (left.area() * static_cast<float>(numLeft)
+                                           + rightArea[bin + 1] * static_cast<float>(rightCount[bin + 1])) / area;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+        if (bestAxis < 0)
+        {
+            if (count <= 4 * maxLeafTriangles)
+            {
+                return begin;
+            }
+            // No split pays off, but the leaf would be too big: split in the middle of the
+            // longest axis of the centroids.
+            int axis = 0;
+            for (int i = 1; i < 3; ++i)
+            {
+                if (centroids.max[i] - centroids.min[i] > centroids.max[axis] - centroids.min[axis])
+                {
+                    axis = i;
+                }
+            }
+            const uint32_t mid = begin + count / 2;
+            std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                             [this, axis](uint32_t lhs, uint32_t rhs)
+                             {
+                                 return triangles[lhs].centroid[axis] < triangles[rhs].centroid[axis];
+                             });
+            return mid;
+        }
+        auto it = std::partition(order.begin() + begin, order.begin() + end,
+                                 [&](uint32_t triangle)
+                                 {
+                                     return binOf(triangles[triangle].centroid, bestAxis) <= bestBin;
+                                 });
+        return static_cast<uint32_t>(it - order.begin());
+    }
+
+    TileGeometry::BVHNode BVHBuilder::quantize(const Box& box) const
+    {
+        // Round outwards, with a quantum to spare for rounding errors.
+        TileGeometry::BVHNode node{};
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const double lo = std::floor((box.min[i] - geometry.boxMin[i]) / geometry.boxScale[i]) - 1.0;
+            const double hi = std::ceil((box.max[i] - geometry.boxMin[i]) / geometry.boxScale[i]) + 1.0;
+            node.min[i] = static_cast<uint16_t>(std::clamp(lo, 0.0, 65535.0));
+            node.max[i] = static_cast<uint16_t>(std::clamp(hi, 0.0, 65535.0));
+        }
+        return node;
+    }
+}
+
+bool TileGeometry::intersectsBound(const vsg::dvec3& start, const vsg::dvec3& end) const
+{
+    const vsg::dvec3 dir = end - start;
+    const double len2 = vsg::length2(dir);
+    double t = len2 > 0.0 ? vsg::dot(bound.center - start, dir) / len2 : 0.0;
+    t = std::clamp(t, 0.0, 1.0);
+    return vsg::length2(start + dir * t - bound.center) <= bound.radius * bound.radius;
+}
+
+std::optional<TileGeometry::Hit> TileGeometry::intersect(const vsg::dvec3& start, const vsg::dvec3& end) const
+{
+    if (!intersectsBound(start, end))
+    {
+        return {};
+    }
+    if (!bvh.empty())
+    {
+        return intersectBVH(start, end);
+    }
+    // Work relative to the origin to keep the precision of the vertices.
+    const vsg::dvec3 localStart = start - origin;
+    const vsg::dvec3 dir = end - start;
+    std::optional<Hit> result;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const vsg::dvec3 v0(vertices[indices[i]]);
+        const vsg::dvec3 v1(vertices[indices[i + 1]]);
+        const vsg::dvec3 v2(vertices[indices[i + 2]]);
+        auto t = intersectTriangle(localStart, dir, v0, v1, v2);
+        if (t && (!result || *t < result->ratio))
+        {
+            vsg::dvec3 normal = vsg::cross(v1 - v0, v2 - v0);
+            result = Hit{*t, start + dir * *t, vsg::normalize(normal)};
+        }
+    }
+    return result;
+}
+
+std::optional<TileGeometry::Hit> TileGeometry::intersectBVH(const vsg::dvec3& start, const vsg::dvec3& end) const
+{
+    const vsg::dvec3 localStart = start - origin;
+    const vsg::dvec3 dir = end - start;
+    // Slab test of a node's box against the segment; returns the entry ratio.
+    auto enter = [&](const BVHNode& node, double ratioMax) -> std::optional<double>
+    {
+        double ratioNear = 0.0;
+        double ratioFar = ratioMax;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const double lo = boxMin[i] + node.min[i] * static_cast<double>(boxScale[i]) - localStart[i];
+            const double hi = boxMin[i] + node.max[i] * static_cast<double>(boxScale[i]) - localStart[i];
+            if (dir[i] == 0.0)
+            {
+                if (lo > 0.0 || hi < 0.0)
+                {
+                    return {};
+                }
+                continue;
+            }
+            double t0 = lo / dir[i];
+            double t1 = hi / dir[i];
+            if (t0 > t1)
+            {
+                std::swap(t0, t1);
+            }
+            ratioNear = std::max(ratioNear, t0);
+            ratioFar = std::min(ratioFar, t1);
+            if (ratioNear > ratioFar)
+            {
+                return {};
+            }
+        }
+        return ratioNear;
+    };
+    struct StackEntry
+    {
+        uint32_t node;
+        double ratio;
+    };
+    StackEntry stack[stackSize];
+    size_t top = 0;
+    std::optional<Hit> result;
+    double ratioMax = 1.0;
+    if (auto ratio = enter(bvh[0], ratioMax))
+    {
+        stack[top++] = {0, *ratio};
+    }
+    while (top > 0)
+    {
+        const StackEntry entry = stack[--top];
+        if (entry.ratio > ratioMax)
+        {
+            continue;
+        }
+        const BVHNode& node = bvh[entry.node];
+        if (node.count > 0)
+        {
+            for (uint32_t triangle = node.offset; triangle < node.offset + node.count; ++triangle)
+            {
+                const vsg::dvec3 v0(vertices[indices[triangle * 3]]);
+                const vsg::dvec3 v1(vertices[indices[triangle * 3 + 1]]);
+                const vsg::dvec3 v2(vertices[indices[triangle * 3 + 2]]);
+                auto t = intersectTriangle(localStart, dir, v0, v1, v2);
+                if (t && *t <= ratioMax)
+                {
+                    ratioMax = *t;
+                    result = Hit{*t, start + dir * *t, vsg::normalize(vsg::cross(v1 - v0, v2 - v0))};
+                }
+            }
+            continue;
+        }
+        StackEntry first{entry.node + 1, 0.0};
+        StackEntry second{node.offset, 0.0};
+        auto firstRatio = enter(bvh[first.node], ratioMax);
+        auto secondRatio = enter(bvh[second.node], ratioMax);
+        if (firstRatio && secondRatio)
+        {
+            first.ratio = *firstRatio;
+            second.ratio = *secondRatio;
+            // Visit the nearer child first.
+            if (first.ratio < second.ratio)
+            {
+                std::swap(first, second);
+            }
+            stack[top++] = first;
+            stack[top++] = second;
+        }
+        else if (firstRatio)
+        {
+            stack[top++] = {first.node, *firstRatio};
+        }
+        else if (secondRatio)
+        {
+            stack[top++] = {second.node, *secondRatio};
+        }
+    }
+    return result;
+}
+
+void TileGeometry::buildBVH()
+{
+    BVHBuilder builder(*this);
+    builder.build();
+}
+
+size_t TileGeometry::memorySize() const
+{
+    return sizeof(TileGeometry) + vertices.capacity() * sizeof(vsg::vec3) + indices.capacity() * sizeof(uint32_t)
+        + bvh.capacity() * sizeof(BVHNode);
+}
+
+vsg::ref_ptr<TileGeometry> vsgCs::createTileGeometry(const Model& model, const glm::dmat4& transform)
+{
+    std::vector<vsg::dvec3> positions;
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> primitiveIndices;
+    model.forEachPrimitiveInScene(
+        -1,
+        [&](const Model& gltf, const Node&, const Mesh&, const MeshPrimitive& primitive,
+            const glm::dmat4& nodeTransform)
+        {
+            auto positionIt = primitive.attributes.find("POSITION");
+            if (positionIt == primitive.attributes.end())
+            {
+                return;
+            }
+            AccessorView<AccessorTypes::VEC3<float>> positionView(gltf, positionIt->second);
+            if (positionView.status() != AccessorViewStatus::Valid)
+            {
+                return;
+            }
+            primitiveIndices.clear();
+            if (const Accessor* indexAccessor = Model::getSafe(&gltf.accessors, primitive.indices))
+            {
+                if (!readIndices(gltf, *indexAccessor, primitiveIndices))
+                {
+                    return;
+                }
+            }
+            const auto base = static_cast<uint32_t>(positions.size());
+            const uint32_t numVertices = primitiveIndices.empty()
+                ? static_cast<uint32_t>(positionView.size())
+                : static_cast<uint32_t>(primitiveIndices.size());
+            if (numVertices < 3)
+            {
+                return;
+            }
+            const auto numPositions = static_cast<uint32_t>(positionView.size());
+            const size_t firstTriangle = triangles.size();
+            bool valid = true;
+            bool mapped = mapPrimitiveTriangles(
+                primitive, numVertices,
+                [&](uint32_t i0, uint32_t i1, uint32_t i2)
+                {
+                    for (uint32_t i : {i0, i1, i2})
+                    {
+                        uint32_t index = primitiveIndices.empty() ? i : primitiveIndices[i];
+                        valid = valid && index < numPositions;
+                        triangles.push_back(base + index);
+                    }
+                });
+            if (!mapped || !valid)
+            {
+                triangles.resize(firstTriangle);
+                return;
+            }
+            const glm::dmat4 toTile = transform * nodeTransform;
+            for (int64_t i = 0; i < positionView.size(); ++i)
+            {
+                const auto& value = positionView[i].value;
+                glm::dvec4 p = toTile * glm::dvec4(value[0], value[1], value[2], 1.0);
+                positions.emplace_back(p.x, p.y, p.z);
+            }
+        });
+    if (triangles.empty())
+    {
+        return {};
+    }
+    vsg::dvec3 minPos(positions[0]);
+    vsg::dvec3 maxPos(positions[0]);
+    for (const auto& p : positions)
+    {
+        for (size_t i = 0; i < 3; ++i)
+        {
+            minPos[i] = std::min(minPos[i], p[i]);
+            maxPos[i] = std::max(maxPos[i], p[i]);
+        }
+    }
+    auto result = TileGeometry::create();
+    result->origin = (minPos + maxPos) * 0.5;
+    result->bound = vsg::dsphere(result->origin, vsg::length(maxPos - minPos) * 0.5);
+    result->vertices.reserve(positions.size());
+    for (const auto& p : positions)
+    {
+        result->vertices.emplace_back(p - result->origin);
+    }
+    result->indices = std::move(triangles);
+    return result;
+}
@@ -0,0 +1,105 @@
+/* <editor-fold desc="MIT License">
+
+Copyright(c) 2023 Timothy Moore
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+</editor-fold> */
+
+#pragma once
+
+#include "vsgCs/Export.h"
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+#include <vsg/maths/sphere.h>
+#include <vsg/maths/vec3.h>
+
+#include <CesiumGltf/Model.h>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace vsgCs
+{
+    /**
+     * @brief The triangles of a tile, kept in memory for intersection tests after the tile's
+     * vertex data has been uploaded to the GPU.
+     *
+     * Vertices are relative to an origin in the tile's coordinate system (ECEF for most tilesets)
+     * and stored in single precision. The object is immutable once built, so it can be shared
+     * with worker threads.
+     *
+     * buildBVH() adds a bounding volume hierarchy over the triangles, built with a binned
+     * surface area heuristic, so that intersect() doesn't test every triangle.
+     */
+    class VSGCS_EXPORT TileGeometry : public vsg::Inherit<vsg::Object, TileGeometry>
+    {
+    public:
+        struct Hit
+        {
+            /// Position of the hit along the segment, from 0 at the start to 1 at the end
+            double ratio;
+            vsg::dvec3 position;
+            vsg::dvec3 normal;
+        };
+        /**
+         * @brief A BVH node, with its box quantized to 16 bits within the box of all the
+         * vertices.
+         *
+         * The first child of an inner node follows it in the array and offset is the index of the
+         * second child. A leaf has count triangles, starting at triangle offset.
+         */
+        struct BVHNode
+        {
+            uint16_t min[3];
+            uint16_t max[3];
+            uint32_t offset;
+            uint32_t count;
+        };
+        /// @brief The closest intersection with the segment from start to end, if any.
+        std::optional<Hit> intersect(const vsg::dvec3& start, const vsg::dvec3& end) const;
+        bool intersectsBound(const vsg::dvec3& start, const vsg::dvec3& end) const;
+        /// @brief Build the BVH. This reorders the triangles.
+        void buildBVH();
+        size_t memorySize() const;
+        vsg::dvec3 origin;
+        std::vector<vsg::vec3> vertices;
+        std::vector<uint32_t> indices;
+        vsg::dsphere bound;
+        std::vector<BVHNode> bvh;
+        // A quantized coordinate q is boxMin + q * boxScale.
+        vsg::vec3 boxMin;
+        vsg::vec3 boxScale;
+    protected:
+        std::optional<Hit> intersectBVH(const vsg::dvec3& start, const vsg::dvec3& end) const;
+    };
+
+    /**
+     * @brief Collect the triangles of all the primitives in a glTF model's default scene.
+     *
+     * @param transform transform from the model's coordinates, after any RTC and up axis
+     * adjustments, to the tile's coordinate system
+     * @return nullptr if the model has no triangles with float positions
+     */
+    VSGCS_EXPORT vsg::ref_ptr<TileGeometry> createTileGeometry(const CesiumGltf::Model& model,
+                                                               const glm::dmat4& transform);
+}
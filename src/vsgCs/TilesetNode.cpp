@@ -29,17 +29,27 @@ SOFTWARE.
 #include "OpThreadTaskProcessor.h"
 #include "pbr.h"
 #include "RuntimeEnvironment.h"
+#include "TileGeometry.h"
 #include "Tracing.h"
 #include "UrlAssetAccessor.h"
 
+#include <CesiumAsync/CachingAssetAccessor.h>
+#include <CesiumAsync/IAssetAccessor.h>
+#include <CesiumAsync/IAssetRequest.h>
+#include <CesiumAsync/IAssetResponse.h>
 #include <CesiumUtility/JsonHelpers.h>
+#include <CesiumUtility/Uri.h>
 #include <Cesium3DTilesSelection/TilesetMetadata.h>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <optional>
 #include <cmath>
+#include <set>
 #include <vsg/core/ref_ptr.h>
 #include <vsg/io/Logger.h>
 #include <vsg/io/Options.h>
@@ -76,8 +86,14 @@ void for_each_view(const vsg::ref_ptr<vsg::Viewer>& viewer, const F& f)
 TilesetNode::TilesetNode(const DeviceFeatures& deviceFeatures, const TilesetSource& source,
                          const Cesium3DTilesSelection::TilesetOptions& tilesetOptions,
                          const vsg::ref_ptr<vsg::Options>&)
-    : _viewUpdateResult(nullptr), _tilesetsBeingDestroyed(0)
+    : restyleTimeBudget(2.0), _viewUpdateResult(nullptr),
+      _tileGeometryBytes(std::make_shared<std::atomic<int64_t>>(0)), _source(source),
+      _tilesetsBeingDestroyed(0), _depthPrepass(false), _keepTileGeometry(false), _buildTileBVH(false)
 {
+    if (const auto* in_styling = std::any_cast<vsg::ref_ptr<Styling>>(&tilesetOptions.rendererOptions))
+    {
+        styling = *in_styling;
+    }
     Cesium3DTilesSelection::TilesetOptions options(tilesetOptions);
     // turn off all the unsupported stuff
     options.enableOcclusionCulling = false;
@@ -99,9 +115,14 @@ TilesetNode::TilesetNode(const DeviceFeatures& deviceFeatures, const TilesetSour
         };
     auto env = RuntimeEnvironment::get();
     options.enableLodTransitionPeriod = env->enableLodTransitionPeriod;
+    _depthPrepass = env->depthPrepass;
+    _keepTileGeometry = env->keepTileGeometry;
+    _buildTileBVH = env->buildTileBVH;
+    options.rendererOptions = getRendererOptions();
     options.lodTransitionLength = 1.0f;
     auto externals = env->getTilesetExternals();
     options.contentOptions.ktx2TranscodeTargets = deviceFeatures.ktx2TranscodeTargets;
+    _maximumCachedBytes = options.maximumCachedBytes;
 
     if (source.url)
     {
@@ -137,6 +158,15 @@ TilesetNode::TilesetNode(const DeviceFeatures& deviceFeatures, const TilesetSour
 
 void TilesetNode::shutdown()
 {
+    if (_updateTileset)
+    {
+        // Otherwise the viewer runs the operation of a removed tileset every frame for good.
+        if (vsg::ref_ptr<vsg::Viewer> viewer = _updateTileset->viewer; viewer && viewer->updateOperations)
+        {
+            viewer->updateOperations->remove(_updateTileset);
+        }
+        _updateTileset = {};
+    }
     if (_tileset)
     {
         // Kind of gross, but the overlay is going to call TilesetNode::removeOverlay, which mutates
@@ -207,7 +237,136 @@ void TilesetNode::traverse(vsg::ConstVisitor& visitor) const
 
 void TilesetNode::traverse(vsg::RecordTraversal& visitor) const
 {
-    t_traverse(visitor);
+    if (!_auxiliarySelections.empty())
+    {
+        auto auxItr = _auxiliarySelections.find(visitor.getCommandBuffer()->viewID);
+        if (auxItr != _auxiliarySelections.end())
+        {
+            recordAuxiliary(visitor, auxItr->second);
+            return;
+        }
+    }
+    if (_depthPrepass)
+    {
+        recordWithDepthPrepass(visitor);
+    }
+    else
+    {
+        t_traverse(visitor);
+    }
+}
+
+// Draw the depth of the opaque geometry in tiles that aren't fading, then shade those tiles with an
+// equal depth test, so that the expensive fragment shader runs about once per pixel instead of once
+// per overlapping layer. Fading tiles discard fragments with blue noise, so their depth isn't
+// known in advance; they are drawn with their standard pipelines after the others. The masks are
+// described in pbr.h.
+
+void TilesetNode::recordWithDepthPrepass(vsg::RecordTraversal& visitor) const
+{
+    if (!_viewUpdateResult)
+    {
+        return;
+    }
+    auto recordTile = [&visitor](const auto& tile, bool fading)
+    {
+        const auto& tileContent = tile->getContent();
+        if (tileContent.isRenderContent()
+            && (tileContent.getRenderContent()->getLodTransitionFadePercentage() < 1.0f) == fading)
+        {
+            const auto* renderResources
+                = reinterpret_cast<const RenderResources*>(tileContent.getRenderContent()
+                                                           ->getRenderResources());
+            renderResources->model->accept(visitor);
+        }
+    };
+    const vsg::Mask savedMask = visitor.traversalMask;
+    const vsg::Mask otherMasks = savedMask & ~pbr::DEPTH_PASS_MASKS;
+    for (vsg::Mask pass : {pbr::DEPTH_PREPASS_MASK, pbr::DEPTH_EQUAL_MASK})
+    {
+        visitor.traversalMask = otherMasks | pass;
+        for (const auto& tile : _viewUpdateResult->tilesToRenderThisFrame)
+        {
+            recordTile(tile, false);
+        }
+    }
+    visitor.traversalMask = otherMasks | pbr::DEPTH_STANDARD_MASK;
+    for (const auto& tile : _viewUpdateResult->tilesToRenderThisFrame)
+    {
+        recordTile(tile, true);
+    }
+    for (const auto& tile : _viewUpdateResult->tilesFadingOut)
+    {
+        recordTile(tile, true);
+    }
+    visitor.traversalMask = savedMask;
+}
+
+void TilesetNode::recordAuxiliary(vsg::RecordTraversal& visitor,
+                                  const std::vector<const Cesium3DTilesSelection::Tile*>& tiles) const
+{
+    const vsg::Mask savedMask = visitor.traversalMask;
+    if (_depthPrepass)
+    {
+        visitor.traversalMask = (savedMask & ~pbr::DEPTH_PASS_MASKS) | pbr::DEPTH_STANDARD_MASK;
+    }
+    for (const auto* tile : tiles)
+    {
+        const auto* renderResources
+            = reinterpret_cast<const RenderResources*>(tile->getContent().getRenderContent()
+                                                       ->getRenderResources());
+        renderResources->model->accept(visitor);
+    }
+    visitor.traversalMask = savedMask;
+}
+
+void vsgCs::setViewRole(const vsg::ref_ptr<vsg::View>& view, ViewRole role, double sseScale)
+{
+    if (sseScale < 0.0)
+    {
+        switch (role)
+        {
+        case SHADOW_VIEW:
+            sseScale = 4.0;
+            break;
+        case REFLECTION_VIEW:
+            sseScale = 2.0;
+            break;
+        case MINIMAP_VIEW:
+            sseScale = 8.0;
+            break;
+        case MAIN_VIEW:
+        default:
+            sseScale = 1.0;
+        }
+    }
+    view->setObject("vsgCsViewRole", ViewRoleData::create(role, sseScale));
+}
+
+ViewRoleData vsgCs::getViewRole(const vsg::View& view)
+{
+    if (const auto* roleData = view.getObject<ViewRoleData>("vsgCsViewRole"))
+    {
+        return *roleData;
+    }
+    return {MAIN_VIEW, 1.0};
+}
+
+const char* vsgCs::getViewRoleName(ViewRole role)
+{
+    switch (role)
+    {
+    case MAIN_VIEW:
+        return "main";
+    case SHADOW_VIEW:
+        return "shadow";
+    case REFLECTION_VIEW:
+        return "reflection";
+    case MINIMAP_VIEW:
+        return "minimap";
+    default:
+        return "unknown";
+    }
 }
 
 // We need to supply our cameras' poses (position, direction, up) to Cesium in its coordinate
@@ -326,7 +485,7 @@ void TilesetNode::updateViews(const vsg::ref_ptr<vsg::Viewer>& viewer)
 
 namespace
 {
-    void fadeTile(const auto& tile, bool fadeOut)
+    void setTileFade(const auto& tile, float fadePercentage, bool fadeOut)
     {
         const auto& tileContent = tile->getContent();
         if (tileContent.isRenderContent())
@@ -337,7 +496,6 @@ namespace
             auto uboData = CesiumGltfBuilder::getTileData(renderResources->model);
             if (uboData)
             {
-                auto fadePercentage = tileContent.getRenderContent()->getLodTransitionFadePercentage();
                 auto [fadeValue, oldFadeOut] = pbr::getFadeValue(uboData);
                 if (fadeValue != fadePercentage || fadeOut != oldFadeOut)
                 {
@@ -347,6 +505,92 @@ namespace
             }
         }
     }
+
+    void fadeTile(const auto& tile, bool fadeOut)
+    {
+        const auto& tileContent = tile->getContent();
+        if (tileContent.isRenderContent())
+        {
+            setTileFade(tile, tileContent.getRenderContent()->getLodTransitionFadePercentage(), fadeOut);
+        }
+    }
+}
+
+namespace
+{
+    bool isRenderable(const Cesium3DTilesSelection::Tile* tile)
+    {
+        const auto& content = tile->getContent();
+        return tile->getState() == Cesium3DTilesSelection::TileLoadState::Done
+            && content.isRenderContent()
+            && content.getRenderContent()->getRenderResources() != nullptr;
+    }
+
+    // Choose tiles for an auxiliary view from the tiles selected for the main views. Each tile is
+    // replaced by its coarsest loaded ancestor that still satisfies the auxiliary view's
+    // screen-space error, climbing only through REPLACE refinement, because an ADD parent doesn't
+    // contain its children's content. Nothing new is requested from cesium-native.
+    std::vector<const Cesium3DTilesSelection::Tile*>
+    selectAuxiliaryTiles(const Cesium3DTilesSelection::ViewUpdateResult& mainResult,
+                         const Cesium3DTilesSelection::ViewState& viewState,
+                         double maximumScreenSpaceError)
+    {
+        std::vector<const Cesium3DTilesSelection::Tile*> candidates;
+        std::set<const Cesium3DTilesSelection::Tile*> selected;
+        for (const auto& mainTile : mainResult.tilesToRenderThisFrame)
+        {
+            const Cesium3DTilesSelection::Tile* candidate = &*mainTile;
+            if (!isRenderable(candidate))
+            {
+                continue;
+            }
+            for (const auto* parent = candidate->getParent(); parent; parent = parent->getParent())
+            {
+                if (parent->getRefine() != Cesium3DTilesSelection::TileRefine::Replace)
+                {
+                    break;
+                }
+                double distance
+                    = std::sqrt(viewState.computeDistanceSquaredToBoundingVolume(parent->getBoundingVolume()));
+                if (viewState.computeScreenSpaceError(parent->getGeometricError(), distance)
+                    > maximumScreenSpaceError)
+                {
+                    break;
+                }
+                if (isRenderable(parent))
+                {
+                    candidate = parent;
+                }
+            }
+            if (viewState.isBoundingVolumeVisible(candidate->getBoundingVolume())
+                && selected.insert(candidate).second)
+            {
+                candidates.push_back(candidate);
+            }
+        }
+        // Don't draw a tile together with one of its ancestors.
+        std::vector<const Cesium3DTilesSelection::Tile*> result;
+        for (const auto* tile : candidates)
+        {
+            const auto* parent = tile->getParent();
+            while (parent && selected.count(parent) == 0)
+            {
+                parent = parent->getParent();
+            }
+            if (!parent)
+            {
+                result.push_back(tile);
+            }
+        }
+        return result;
+    }
+
+    struct AuxiliaryView
+    {
+        uint32_t viewID;
+        ViewRoleData role;
+        Cesium3DTilesSelection::ViewState viewState;
+    };
 }
 
 void TilesetNode::UpdateTileset::run()
@@ -368,12 +612,22 @@ void TilesetNode::UpdateTileset::run()
         deltaTime = diff.count();
     }
     std::vector<Cesium3DTilesSelection::ViewState> viewStates;
+    std::vector<AuxiliaryView> auxiliaryViews;
     for_each_view(viewer,
-                  [&viewStates](const vsg::ref_ptr<vsg::View>& view, const vsg::ref_ptr<vsg::RenderGraph>& rg)
+                  [&viewStates, &auxiliaryViews](const vsg::ref_ptr<vsg::View>& view,
+                                                 const vsg::ref_ptr<vsg::RenderGraph>& rg)
                   {
                       if (auto viewState = createViewState(view, rg))
                       {
-                          viewStates.push_back(viewState.value());
+                          auto role = getViewRole(*view);
+                          if (role.role == MAIN_VIEW)
+                          {
+                              viewStates.push_back(viewState.value());
+                          }
+                          else
+                          {
+                              auxiliaryViews.push_back({view->viewID, role, viewState.value()});
+                          }
                       }
                   });
     ref_tileset->_viewUpdateResult = &tileset.updateViewGroup(tileset.getDefaultViewGroup(), viewStates, deltaTime);
@@ -385,8 +639,408 @@ void TilesetNode::UpdateTileset::run()
     {
         fadeTile(tile, true);
     }
+    ref_tileset->accountTileGeometry();
     tileset.loadTiles();
+    // Reading the property columns of a tile for a new style is main thread work too, so it
+    // shares restyleTimeBudget with applying the evaluated colors. Tiles left over are restyled in
+    // later frames.
+    const auto restyleStartTime = vsg::clock::now();
+    ref_tileset->applyRestyledTiles(restyleStartTime);
+    if (ref_tileset->styling)
+    {
+        for (const auto& tile : ref_tileset->_viewUpdateResult->tilesToRenderThisFrame)
+        {
+            if (std::chrono::duration<double, std::milli>(vsg::clock::now() - restyleStartTime).count()
+                >= ref_tileset->restyleTimeBudget)
+            {
+                break;
+            }
+            ref_tileset->restyleTile(&*tile);
+        }
+    }
+    // Auxiliary views are chosen after loadTiles(), which may unload tiles.
+    std::map<ViewRole, size_t> tileCounts;
+    tileCounts[MAIN_VIEW] = ref_tileset->_viewUpdateResult->tilesToRenderThisFrame.size();
+    ref_tileset->_auxiliarySelections.clear();
+    std::set<const Cesium3DTilesSelection::Tile*> mainTiles;
+    if (!auxiliaryViews.empty())
+    {
+        for (const auto& tile : ref_tileset->_viewUpdateResult->tilesToRenderThisFrame)
+        {
+            mainTiles.insert(&*tile);
+        }
+        for (const auto& tile : ref_tileset->_viewUpdateResult->tilesFadingOut)
+        {
+            mainTiles.insert(&*tile);
+        }
+    }
+    for (const auto& auxView : auxiliaryViews)
+    {
+        auto& selection = ref_tileset->_auxiliarySelections[auxView.viewID];
+        selection = selectAuxiliaryTiles(*ref_tileset->_viewUpdateResult, auxView.viewState,
+                                         tileset.getOptions().maximumScreenSpaceError * auxView.role.sseScale);
+        tileCounts[auxView.role.role] += selection.size();
+        // Tiles drawn only by auxiliary views keep the fade state of the last time the main views
+        // drew them, so show them fully; the main views don't draw them this frame.
+        for (const auto* tile : selection)
+        {
+            if (mainTiles.count(tile) == 0)
+            {
+                setTileFade(tile, 1.0f, false);
+            }
+        }
+    }
+    if (tileCounts != ref_tileset->_tileCounts)
+    {
+        ref_tileset->_tileCounts = tileCounts;
+        for (const auto& [role, count] : tileCounts)
+        {
+            vsg::debug("tileset ", ref_tileset.get(), ' ', getViewRoleName(role), " views: ", count, " tiles");
+        }
+    }
     ref_tileset->_lastFrameStamp = currentFrameStamp;
+    if (ref_tileset->_normalSimultaneousTileLoads && ref_tileset->isFullyLoaded())
+    {
+        tileset.getOptions().maximumSimultaneousTileLoads = *ref_tileset->_normalSimultaneousTileLoads;
+        ref_tileset->_normalSimultaneousTileLoads.reset();
+    }
+}
+
+namespace
+{
+    // Tile IDs are relative to the tileset that contains the tile, which is an external tileset
+    // for the descendants of a tile with external content.
+    std::string resolveTileUrl(const Cesium3DTilesSelection::Tile& tile, const std::string& tileId,
+                               const std::string& tilesetUrl)
+    {
+        std::vector<const Cesium3DTilesSelection::Tile*> ancestors;
+        for (const auto* parent = tile.getParent(); parent; parent = parent->getParent())
+        {
+            ancestors.push_back(parent);
+        }
+        std::string baseUrl = tilesetUrl;
+        for (auto itr = ancestors.rbegin(); itr != ancestors.rend(); ++itr)
+        {
+            const auto* url = std::get_if<std::string>(&(*itr)->getTileID());
+            if ((*itr)->getContent().isExternalContent() && url && !url->empty())
+            {
+                baseUrl = CesiumUtility::Uri::resolve(baseUrl, *url, true);
+            }
+        }
+        return CesiumUtility::Uri::resolve(baseUrl, tileId, true);
+    }
+}
+
+std::vector<std::string> TilesetNode::getRenderedTileIds() const
+{
+    std::vector<std::pair<double, std::string>> tiles;
+    if (!_viewUpdateResult || !_source.url)
+    {
+        return {};
+    }
+    std::set<const Cesium3DTilesSelection::Tile*> visited;
+    for (const auto& renderedTile : _viewUpdateResult->tilesToRenderThisFrame)
+    {
+        // The tile selection refines from the root, so the ancestors are needed too.
+        for (const Cesium3DTilesSelection::Tile* tile = &*renderedTile;
+             tile && visited.insert(tile).second;
+             tile = tile->getParent())
+        {
+            if (const auto* url = std::get_if<std::string>(&tile->getTileID()); url && !url->empty())
+            {
+                tiles.emplace_back(tile->getGeometricError(), resolveTileUrl(*tile, *url, *_source.url));
+            }
+        }
+    }
+    std::stable_sort(tiles.begin(), tiles.end(), [](const auto& lhs, const auto& rhs)
+    {
+        return lhs.first > rhs.first;
+    });
+    std::vector<std::string> result;
+    result.reserve(tiles.size());
+    for (auto& tile : tiles)
+    {
+        result.push_back(std::move(tile.second));
+    }
+    return result;
+}
+
+namespace
+{
+    // Fetches URLs in order with a few requests in flight, keeping itself alive until done.
+    class TilePrefetcher : public std::enable_shared_from_this<TilePrefetcher>
+    {
+    public:
+        TilePrefetcher(std::vector<std::string> in_urls, std::shared_ptr<CesiumAsync::IAssetAccessor> in_accessor)
+            : urls(std::move(in_urls)), accessor(std::move(in_accessor)),
+              startTime(std::chrono::steady_clock::now())
+        {
+        }
+        void start(size_t numRequests)
+        {
+            for (size_t i = 0; i < numRequests; ++i)
+            {
+                fetchNext();
+            }
+        }
+        void fetchNext()
+        {
+            const size_t index = next++;
+            if (index >= urls.size())
+            {
+                return;
+            }
+            accessor->get(getAsyncSystem(), urls[index])
+                .thenImmediately([self = shared_from_this()](std::shared_ptr<CesiumAsync::IAssetRequest>&& request)
+                {
+                    const auto* response = request->response();
+                    if (!response || response->statusCode() < 200 || response->statusCode() >= 300)
+                    {
+                        ++self->failed;
+                    }
+                    if (++self->finished == self->urls.size())
+                    {
+                        vsg::info("Prefetched ", self->urls.size() - self->failed, " of ", self->urls.size(),
+                                  " tiles in ",
+                                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                            - self->startTime).count(),
+                                  " ms");
+                    }
+                    self->fetchNext();
+                });
+        }
+        std::vector<std::string> urls;
+        std::shared_ptr<CesiumAsync::IAssetAccessor> accessor;
+        std::chrono::steady_clock::time_point startTime;
+        std::atomic<size_t> next = 0;
+        std::atomic<size_t> finished = 0;
+        std::atomic<size_t> failed = 0;
+    };
+}
+
+void TilesetNode::prefetchTiles(const std::vector<std::string>& tileIds)
+{
+    if (!_tileset || tileIds.empty())
+    {
+        return;
+    }
+    auto& options = _tileset->getOptions();
+    if (!_normalSimultaneousTileLoads)
+    {
+        _normalSimultaneousTileLoads = options.maximumSimultaneousTileLoads;
+        options.maximumSimultaneousTileLoads *= 4;
+    }
+    // Without a cache the responses would be thrown away and the tiles fetched twice.
+    auto accessor = RuntimeEnvironment::get()->getAssetAccessor();
+    if (!_source.url || !std::dynamic_pointer_cast<CesiumAsync::CachingAssetAccessor>(accessor))
+    {
+        return;
+    }
+    std::vector<std::string> urls;
+    urls.reserve(tileIds.size());
+    for (const auto& tileId : tileIds)
+    {
+        // The IDs are absolute URLs, which resolve to themselves.
+        urls.push_back(CesiumUtility::Uri::resolve(*_source.url, tileId, true));
+    }
+    const uint32_t numRequests = _normalSimultaneousTileLoads.value_or(20);
+    std::make_shared<TilePrefetcher>(std::move(urls), accessor)->start(numRequests);
+}
+
+bool TilesetNode::isFullyLoaded() const
+{
+    return _tileset && _viewUpdateResult && !_viewUpdateResult->tilesToRenderThisFrame.empty()
+        && _tileset->computeLoadProgress() >= 100.0f;
+}
+
+namespace
+{
+    const CesiumGltf::Model* getTileModel(const Cesium3DTilesSelection::Tile& tile)
+    {
+        const auto& tileContent = tile.getContent();
+        if (!tileContent.isRenderContent() || !tileContent.getRenderContent()->getRenderResources())
+        {
+            return nullptr;
+        }
+        return &tileContent.getRenderContent()->getModel();
+    }
+
+    vsg::ref_ptr<FeatureTable> getTileFeatureTable(const Cesium3DTilesSelection::Tile& tile)
+    {
+        if (!getTileModel(tile))
+        {
+            return {};
+        }
+        const auto* renderResources
+            = reinterpret_cast<const RenderResources*>(tile.getContent().getRenderContent()->getRenderResources());
+        return CesiumGltfBuilder::getFeatureTable(renderResources->model);
+    }
+}
+
+// cesium-native only counts the glTF data of tiles against maximumCachedBytes, so the triangles
+// and BVHs kept for intersection tests come out of the budget instead. The resource preparer
+// keeps the count up to date as tiles are loaded and freed.
+void TilesetNode::accountTileGeometry()
+{
+    _tileset->getOptions().maximumCachedBytes
+        = std::max<int64_t>(0, _maximumCachedBytes - _tileGeometryBytes->load());
+}
+
+void TilesetNode::setStyling(const vsg::ref_ptr<Styling>& in_styling)
+{
+    styling = in_styling;
+    // Tiles that start loading from now on are built with the new style.
+    _tileset->getOptions().rendererOptions = getRendererOptions();
+}
+
+void TilesetNode::setKeepTileGeometry(bool keep, bool buildBVH)
+{
+    _keepTileGeometry = keep;
+    _buildTileBVH = buildBVH;
+    // Tiles already loaded keep, or don't keep, their triangles until they are reloaded.
+    if (_tileset)
+    {
+        _tileset->getOptions().rendererOptions = getRendererOptions();
+    }
+}
+
+TileRendererOptions TilesetNode::getRendererOptions() const
+{
+    return TileRendererOptions{styling, _keepTileGeometry, _buildTileBVH, _tileGeometryBytes};
+}
+
+void TilesetNode::restyleTile(const Cesium3DTilesSelection::Tile* tile)
+{
+    auto featureTable = getTileFeatureTable(*tile);
+    if (!featureTable || featureTable->styling == styling || featureTable->pendingStyling)
+    {
+        return;
+    }
+    featureTable->readColumns(*getTileModel(*tile), FeatureTable::getPropertyNames(*styling));
+    featureTable->pendingStyling = styling;
+    vsg::observer_ptr<TilesetNode> observer(this);
+    getAsyncSystem()
+        .runInWorkerThread([featureTable, pendingStyling = styling]()
+        {
+            std::vector<vsg::vec4> colors;
+            try
+            {
+                featureTable->evaluate(*pendingStyling, colors);
+            }
+            catch (const std::runtime_error& e)
+            {
+                vsg::warn("Styling: ", e.what());
+                colors.clear();
+            }
+            return colors;
+        })
+        .thenInMainThread([observer, featureTable, pendingStyling = styling](std::vector<vsg::vec4>&& colors)
+        {
+            vsg::ref_ptr<TilesetNode> tilesetNode = observer;
+            if (!tilesetNode)
+            {
+                return;
+            }
+            tilesetNode->_restyledTiles.push_back({featureTable, pendingStyling, std::move(colors)});
+        });
+}
+
+template<typename F>
+std::vector<FeatureSelection> TilesetNode::selectTileFeatures(const F& select)
+{
+    VSGCS_ZONESCOPEDN("select features");
+    std::vector<FeatureSelection> result;
+    _tileset->forEachLoadedTile(
+        [&result, &select](Cesium3DTilesSelection::Tile& tile)
+        {
+            auto featureTable = getTileFeatureTable(tile);
+            if (!featureTable)
+            {
+                return;
+            }
+            FeatureSelection selection{&tile, featureTable, {}};
+            select(*getTileModel(tile), *featureTable, selection.featureIds);
+            const auto& referenced = featureTable->referenced;
+            if (!referenced.empty())
+            {
+                std::erase_if(selection.featureIds,
+                              [&referenced](uint32_t featureId)
+                              {
+                                  return !referenced[featureId];
+                              });
+            }
+            if (!selection.featureIds.empty())
+            {
+                result.push_back(std::move(selection));
+            }
+        });
+    return result;
+}
+
+std::vector<FeatureSelection> TilesetNode::selectFeatures(const std::string& property, FeatureCompare compare,
+                                                          double value)
+{
+    return selectTileFeatures(
+        [&](const CesiumGltf::Model& model, FeatureTable& featureTable, std::vector<uint32_t>& featureIds)
+        {
+            if (auto index = featureTable.getIndex(model, property))
+            {
+                index->select(compare, value, featureIds);
+            }
+        });
+}
+
+std::vector<FeatureSelection> TilesetNode::selectFeatures(const std::string& property, const std::string& value,
+                                                          bool equal)
+{
+    return selectTileFeatures(
+        [&](const CesiumGltf::Model& model, FeatureTable& featureTable, std::vector<uint32_t>& featureIds)
+        {
+            if (auto index = featureTable.getIndex(model, property))
+            {
+                index->select(value, equal, featureIds);
+            }
+        });
+}
+
+std::vector<FeatureSelection> TilesetNode::selectFeatures(const StyleExpression& predicate)
+{
+    return selectTileFeatures(
+        [&](const CesiumGltf::Model& model, FeatureTable& featureTable, std::vector<uint32_t>& featureIds)
+        {
+            featureTable.select(model, predicate, featureIds);
+        });
+}
+
+std::map<std::string, std::string> TilesetNode::getFeatureProperties(const Cesium3DTilesSelection::Tile& tile,
+                                                                     int64_t featureId)
+{
+    auto featureTable = getTileFeatureTable(tile);
+    if (!featureTable)
+    {
+        return {};
+    }
+    return FeatureTable::getFeatureProperties(*getTileModel(tile), featureTable->propertyTableID, featureId);
+}
+
+void TilesetNode::applyRestyledTiles(const vsg::time_point& startTime)
+{
+    VSGCS_ZONESCOPEDN("apply restyled tiles");
+    while (!_restyledTiles.empty()
+           && std::chrono::duration<double, std::milli>(vsg::clock::now() - startTime).count() < restyleTimeBudget)
+    {
+        auto restyled = std::move(_restyledTiles.front());
+        _restyledTiles.pop_front();
+        auto& featureTable = *restyled.featureTable;
+        featureTable.pendingStyling = {};
+        if (restyled.colors.size() == featureTable.palette->size())
+        {
+            std::copy(restyled.colors.begin(), restyled.colors.end(), featureTable.palette->begin());
+            featureTable.palette->dirty();
+        }
+        // A failed evaluation isn't retried until the style changes again.
+        featureTable.styling = restyled.styling;
+    }
 }
 
 bool TilesetNode::initialize(const vsg::ref_ptr<vsg::Viewer>& viewer)
@@ -397,7 +1051,8 @@ bool TilesetNode::initialize(const vsg::ref_ptr<vsg::Viewer>& viewer)
     // observer_ptrs... Anyway, keeping this "alive" for the whole function avoids a compiler /
     // clang-tidy error.
     vsg::ref_ptr<TilesetNode> ref(this);
-    viewer->addUpdateOperation(UpdateTileset::create(ref, viewer), vsg::UpdateOperations::ALL_FRAMES);
+    _updateTileset = UpdateTileset::create(ref, viewer);
+    viewer->addUpdateOperation(_updateTileset, vsg::UpdateOperations::ALL_FRAMES);
     return true;
 }
 
@@ -413,6 +1068,59 @@ void TilesetNode::removeOverlay(const vsg::ref_ptr<CsOverlay>& overlay)
     _overlays.erase(std::remove(_overlays.begin(), _overlays.end(), overlay), _overlays.end());
 }
 
+std::vector<vsg::ref_ptr<CsOverlay>>
+TilesetNode::updateOverlays(const rapidjson::Value& overlaysJson, JSONObjectFactory* factory)
+{
+    std::vector<std::string> definitions;
+    if (overlaysJson.IsArray())
+    {
+        for (rapidjson::SizeType i = 0; i < overlaysJson.Size(); ++i)
+        {
+            definitions.push_back(toJsonString(overlaysJson[i]));
+        }
+    }
+    // The layer number is the overlay's position in the array, so an overlay is only kept in
+    // its old position.
+    std::vector<bool> kept(definitions.size(), false);
+    std::vector<vsg::ref_ptr<CsOverlay>> removed;
+    vsg::ref_ptr<TilesetNode> ref_this(this);
+    std::vector<vsg::ref_ptr<CsOverlay>> overlaysCopy(_overlays);
+    for (auto& overlay : overlaysCopy)
+    {
+        std::string definition;
+        overlay->getValue("vsgCs_definition", definition);
+        if (overlay->layerNumber < definitions.size() && !kept[overlay->layerNumber]
+            && definitions[overlay->layerNumber] == definition)
+        {
+            kept[overlay->layerNumber] = true;
+        }
+        else
+        {
+            overlay->removeFromTileset(ref_this);
+            removed.push_back(overlay);
+        }
+    }
+    for (rapidjson::SizeType i = 0; i < definitions.size(); ++i)
+    {
+        if (kept[i])
+        {
+            continue;
+        }
+        const auto& element = overlaysJson[i];
+        auto built = factory->build(element);
+        vsg::ref_ptr<CsOverlay> overlay = ref_ptr_cast<CsOverlay>(built);
+        if (!overlay)
+        {
+            vsg::error("expected CSOverly, got ", built->className());
+            break;
+        }
+        overlay->layerNumber = i;
+        overlay->setValue("vsgCs_definition", definitions[i]);
+        overlay->addToTileset(ref_this);
+    }
+    return removed;
+}
+
 namespace
 {
     vsg::ref_ptr<vsg::Object> buildTilesetNode(const rapidjson::Value& json,
@@ -467,20 +1175,7 @@ namespace
         const auto itr = json.FindMember("overlays");
         if (itr != json.MemberEnd() && itr->value.IsArray())
         {
-            const auto& valueJson = itr->value;
-            for (rapidjson::SizeType i = 0; i < valueJson.Size(); ++i)
-            {
-                const auto& element = valueJson[i];
-                auto built = factory->build(element);
-                vsg::ref_ptr<CsOverlay> overlay = ref_ptr_cast<CsOverlay>(built);
-                if (!overlay)
-                {
-                    vsg::error("expected CSOverly, got ", built->className());
-                    break;
-                }
-                overlay->layerNumber = i;
-                overlay->addToTileset(tilesetNode);
-            }
+            tilesetNode->updateOverlays(itr->value, factory);
         }
         // Exploration
         tilesetNode->getTileset()->loadMetadata()
@@ -18,9 +18,14 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include "vsgCs/Export.h"
 #include "RuntimeEnvironment.h"
 #include "Styling.h"
+#include "jsonUtils.h"
 #include "runtimeSupport.h"
 #include "vsgResourcePreparer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
@@ -41,6 +46,48 @@ namespace vsgCs
         std::optional<std::string> ionAssetEndpointUrl;
     };
     
+    /**
+     * @brief The role of a vsg::View in tile selection.
+     *
+     * Only MAIN_VIEW views take part in cesium-native's tile selection and loading. The other
+     * roles draw coarser versions of the tiles selected for the main views, chosen from tiles that
+     * are already loaded, so they never cause more tiles to be loaded. Their screen-space error
+     * threshold is the tileset's maximum screen-space error multiplied by a scale factor.
+     */
+    enum ViewRole
+    {
+        MAIN_VIEW,
+        SHADOW_VIEW,
+        REFLECTION_VIEW,
+        MINIMAP_VIEW
+    };
+
+    struct VSGCS_EXPORT ViewRoleData : public vsg::Inherit<vsg::Object, ViewRoleData>
+    {
+        ViewRoleData(ViewRole in_role, double in_sseScale)
+            : role(in_role), sseScale(in_sseScale)
+        {}
+        ViewRole role;
+        double sseScale;
+    };
+
+    /**
+     * @brief Set the role of a view. A negative sseScale chooses the default for the role.
+     */
+    VSGCS_EXPORT void setViewRole(const vsg::ref_ptr<vsg::View>& view, ViewRole role, double sseScale = -1.0);
+    VSGCS_EXPORT ViewRoleData getViewRole(const vsg::View& view);
+    VSGCS_EXPORT const char* getViewRoleName(ViewRole role);
+
+    /**
+     * @brief Features of a loaded tile selected by a query.
+     */
+    struct VSGCS_EXPORT FeatureSelection
+    {
+        const Cesium3DTilesSelection::Tile* tile;
+        vsg::ref_ptr<FeatureTable> featureTable;
+        std::vector<uint32_t> featureIds;
+    };
+
     class VSGCS_EXPORT TilesetNode : public vsg::Inherit<vsg::Node, TilesetNode>
     {
     public:
@@ -87,15 +134,149 @@ namespace vsgCs
         // probably don't want to call these; use CsOverlay::addTotileset instead.
         void addOverlay(const vsg::ref_ptr<CsOverlay>& overlay);
         void removeOverlay(const vsg::ref_ptr<CsOverlay>& overlay);
+        const std::vector<vsg::ref_ptr<CsOverlay>>& getOverlays() const
+        {
+            return _overlays;
+        }
+        /**
+         * @brief Make the overlays match a JSON array of overlay definitions.
+         *
+         * An overlay whose definition and layer number are unchanged is kept, along with the
+         * textures it has already loaded. The others are removed and new ones are built.
+         * @return the removed overlays, which must be kept alive until their isBeingDestroyed()
+         * is false.
+         */
+        std::vector<vsg::ref_ptr<CsOverlay>> updateOverlays(const rapidjson::Value& overlaysJson,
+                                                            JSONObjectFactory* factory);
+        const TilesetSource& getSource() const
+        {
+            return _source;
+        }
+        /**
+         * @name Warm start
+         * Save the tiles drawn in one session and fetch them early in the next, so that a
+         * restarted viewer returns quickly to the detail it had. See SessionState.
+         */
+        ///@{
+        /// @brief Absolute content URLs of the tiles drawn by the main views in the last frame and
+        /// of their ancestors, coarsest first. Only tiles identified by their content URL are
+        /// included, and only for tilesets read from a URL.
+        std::vector<std::string> getRenderedTileIds() const;
+        /**
+         * @brief Request the content of tiles, in order, before the tile selection reaches them,
+         * and allow more simultaneous tile loads until isFullyLoaded().
+         *
+         * The responses are kept by the asset accessor's cache (see --cesium-cache), so the
+         * tileset's own requests are answered locally; without the cache nothing is prefetched.
+         * Only tilesets read from a URL can be prefetched; the tiles of ion assets need the
+         * asset's access token.
+         */
+        void prefetchTiles(const std::vector<std::string>& tileIds);
+        /// @brief True when the tiles needed by the views are all loaded.
+        bool isFullyLoaded() const;
+        ///@}
+        /// @brief True when shutdown() has been called and cesium-native has destroyed the tileset.
+        bool isShutDown() const
+        {
+            return !_tileset && _tilesetsBeingDestroyed == 0;
+        }
+        /**
+         * @brief The number of tiles drawn in the last frame by views of each role.
+         */
+        const std::map<ViewRole, size_t>& getTileCountsByRole() const
+        {
+            return _tileCounts;
+        }
+        /**
+         * @brief Replace the style of the tileset without reloading any tiles.
+         *
+         * Tiles loaded afterwards are styled with the new style. The style is evaluated for
+         * already loaded tiles in worker threads as they are drawn, and the new feature colors
+         * replace the old ones in the main thread. Reading the properties used by the style and
+         * replacing the colors are limited to restyleTimeBudget each frame.
+         *
+         * Only the feature palettes of loaded tiles are rewritten. Primitives without feature IDs
+         * keep the constant color of the old style, and primitives that the old style's show
+         * hid when the tile was loaded stay hidden, until their tiles are loaded again.
+         */
+        void setStyling(const vsg::ref_ptr<Styling>& in_styling);
+        /**
+         * @brief Keep the triangles of the tiles loaded from now on, with a BVH over them if
+         * buildBVH is true, for TerrainService queries. TerrainService::addTileset() turns this on;
+         * otherwise it is off unless RuntimeEnvironment::keepTileGeometry is set.
+         */
+        void setKeepTileGeometry(bool keep, bool buildBVH = true);
+        bool getKeepTileGeometry() const
+        {
+            return _keepTileGeometry;
+        }
+        /**
+         * @name Feature queries
+         * Select features of the loaded tiles by their properties, using the metadata kept with
+         * each tile. Indexes are built for a property when it is first queried. Only features drawn
+         * by a tile are considered. Call these in the main thread.
+         */
+        ///@{
+        std::vector<FeatureSelection> selectFeatures(const std::string& property, FeatureCompare compare,
+                                                     double value);
+        std::vector<FeatureSelection> selectFeatures(const std::string& property, const std::string& value,
+                                                     bool equal = true);
+        /// @brief Select features with a boolean style expression. Throws std::runtime_error.
+        std::vector<FeatureSelection> selectFeatures(const StyleExpression& predicate);
+        /// @brief The properties of a feature of a loaded tile, e.g. for a picked feature.
+        std::map<std::string, std::string> getFeatureProperties(const Cesium3DTilesSelection::Tile& tile,
+                                                                int64_t featureId);
+        ///@}
+        /**
+         * @brief Memory used by the triangles and BVHs kept by loaded tiles for intersection
+         * tests (see TileGeometry). It is subtracted from the tileset's maximumCachedBytes.
+         */
+        size_t getTileGeometryBytes() const
+        {
+            return static_cast<size_t>(std::max<int64_t>(0, _tileGeometryBytes->load()));
+        }
         vsg::ref_ptr<Styling> styling;
+        /// Main thread time, in milliseconds, spent per frame reading properties for a new style
+        /// and applying restyled feature colors.
+        double restyleTimeBudget;
     protected:
         const Cesium3DTilesSelection::ViewUpdateResult* _viewUpdateResult;
+        // Tiles for views that aren't MAIN_VIEW, indexed by vsg::View::viewID
+        std::map<uint32_t, std::vector<const Cesium3DTilesSelection::Tile*>> _auxiliarySelections;
+        std::map<ViewRole, size_t> _tileCounts;
         std::unique_ptr<Cesium3DTilesSelection::Tileset> _tileset;
         std::vector<vsg::ref_ptr<CsOverlay>> _overlays;
         vsg::ref_ptr<vsg::FrameStamp> _lastFrameStamp;
+        // Feature colors evaluated in worker threads, waiting to be applied to their tiles
+        struct RestyledTile
+        {
+            vsg::ref_ptr<FeatureTable> featureTable;
+            vsg::ref_ptr<Styling> styling;
+            std::vector<vsg::vec4> colors;
+        };
+        std::deque<RestyledTile> _restyledTiles;
+        int64_t _maximumCachedBytes;
+        // Shared with the tiles' render resources, which may be freed after this node
+        std::shared_ptr<std::atomic<int64_t>> _tileGeometryBytes;
+        TilesetSource _source;
+        // The tileset's own limit, while it is raised for a warm start
+        std::optional<uint32_t> _normalSimultaneousTileLoads;
     private:
         template<class V> void t_traverse(V& visitor) const;
+        void recordWithDepthPrepass(vsg::RecordTraversal& visitor) const;
+        void recordAuxiliary(vsg::RecordTraversal& visitor,
+                             const std::vector<const Cesium3DTilesSelection::Tile*>& tiles) const;
         int32_t _tilesetsBeingDestroyed;
+        bool _depthPrepass;
+        bool _keepTileGeometry;
+        bool _buildTileBVH;
+        // Removed from the viewer by shutdown()
+        vsg::ref_ptr<UpdateTileset> _updateTileset;
+        TileRendererOptions getRendererOptions() const;
+        void restyleTile(const Cesium3DTilesSelection::Tile* tile);
+        template<typename F> std::vector<FeatureSelection> selectTileFeatures(const F& select);
+        void applyRestyledTiles(const vsg::time_point& startTime);
+        void accountTileGeometry();
         
     };
 }
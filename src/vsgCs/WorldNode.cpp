@@ -1,7 +1,10 @@
 #include "WorldNode.h"
 
+#include "CRS.h"
 #include "CsOverlay.h"
+#include "GeoNode.h"
 #include "jsonUtils.h"
+#include "OpThreadTaskProcessor.h"
 #include "pbr.h"
 #include "RuntimeEnvironment.h"
 #include "Styling.h"
@@ -26,9 +29,72 @@ WorldNode::WorldNode()
 
 namespace
 {
+    // The definition of a tileset without its overlays, which can be changed without reloading
+    // the tiles.
+    std::string tilesetDefinition(const rapidjson::Value& tsObject)
+    {
+        rapidjson::Document copy;
+        copy.CopyFrom(tsObject, copy.GetAllocator());
+        if (copy.IsObject())
+        {
+            copy.RemoveMember("overlays");
+        }
+        return toJsonString(copy);
+    }
+
     vsg::ref_ptr<TilesetNode> makeTilesetNode(const rapidjson::Value& tsObject, JSONObjectFactory* factory)
     {
-        return ref_ptr_cast<TilesetNode>(factory->build(tsObject));
+        auto tilesetNode = ref_ptr_cast<TilesetNode>(factory->build(tsObject));
+        if (tilesetNode)
+        {
+            tilesetNode->setValue("vsgCs_definition", tilesetDefinition(tsObject));
+        }
+        return tilesetNode;
+    }
+
+    vsg::ref_ptr<vsg::Node> makeModel(const rapidjson::Value& modelObject, JSONObjectFactory* factory)
+    {
+        auto model = ref_ptr_cast<vsg::Node>(factory->build(modelObject));
+        if (model)
+        {
+            model->setValue("vsgCs_definition", toJsonString(modelObject));
+        }
+        else
+        {
+            vsg::error("World model is not a node: ", toJsonString(modelObject));
+        }
+        return model;
+    }
+
+    // Create the PROJ operations that the world will need, in the background.
+    void prewarmWorldCRS(const rapidjson::Value& worldJson)
+    {
+        auto crsItr = worldJson.FindMember("prewarmCRS");
+        if (crsItr != worldJson.MemberEnd() && crsItr->value.IsArray())
+        {
+            std::vector<std::string> names;
+            for (const auto& name : crsItr->value.GetArray())
+            {
+                if (name.IsString())
+                {
+                    names.emplace_back(name.GetString());
+                }
+            }
+            getAsyncSystem().runInWorkerThread([names]()
+            {
+                prewarmCRS(names);
+            });
+        }
+    }
+
+    std::string getDefinition(const vsg::ref_ptr<vsg::Node>& node)
+    {
+        std::string definition;
+        if (node)
+        {
+            node->getValue("vsgCs_definition", definition);
+        }
+        return definition;
     }
 }
 
@@ -39,6 +105,22 @@ void WorldNode::init(const rapidjson::Value& worldJson, JSONObjectFactory* facto
         factory = JSONObjectFactory::get();
     }
     auto tilesetParent = ref_ptr_cast<vsg::StateGroup>(children[0]);
+    prewarmWorldCRS(worldJson);
+    // Models, e.g. GeoNodes, are drawn with the lighting of other models rather than that of
+    // the tilesets.
+    auto modelsItr = worldJson.FindMember("models");
+    if (modelsItr != worldJson.MemberEnd() && modelsItr->value.IsArray())
+    {
+        _models = createModelRoot(RuntimeEnvironment::get());
+        addChild(_models);
+        for (const auto& modelJson : modelsItr->value.GetArray())
+        {
+            if (auto model = makeModel(modelJson, factory))
+            {
+                _models->addChild(model);
+            }
+        }
+    }
     auto tilesetsItr = worldJson.FindMember("tilesets");
     if (tilesetsItr == worldJson.MemberEnd() || !tilesetsItr->value.IsArray())
     {
@@ -53,6 +135,133 @@ void WorldNode::init(const rapidjson::Value& worldJson, JSONObjectFactory* facto
     }
 }
 
+WorldNode::ReloadStats WorldNode::reload(const rapidjson::Value& worldJson, const vsg::ref_ptr<vsg::Viewer>& viewer,
+                                         JSONObjectFactory* factory)
+{
+    if (!factory)
+    {
+        factory = JSONObjectFactory::get();
+    }
+    ReloadStats stats;
+    // Let go of what cesium-native has finished destroying since the last reload.
+    std::erase_if(_retiredTilesets, [](const vsg::ref_ptr<TilesetNode>& tilesetNode)
+    {
+        return tilesetNode->isShutDown();
+    });
+    std::erase_if(_retiredOverlays, [](const vsg::ref_ptr<CsOverlay>& overlay)
+    {
+        return !overlay->isBeingDestroyed();
+    });
+    prewarmWorldCRS(worldJson);
+
+    // Tilesets are matched with the old ones by their definitions, ignoring their order.
+    vsg::Group::Children oldTilesets;
+    oldTilesets.swap(tilesetNodes());
+    std::vector<bool> tilesetUsed(oldTilesets.size(), false);
+    auto tilesetsItr = worldJson.FindMember("tilesets");
+    if (tilesetsItr != worldJson.MemberEnd() && tilesetsItr->value.IsArray())
+    {
+        const rapidjson::Value noOverlays(rapidjson::kArrayType);
+        for (const auto& tsJson : tilesetsItr->value.GetArray())
+        {
+            const std::string definition = tilesetDefinition(tsJson);
+            auto oldItr = oldTilesets.begin();
+            for (; oldItr != oldTilesets.end(); ++oldItr)
+            {
+                if (!tilesetUsed[oldItr - oldTilesets.begin()] && getDefinition(*oldItr) == definition)
+                {
+                    break;
+                }
+            }
+            if (oldItr != oldTilesets.end())
+            {
+                tilesetUsed[oldItr - oldTilesets.begin()] = true;
+                auto tilesetNode = ref_ptr_cast<TilesetNode>(*oldItr);
+                auto overlaysItr = tsJson.FindMember("overlays");
+                auto removed = tilesetNode->updateOverlays(overlaysItr != tsJson.MemberEnd()
+                                                           ? overlaysItr->value : noOverlays,
+                                                           factory);
+                _retiredOverlays.insert(_retiredOverlays.end(), removed.begin(), removed.end());
+                tilesetNodes().push_back(tilesetNode);
+                ++stats.tilesetsKept;
+            }
+            else if (auto tilesetNode = makeTilesetNode(tsJson, factory))
+            {
+                tilesetNodes().push_back(tilesetNode);
+                tilesetNode->initialize(viewer);
+                stats.builtTilesets.push_back(tilesetNode);
+                ++stats.tilesetsBuilt;
+            }
+        }
+    }
+    for (size_t i = 0; i < oldTilesets.size(); ++i)
+    {
+        auto tilesetNode = ref_ptr_cast<TilesetNode>(oldTilesets[i]);
+        if (tilesetUsed[i] || !tilesetNode)
+        {
+            continue;
+        }
+        if (getDefinition(tilesetNode).empty())
+        {
+            // Not from a world description, e.g. added from the command line
+            tilesetNodes().push_back(tilesetNode);
+            continue;
+        }
+        const auto& overlays = tilesetNode->getOverlays();
+        _retiredOverlays.insert(_retiredOverlays.end(), overlays.begin(), overlays.end());
+        tilesetNode->shutdown();
+        _retiredTilesets.push_back(tilesetNode);
+        stats.removedTilesets.push_back(tilesetNode);
+        ++stats.tilesetsRemoved;
+    }
+
+    vsg::Group::Children oldModels;
+    if (_models)
+    {
+        oldModels.swap(_models->children);
+    }
+    std::vector<bool> modelUsed(oldModels.size(), false);
+    auto modelsItr = worldJson.FindMember("models");
+    if (modelsItr != worldJson.MemberEnd() && modelsItr->value.IsArray())
+    {
+        if (!_models)
+        {
+            _models = createModelRoot(RuntimeEnvironment::get());
+            addChild(_models);
+        }
+        for (const auto& modelJson : modelsItr->value.GetArray())
+        {
+            const std::string definition = toJsonString(modelJson);
+            size_t i = 0;
+            for (; i < oldModels.size(); ++i)
+            {
+                if (!modelUsed[i] && getDefinition(oldModels[i]) == definition)
+                {
+                    break;
+                }
+            }
+            if (i < oldModels.size())
+            {
+                modelUsed[i] = true;
+                _models->addChild(oldModels[i]);
+                ++stats.modelsKept;
+            }
+            else if (auto model = makeModel(modelJson, factory))
+            {
+                if (viewer->compileManager)
+                {
+                    auto compileResult = viewer->compileManager->compile(model);
+                    vsg::updateViewer(*viewer, compileResult);
+                }
+                _models->addChild(model);
+                ++stats.modelsBuilt;
+            }
+        }
+    }
+    stats.modelsRemoved = static_cast<size_t>(std::count(modelUsed.begin(), modelUsed.end(), false));
+    return stats;
+}
+
 bool WorldNode::initialize(const vsg::ref_ptr<vsg::Viewer>& viewer)
 {
     bool result = true;
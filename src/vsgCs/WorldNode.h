@@ -29,8 +29,10 @@ SOFTWARE.
 #include <gsl/span>
 
 #include "vsgCs/Export.h"
+#include "CsOverlay.h"
 #include "runtimeSupport.h"
 #include "jsonUtils.h"
+#include "TilesetNode.h"
 
 namespace vsgCs
 {
@@ -49,6 +51,28 @@ namespace vsgCs
          */
         bool initialize(const vsg::ref_ptr<vsg::Viewer>& viewer);
         void shutdown();
+        struct ReloadStats
+        {
+            size_t tilesetsKept = 0;
+            size_t tilesetsBuilt = 0;
+            size_t tilesetsRemoved = 0;
+            size_t modelsKept = 0;
+            size_t modelsBuilt = 0;
+            size_t modelsRemoved = 0;
+            // e.g. for TerrainService::addTileset and removeTileset
+            std::vector<vsg::ref_ptr<TilesetNode>> builtTilesets;
+            std::vector<vsg::ref_ptr<TilesetNode>> removedTilesets;
+        };
+        /**
+         * @brief Change the world to match a new world description, e.g. an edited world file.
+         *
+         * Tilesets and models whose JSON definitions are unchanged are kept with the tiles they
+         * have loaded; a tileset whose only changes are in its overlays keeps its tiles too.
+         * Everything else is built again, initialized and compiled. Call in the main thread after
+         * initialize().
+         */
+        ReloadStats reload(const rapidjson::Value& worldJson, const vsg::ref_ptr<vsg::Viewer>& viewer,
+                           JSONObjectFactory* factory = nullptr);
         // hack for supporting zoom after load
         const Cesium3DTilesSelection::Tile* getRootTile(size_t tileset = 0);
         /**
@@ -59,5 +83,11 @@ namespace vsgCs
             auto stateGroup = ref_ptr_cast<vsg::StateGroup>(children[0]);
             return stateGroup->children;
         }
+    protected:
+        // Models from the "models" array, e.g. GeoNodes
+        vsg::ref_ptr<vsg::Group> _models;
+        // Tilesets and overlays removed by reload() that cesium-native is still destroying
+        std::vector<vsg::ref_ptr<TilesetNode>> _retiredTilesets;
+        std::vector<vsg::ref_ptr<CsOverlay>> _retiredOverlays;
     };
 }
@@ -26,6 +26,8 @@ SOFTWARE.
 
 #include <exception>
 #include <CesiumUtility/JsonHelpers.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 
 using namespace vsgCs;
 
@@ -75,6 +77,14 @@ std::string vsgCs::getStringOrError(const rapidjson::Value& json, const std::str
     throw std::runtime_error(errorMsg);
 }
 
+std::string vsgCs::toJsonString(const rapidjson::Value& json)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    json.Accept(writer);
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
 // XXX Very gross workaround to static library problems...
 
 namespace vsgCs
@@ -129,6 +129,11 @@ namespace vsgCs
         std::map<std::string, Builder> builders;
     };
 
+    /**
+     * @brief Compact JSON text of a value, e.g. for noticing when a definition has changed.
+     */
+    std::string toJsonString(const rapidjson::Value& json);
+
     // Throw std::runtime_error if property isn't found.
     std::string getStringOrError(const rapidjson::Value& json, const std::string& key,
                                  const char* errorMsg);
@@ -80,6 +80,8 @@ namespace vsgCs::pbr
         shaderSet->addAttributeBinding("vsg_instance0", "VSGCS_INSTANCES", 7, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::vec4Array::create(1));
         shaderSet->addAttributeBinding("vsg_instance1", "VSGCS_INSTANCES", 8, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::vec4Array::create(1));
         shaderSet->addAttributeBinding("vsg_instance2", "VSGCS_INSTANCES", 9, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::vec4Array::create(1));
+        // Index into the tile's feature palette. The array may also be VK_FORMAT_R16_UINT.
+        shaderSet->addAttributeBinding("vsgcs_FeatureId", "VSGCS_FEATURE_PALETTE", 10, VK_FORMAT_R32_UINT, vsg::uintArray::create(1));
 
         shaderSet->addDescriptorBinding("displacementMap", "VSG_DISPLACEMENT_MAP", PRIMITIVE_DESCRIPTOR_SET, 6,
                                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT, vsg::vec4Array2D::create(1, 1));
@@ -125,6 +127,8 @@ namespace vsgCs::pbr
                                         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, {});
         shaderSet->addDescriptorBinding("overlayTextures", "", TILE_DESCRIPTOR_SET, 1,
                                         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxOverlays, VK_SHADER_STAGE_FRAGMENT_BIT, {});
+        shaderSet->addDescriptorBinding("featurePalette", "", TILE_DESCRIPTOR_SET, 2,
+                                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, {});
 
     }
     
@@ -4,6 +4,7 @@
 
 #include <gsl/span>
 
+#include <vsg/core/Mask.h>
 #include <vsg/core/ref_ptr.h>
 #include <vsg/io/Options.h>
 #include <vsg/maths/vec2.h>
@@ -22,6 +23,14 @@ namespace vsgCs
             TILE_DESCRIPTOR_SET = 2,
             PRIMITIVE_DESCRIPTOR_SET = 3
         };
+        // Switch masks for the optional depth pre-pass of tiles. An opaque primitive has a
+        // depth-only version, a version that shades with an equal depth test, and the standard
+        // version for tiles that are fading in or out. Other primitives are only drawn in the
+        // shading passes.
+        const vsg::Mask DEPTH_PREPASS_MASK = vsg::Mask(1) << 60;
+        const vsg::Mask DEPTH_EQUAL_MASK = vsg::Mask(1) << 61;
+        const vsg::Mask DEPTH_STANDARD_MASK = vsg::Mask(1) << 62;
+        const vsg::Mask DEPTH_PASS_MASKS = DEPTH_PREPASS_MASK | DEPTH_EQUAL_MASK | DEPTH_STANDARD_MASK;
         // The overlay uniform structure.
         struct OverlayParams
         {
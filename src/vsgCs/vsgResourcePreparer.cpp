@@ -27,6 +27,7 @@ SOFTWARE.
 #include "CompilableImage.h"
 #include "RuntimeEnvironment.h"
 #include "Styling.h"
+#include "TileGeometry.h"
 #include "Tracing.h"
 
 #include <CesiumGltfContent/GltfUtilities.h>
@@ -127,7 +128,17 @@ RenderResources* merge(vsgResourcePreparer* preparer, LoadModelResult& result,
         updateViewer(*ref_viewer, result.compileResult);
         auto attachCompileResult = preparer->genv->miniCompile(attachResult.descriptorData);
         vsg::updateViewer(*ref_viewer, attachCompileResult);
-        return new RenderResources{attachResult.updatedModel};
+        auto* resources = new RenderResources{attachResult.updatedModel};
+        if (result.geometryBytes)
+        {
+            if (auto tileGeometry = CesiumGltfBuilder::getTileGeometry(attachResult.updatedModel))
+            {
+                resources->geometryBytes = result.geometryBytes;
+                resources->geometrySize = static_cast<int64_t>(tileGeometry->memorySize());
+                *resources->geometryBytes += resources->geometrySize;
+            }
+        }
+        return resources;
     }
     return nullptr;
 }
@@ -152,11 +163,25 @@ vsgResourcePreparer::prepareInLoadThread(const CesiumAsync::AsyncSystem& asyncSy
     options.renderOverlays
         = (tileLoadResult.rasterOverlayDetails
            && !tileLoadResult.rasterOverlayDetails.value().rasterOverlayProjections.empty());
-    if (rendererOptions.has_value())
+    options.optimizeGraph = RuntimeEnvironment::get()->optimizeTileGraphs;
+    options.depthPrepass = RuntimeEnvironment::get()->depthPrepass;
+    std::shared_ptr<std::atomic<int64_t>> geometryBytes;
+    if (const auto* tileOptions = std::any_cast<TileRendererOptions>(&rendererOptions))
+    {
+        options.styling = tileOptions->styling;
+        options.keepGeometry = tileOptions->keepGeometry;
+        options.buildBVH = tileOptions->keepGeometry && tileOptions->buildBVH;
+        geometryBytes = tileOptions->geometryBytes;
+    }
+    else if (rendererOptions.has_value())
     {
         options.styling = std::any_cast<vsg::ref_ptr<Styling>>(rendererOptions);
     }
     LoadModelResult* result = readAndCompile(std::move(tileLoadResult), transform, options);
+    if (result && options.keepGeometry)
+    {
+        result->geometryBytes = geometryBytes;
+    }
     return asyncSystem.createResolvedFuture(
         Cesium3DTilesSelection::TileLoadResultAndRenderResources{
             std::move(tileLoadResult),
@@ -205,6 +230,10 @@ void vsgResourcePreparer::free(Cesium3DTilesSelection::Tile&,
         }
 
     }
+    if (renderResources && renderResources->geometryBytes)
+    {
+        *renderResources->geometryBytes -= renderResources->geometrySize;
+    }
     delete loadModelResult;
     delete renderResources;
 }
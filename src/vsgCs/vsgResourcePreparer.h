@@ -32,6 +32,7 @@ SOFTWARE.
 #include "GraphicsEnvironment.h"
 #include "LoadGltfResult.h"
 #include "CesiumGltfBuilder.h"
+#include "Styling.h"
 
 #include <deque>
 
@@ -69,6 +70,18 @@ namespace vsgCs
         uint64_t frameDelay;
     };
 
+    // The rendererOptions of a TilesetNode's tileset, read in the load thread
+    struct TileRendererOptions
+    {
+        vsg::ref_ptr<Styling> styling;
+        // Keep the tile triangles for TerrainService queries
+        bool keepGeometry = false;
+        // Build a BVH over the kept triangles
+        bool buildBVH = false;
+        // Total size of the kept triangles and BVHs of the loaded tiles
+        std::shared_ptr<std::atomic<int64_t>> geometryBytes;
+    };
+
     struct DeviceFeatures;
 
     class VSGCS_EXPORT vsgResourcePreparer : public Cesium3DTilesSelection::IPrepareRendererResources